@@ -0,0 +1,132 @@
+/*
+ * A block device in memory. Its sectors are in pages allocated at
+ * initialization, so they persist for as long as the system runs
+ * (e.g. across reboots of a VM using it as its disk).
+ */
+
+#include <cos_component.h>
+#include <cos_debug.h>
+#include <llprint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <initargs.h>
+#include <memmgr.h>
+#include <blkdev.h>
+
+/* The size of the disk, if its "size_mb" parameter isn't set */
+#define RAMDISK_DEFAULT_MB 64
+
+struct ramdisk_client {
+	char              *data;
+	unsigned long      data_sz;
+	struct blkdev_seg *segs;
+};
+
+static struct ramdisk_client clients[MAX_NUM_COMPS];
+
+static char          *ramdisk;
+static unsigned long  ramdisk_sz;
+
+static struct ramdisk_client *
+ramdisk_client(void)
+{
+	compid_t id = (compid_t)cos_inv_token();
+
+	if (id >= MAX_NUM_COMPS) return NULL;
+
+	return &clients[id];
+}
+
+int
+blkdev_shmem_map(cbuf_t data, cbuf_t segs)
+{
+	struct ramdisk_client *c = ramdisk_client();
+	unsigned long npages;
+	vaddr_t addr;
+
+	if (!c) return -EINVAL;
+	if (c->data) return -EEXIST;
+
+	npages = memmgr_shared_page_map(segs, &addr);
+	if (npages == 0) return -EINVAL;
+	c->segs = (struct blkdev_seg *)addr;
+
+	npages = memmgr_shared_page_map(data, &addr);
+	if (npages == 0) return -EINVAL;
+	c->data_sz = npages * PAGE_SIZE;
+	c->data    = (char *)addr;
+
+	return 0;
+}
+
+u64_t
+blkdev_capacity(void)
+{
+	return ramdisk_sz / BLKDEV_SECTOR_SZ;
+}
+
+/*
+ * Copy directly between the disk and the client's memory. The client
+ * can change its segments concurrently, so each is read once, and
+ * checked before it is used.
+ */
+static int
+ramdisk_xfer(u64_t sector, unsigned long nsegs, int write)
+{
+	struct ramdisk_client *c = ramdisk_client();
+	struct blkdev_seg seg;
+	unsigned long i, pos;
+
+	if (!c || !c->data) return -EINVAL;
+	if (nsegs > BLKDEV_MAX_SEGS || sector > ramdisk_sz / BLKDEV_SECTOR_SZ) return -EINVAL;
+
+	pos = sector * BLKDEV_SECTOR_SZ;
+	for (i = 0; i < nsegs; i++) {
+		seg = *(volatile struct blkdev_seg *)&c->segs[i];
+		if (seg.off > c->data_sz || seg.len > c->data_sz - seg.off) return -EINVAL;
+		if (seg.len > ramdisk_sz - pos) return -ENOSPC;
+
+		if (write) {
+			memcpy(ramdisk + pos, c->data + seg.off, seg.len);
+		} else {
+			memcpy(c->data + seg.off, ramdisk + pos, seg.len);
+		}
+		pos += seg.len;
+	}
+
+	return 0;
+}
+
+int
+blkdev_readv(u64_t sector, unsigned long nsegs)
+{
+	return ramdisk_xfer(sector, nsegs, 0);
+}
+
+int
+blkdev_writev(u64_t sector, unsigned long nsegs)
+{
+	return ramdisk_xfer(sector, nsegs, 1);
+}
+
+int
+blkdev_flush(void)
+{
+	/* Writes are done when they return */
+	return 0;
+}
+
+void
+cos_init(void)
+{
+	char *size = args_get("param/size_mb");
+	unsigned long mb = size ? atol(size) : RAMDISK_DEFAULT_MB;
+
+	ramdisk_sz = mb * 1024 * 1024;
+	ramdisk    = (char *)memmgr_heap_page_allocn(ramdisk_sz / PAGE_SIZE);
+	assert(ramdisk);
+	memset(ramdisk, 0, ramdisk_sz);
+
+	printc("ramdisk %ld: %luMB disk at %p\n", cos_compid(), mb, ramdisk);
+}
@@ -66,10 +66,16 @@ struct mm_span {
 };
 
 SS_STATIC_SLAB(comp, struct cm_comp, MAX_NUM_COMPS);
-SS_STATIC_SLAB(thd, struct cm_thd, MAX_NUM_THREADS);
+/* The composer bounds the threads of the components we manage */
+#ifdef COMP_MAX_THREADS
+#define CM_MAX_THREADS COMP_MAX_THREADS
+#else
+#define CM_MAX_THREADS MAX_NUM_THREADS
+#endif
+SS_STATIC_SLAB(thd, struct cm_thd, CM_MAX_THREADS);
 /* These size values are somewhat arbitrarily chosen */
-SS_STATIC_SLAB(rcv, struct cm_rcv, MAX_NUM_THREADS);
-SS_STATIC_SLAB(asnd, struct cm_asnd, MAX_NUM_THREADS);
+SS_STATIC_SLAB(rcv, struct cm_rcv, CM_MAX_THREADS);
+SS_STATIC_SLAB(asnd, struct cm_asnd, CM_MAX_THREADS);
 
 /* 64 MiB */
 #define MB2PAGES(mb) (round_up_to_page(mb * 1024 * 1024) / PAGE_SIZE)
@@ -78,6 +84,8 @@ SS_STATIC_SLAB(page, struct mm_page, MM_NPAGES);
 SS_STATIC_SLAB(span, struct mm_span, MM_NPAGES);
 
 #define CONTIG_PHY_PAGES 70000
+/* Memory aligned to at least this is also physically aligned to it */
+#define CONTIG_LARGE_PAGE_SZ (1UL << 21)
 static void * contig_phy_pages = 0;
 
 static struct cm_comp *
@@ -340,6 +348,12 @@ contigmem_shared_alloc_aligned(unsigned long npages, unsigned long align, vaddr_
 	c = ss_comp_get(cos_inv_token());
 	if (!c) return 0;
 
+	/* Let VMs map the memory with large pages (see memmgr_shared_page_map_aligned_in_vm) */
+	if (align >= CONTIG_LARGE_PAGE_SZ) {
+		vaddr_t pa = __memmgr_virt_to_phys(cos_compid(), (vaddr_t)contig_phy_pages);
+
+		contig_phy_pages += round_up_to_pow2(pa, CONTIG_LARGE_PAGE_SZ) - pa;
+	}
 	void * page = contig_phy_pages;
 
 	if (crt_page_aliasn_aligned_in(page, align, npages, &cm_self()->comp, &c->comp, &vaddr)) BUG();
@@ -508,37 +522,121 @@ mm_page_alias(struct mm_page *p, struct cm_comp *c, vaddr_t *addr, unsigned long
 	return -ENOMEM;
 }
 
-unsigned long
-memmgr_shared_page_map_aligned_in_vm(cbuf_t id, unsigned long align, vaddr_t *pgaddr, compid_t cid)
+/**
+ * Alias the pages of a span, starting at `off`, into a VM with a
+ * single 2MB or 1GB EPT entry. This requires the pages to be
+ * physically contiguous, and both the physical address and the
+ * address in the VM (`vaddr`) to be aligned to the entry's size.
+ *
+ * @return - the number of pages aliased, `0` if they can't be
+ */
+static unsigned int
+mm_span_alias_large_in_vm(struct mm_span *s, unsigned int off, struct cm_comp *c, vaddr_t vaddr)
+{
+#if defined(__x86_64__)
+	u32_t orders[] = { COS_PGTBL_ORDER_PTE_1, COS_PGTBL_ORDER_PTE_2 };
+	struct mm_page *first, *p;
+	struct mm_mapping *m;
+	unsigned long npages, sz;
+	unsigned int i, j, k;
+	vaddr_t addr;
+
+	first = ss_page_get(s->page_off + off);
+	for (i = 0; i < sizeof(orders) / sizeof(orders[0]); i++) {
+		sz     = 1UL << orders[i];
+		npages = sz / PAGE_SIZE_4K;
+		if (vaddr & (sz - 1) || off + npages > s->n_pages) continue;
+		if (__memmgr_virt_to_phys(cos_compid(), (vaddr_t)first->page) & (sz - 1)) continue;
+
+		for (j = 1; j < npages; j++) {
+			p = ss_page_get(s->page_off + off + j);
+			if (!p || p->page != first->page + j * PAGE_SIZE_4K) break;
+		}
+		if (j < npages) continue;
+
+		if (crt_page_alias_large_in(first->page, orders[i], &cm_self()->comp, &c->comp, &addr)) continue;
+		assert(addr == vaddr);
+
+		for (j = 0; j < npages; j++) {
+			p = ss_page_get(s->page_off + off + j);
+			for (k = 0; k < MM_MAPPINGS_MAX; k++) {
+				m = &p->mappings[k];
+				if (!ss_state_alloc(&m->comp)) break;
+			}
+			assert(k < MM_MAPPINGS_MAX);
+			m->addr = addr + j * PAGE_SIZE_4K;
+			ss_state_activate_with(&m->comp, (word_t)c);
+		}
+
+		return npages;
+	}
+#endif
+
+	return 0;
+}
+
+/*
+ * Guest memory is physically contiguous (contigmem), so wherever the
+ * VM's addresses and the physical addresses are both aligned to a
+ * large page, it is mapped with 1GB/2MB EPT entries, and with 4KB
+ * pages elsewhere. The VM's addresses are allocated sequentially, as
+ * only its vmm maps memory into it.
+ */
+static unsigned long
+mm_span_map_in_vm(cbuf_t id, unsigned long off, unsigned long align, vaddr_t *pgaddr, compid_t cid)
 {
 	struct cm_comp *c;
 	struct mm_span *s;
-	struct mm_page *p;
-	unsigned int i;
+	unsigned int i, n;
 	vaddr_t addr;
 	compid_t vmm = (compid_t)cos_inv_token();
 
 	*pgaddr = 0;
 	s = ss_span_get(id);
-	if (!s) return 0;
+	if (!s || off >= s->n_pages) return 0;
 	c = ss_comp_get(cid);
 	if (!c) return 0;
 
 	/* Only the vmm of this VM is allowed to call this interface */
 	assert(vmm == c->comp.vm_comp_info.vmm_comp_id);
 
-	for (i = 0; i < s->n_pages; i++) {
+	for (i = off; i < s->n_pages; i += n) {
 		struct mm_page *p;
 
+		if (*pgaddr != 0) {
+			n = mm_span_alias_large_in_vm(s, i, c, addr + PAGE_SIZE_4K);
+			if (n) {
+				addr += n * PAGE_SIZE_4K;
+				continue;
+			}
+		}
+
 		p = ss_page_get(s->page_off + i);
 		if (!p) return 0;
 
+		n = 1;
 		if (mm_page_alias(p, c, &addr, align)) BUG();
 		if (*pgaddr == 0) *pgaddr = addr;
 		align = PAGE_SIZE_4K;
 	}
 
-	return s->n_pages;
+	return s->n_pages - off;
+}
+
+unsigned long
+memmgr_shared_page_map_aligned_in_vm(cbuf_t id, unsigned long align, vaddr_t *pgaddr, compid_t cid)
+{
+	return mm_span_map_in_vm(id, 0, align, pgaddr, cid);
+}
+
+/*
+ * Map only the pages from the off-th on, so that a vmm can expose the
+ * tail of a region (e.g. the objects of a shm_bm) without its head.
+ */
+unsigned long
+memmgr_shared_page_map_range_in_vm(cbuf_t id, unsigned long off, vaddr_t *pgaddr, compid_t cid)
+{
+	return mm_span_map_in_vm(id, off, PAGE_SIZE_4K, pgaddr, cid);
 }
 
 unsigned long
@@ -899,7 +997,7 @@ capmgr_get_thd(thdid_t tid)
 {
 	/* This can only be used on the slow path */
 	struct cm_thd *thd;
-	for (int i = 1; i < MAX_NUM_THREADS; i++) {
+	for (int i = 1; i < CM_MAX_THREADS; i++) {
 		thd = ss_thd_get(i);
 		if (thd == NULL) continue;
 		if (thd->thd.tid == tid) return thd;
@@ -31,7 +31,12 @@ static u16_t g_remote_port;
 
 static struct pbuf *g_pbuf = NULL;
 
+/* Connections are indexed by thread id (see NIC_MAX_SESSION) */
+#ifdef COS_SYS_MAX_THREADS
+#define LWIP_MAX_CONNS COS_SYS_MAX_THREADS
+#else
 #define LWIP_MAX_CONNS (16)
+#endif
 
 extern struct netif net_interface;
 
@@ -7,7 +7,15 @@
 #include <ck_ring.h>
 #include <sync_sem.h>
 
+/*
+ * Sessions are indexed by thread id, so the composer's bound on the
+ * threads in the system (when it can derive one) sizes them.
+ */
+#ifdef COS_SYS_MAX_THREADS
+#define NIC_MAX_SESSION COS_SYS_MAX_THREADS
+#else
 #define NIC_MAX_SESSION 512
+#endif
 #define NIC_MAX_SHEMEM_REGION 3
 
 #define NIC_SHMEM_RX 0
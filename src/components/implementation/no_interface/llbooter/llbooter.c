@@ -18,6 +18,8 @@
 
 #include <init.h>
 #include <addr.h>
+#include <chkpt.h>
+#include <ps.h>
 
 #ifndef BOOTER_MAX_SINV
 #define BOOTER_MAX_SINV 1024
@@ -37,8 +39,11 @@
 #ifndef BOOTER_MAX_CHKPT
 #define BOOTER_MAX_CHKPT 64
 #endif
+#ifndef BOOTER_CHKPT_POOL_SZ
+#define BOOTER_CHKPT_POOL_SZ 4
+#endif
 #ifndef BOOTER_MAX_NS_ASID
-#define BOOTER_MAX_NS_ASID 64
+#define BOOTER_MAX_NS_ASID 8
 #endif
 #ifndef BOOTER_MAX_NS_VAS
 #define BOOTER_MAX_NS_VAS 64
@@ -53,11 +58,54 @@
 static struct crt_comp boot_comps[MAX_NUM_COMPS];
 static const  compid_t sched_root_id  = 2;
 static        long     boot_id_offset = -1;
+static        coreid_t boot_init_core;
+
+/*
+ * Components in exclusive address spaces are independent of each
+ * other until they are linked together, so they are created (their
+ * resource tables populated, and images copied) in parallel on all
+ * cores.
+ */
+struct boot_comp_create {
+	struct crt_comp *comp;
+	char            *name;
+	compid_t         id;
+	void            *elf_hdr;
+	vaddr_t          info;
+	prot_domain_t    pd;
+};
+static struct boot_comp_create comps_exclusive[MAX_NUM_COMPS];
+static unsigned long           comps_exclusive_len  = 0;
+static unsigned long           comps_exclusive_next = 0;
+static struct simple_barrier   comps_created_barrier;
+static struct simple_barrier   comps_linked_barrier;
 
 SS_STATIC_SLAB(sinv,   struct crt_sinv,         BOOTER_MAX_SINV);
 SS_STATIC_SLAB(thd,    struct crt_thd,          BOOTER_MAX_INITTHD);
 SS_STATIC_SLAB(rcv,    struct crt_rcv,          BOOTER_MAX_SCHED * NUM_CPU);
 SS_STATIC_SLAB(chkpt,  struct crt_chkpt,        BOOTER_MAX_CHKPT);
+
+#ifdef ENABLE_CHKPT
+/*
+ * The ready-to-run instances created from the checkpoint of each
+ * component, indexed like boot_comps by the checkpointed component.
+ */
+struct chkpt_pool {
+	struct crt_chkpt *chkpt;
+	char              name[INITARGS_MAX_PATHNAME];
+	/* The instances' threads are on this core, but threads on others can contend */
+	coreid_t          coreid;
+	struct ps_lock    lock;
+	struct crt_comp  *free[BOOTER_CHKPT_POOL_SZ];
+	int               nfree;
+};
+static struct chkpt_pool chkpt_pools[MAX_NUM_COMPS];
+/* The pool each instance was created for (and is returned to) */
+static struct chkpt_pool *chkpt_instance_pools[MAX_NUM_COMPS];
+/* The thread that acquired each executing instance, and that it returns to */
+static thdcap_t chkpt_instance_acquirers[MAX_NUM_COMPS];
+#endif /* ENABLE_CHKPT */
+
 SS_STATIC_SLAB_GLOBAL_ID(ns_asid, struct protdom_ns_asid, BOOTER_MAX_NS_ASID, 0);
 SS_STATIC_SLAB_GLOBAL_ID(ns_vas, struct protdom_ns_vas, BOOTER_MAX_NS_VAS, 0);
 
@@ -172,9 +220,10 @@ comps_init(void)
 	boot_comp_set_idoffset(cos_compid());
 
 	/*
-	 * FIXME: the asid namespace is shared between all components,
-	 * so we can only create a # of components up to the number of
-	 * ASIDs (e.g. 1024 for x86-64).
+	 * The asid namespace is shared between all components, so we
+	 * can only create a # of components up to the number of
+	 * ASIDs. They are virtual, so this isn't limited by the
+	 * hardware's PCIDs (see PROTDOM_ASID_NUM_NAMES).
 	 */
 	ns_asid = ss_ns_asid_alloc();
 	assert(ns_asid);
@@ -298,12 +347,53 @@ comps_init(void)
 			assert(ret == 0);
 		} else {
 			assert(elf_hdr);
-			if (crt_comp_create(comp, name, id, elf_hdr, info, pd)) {
-				printc("Error constructing the resource tables and image of component %s.\n", comp->name);
-				BUG();
-			}	
+			assert(comps_exclusive_len < MAX_NUM_COMPS);
+			comps_exclusive[comps_exclusive_len++] = (struct boot_comp_create) {
+				.comp    = comp,
+				.name    = name,
+				.id      = id,
+				.elf_hdr = elf_hdr,
+				.info    = info,
+				.pd      = pd
+			};
+		}
+	}
+
+	return;
+}
+
+/*
+ * Each core takes the next component to create until none are left.
+ * The kernel API's allocations are synchronized, and each component
+ * is only touched by the core creating it.
+ */
+static void
+comps_create_parallel(void)
+{
+	unsigned long idx;
+
+	while ((idx = ps_faa(&comps_exclusive_next, 1)) < comps_exclusive_len) {
+		struct boot_comp_create *cc = &comps_exclusive[idx];
+
+		if (crt_comp_create(cc->comp, cc->name, cc->id, cc->elf_hdr, cc->info, cc->pd)) {
+			printc("Error constructing the resource tables and image of component %s.\n", cc->comp->name);
+			BUG();
 		}
+		/* initialization is orchestrated from the booter's initialization core */
+		cc->comp->init_core = boot_init_core;
 	}
+}
+
+/*
+ * With all components created, link them together with invocations,
+ * delegations, and memory.
+ */
+static void
+comps_link(void)
+{
+	struct initargs comps, curr;
+	struct initargs_iter i;
+	int cont, ret;
 
 	/* perform any necessary captbl delegations */
 	ret = args_get_entry("captbl_delegations", &comps);
@@ -444,6 +534,27 @@ comps_init(void)
 	return;
 }
 
+#ifdef ENABLE_CHKPT
+/*
+ * Create the instance's thread to execute it from the beginning of
+ * its initialization. It is restarted (see crt_chkpt_restore) each
+ * time the instance is recycled.
+ */
+static void
+chkpt_instance_thd_init(struct crt_comp *comp)
+{
+	struct crt_comp_exec_context ctxt = { 0 };
+	struct crt_thd *t;
+
+	t = ss_thd_alloc();
+	assert(t);
+	if (crt_comp_exec(comp, crt_comp_exec_thd_init(&ctxt, t))) BUG();
+	ss_thd_activate(t);
+	comp->init_state = CRT_COMP_INIT_COS_INIT;
+}
+
+#endif /* ENABLE_CHKPT */
+
 /*
  * We only support a single checkpoint directly above the existing components.
  * At this point we assume capability managers and schedulers will not be checkpointed
@@ -459,8 +570,6 @@ chkpt_comp_init(struct crt_comp *comp, struct crt_chkpt *chkpt, char *name)
 	const char *root = "binaries/";
 	int   len  = strlen(root);
 	char  path[INITARGS_MAX_PATHNAME];
-	struct crt_comp_exec_context ctxt = { 0 };
-	struct crt_thd *t;
 
 	id = crt_ncomp() + 1;
 	assert(id < MAX_NUM_COMPS && id > 0 && name);
@@ -483,12 +592,7 @@ chkpt_comp_init(struct crt_comp *comp, struct crt_chkpt *chkpt, char *name)
 	}
 	assert(comp->refcnt != 0);
 
-	t = ss_thd_alloc();
-	assert(t);
-
-	if (crt_comp_exec(comp, crt_comp_exec_thd_init(&ctxt, t))) BUG();
-	ss_thd_activate(t);
-	comp->init_state = CRT_COMP_INIT_COS_INIT;
+	chkpt_instance_thd_init(comp);
 
 	/* create the sinvs */
 	for (u32_t i = 0 ; i < comp->n_sinvs ; i++) {
@@ -498,8 +602,9 @@ chkpt_comp_init(struct crt_comp *comp, struct crt_chkpt *chkpt, char *name)
 
 		sinv = ss_sinv_alloc();
 		assert(sinv);
+		/* checkpointed components cannot share a VAS, thus have no callgates */
 		crt_sinv_create(sinv, comp->sinvs[i].name, comp->sinvs[i].server, comp->sinvs[i].client,
-			comp->sinvs[i].c_fn_addr, comp->sinvs[i].c_ucap_addr, comp->sinvs[i].s_fn_addr);
+			comp->sinvs[i].c_fn_addr, 0, comp->sinvs[i].c_ucap_addr, comp->sinvs[i].s_fn_addr, 0);
 		ss_sinv_activate(sinv);
 		printc("\t(chkpt) sinv: %s (%lu->%lu):\tclient_fn @ 0x%lx, client_ucap @ 0x%lx, server_fn @ 0x%lx\n",
 			sinv->name, sinv->client->id, sinv->server->id, sinv->c_fn_addr, sinv->c_ucap_addr, sinv->s_fn_addr);
@@ -547,47 +652,134 @@ booter_init(void)
 	cos_hw_cycles_per_usec(BOOT_CAPTBL_SELF_INITHW_BASE);
 }
 
+#ifdef ENABLE_CHKPT
+static struct chkpt_pool *
+chkpt_pool_get(struct crt_comp *c)
+{
+	return &chkpt_pools[c - boot_comps];
+}
+
+/*
+ * Reset an exited instance to its checkpoint, restarting its thread,
+ * and return it to the pool.
+ */
+static void
+chkpt_pool_recycle(struct chkpt_pool *p, struct crt_comp *c)
+{
+	if (crt_chkpt_restore(p->chkpt, c)) BUG();
+	c->init_state = CRT_COMP_INIT_COS_INIT;
+
+	ps_lock_take(&p->lock);
+	assert(p->nfree < BOOTER_CHKPT_POOL_SZ);
+	p->free[p->nfree++] = c;
+	ps_lock_release(&p->lock);
+}
+
+/*
+ * Take a ready instance from the pool, and switch to it from the
+ * `acquirer` thread. Creating the instances is the expensive part, and
+ * is done ahead of time. When the instance exits, it switches back to
+ * the acquirer, which recycles it.
+ */
+static compid_t
+chkpt_pool_dispatch(struct chkpt_pool *p, thdcap_t acquirer)
+{
+	struct crt_comp *comp;
+	thdcap_t thdcap;
+	int ret;
+
+	/* Only threads the booter executes can wait for the instance */
+	if (cos_coreid() != p->coreid || !acquirer) return 0;
+
+	ps_lock_take(&p->lock);
+	if (p->nfree == 0) {
+		ps_lock_release(&p->lock);
+		return 0;
+	}
+	comp = p->free[--p->nfree];
+	ps_lock_release(&p->lock);
+
+	chkpt_instance_acquirers[comp - boot_comps] = acquirer;
+	thdcap = crt_comp_thdcap_get(comp);
+	assert(thdcap);
+	if ((ret = cos_defswitch(thdcap, TCAP_PRIO_MAX, TCAP_RES_INF, cos_sched_sync()))) {
+		printc("Switch failure on thdcap %ld, with ret %d\n", thdcap, ret);
+		BUG();
+	}
+	/* The instance has exited, and its thread is suspended in init_exit */
+	chkpt_pool_recycle(p, comp);
+
+	return comp->id;
+}
+#endif /* ENABLE_CHKPT */
+
+compid_t
+chkpt_acquire(compid_t id)
+{
+#ifdef ENABLE_CHKPT
+	struct crt_comp   *c;
+	struct chkpt_pool *p;
+
+	if (id <= 0 || id > MAX_NUM_COMPS) return 0;
+	c = boot_comp_get(id);
+	p = chkpt_pool_get(c);
+	if (!p->chkpt) return 0;
+
+	return chkpt_pool_dispatch(p, crt_comp_thdcap_get(boot_comp_get((compid_t)cos_inv_token())));
+#else
+	return 0;
+#endif /* ENABLE_CHKPT */
+}
+
 void
 init_done_chkpt(struct crt_comp *c)
 {
-	struct crt_comp  *new_comp = boot_comp_get(crt_ncomp() + 1);
-	struct crt_chkpt *chkpt;
-	thdcap_t          thdcap;
-	int               ret;
-	char              name[INITARGS_MAX_PATHNAME];
-	char             *prefix = "chkpt_";
-	int               prefix_sz = strlen("chkpt_");
+#ifdef ENABLE_CHKPT
+	struct chkpt_pool *p;
+	char              *prefix = "chkpt_";
+	int                prefix_sz = strlen("chkpt_");
+	int                i;
 
 	if (c->id == cos_compid()) {
 	 	/* don't allow chkpnts of the booter */
 	 	BUG();
 	}
-
-	assert(INITARGS_MAX_PATHNAME > prefix_sz + strlen(c->name));
-	memcpy(name, prefix, prefix_sz + 1);
-	strncat(name, c->name, INITARGS_MAX_PATHNAME - prefix_sz - 1);
-	c->name[INITARGS_MAX_PATHNAME - 1] = '\0';
+	/* instances aren't checkpointed again */
+	if (chkpt_instance_pools[c - boot_comps]) return;
 
 	/* completed all initialization */
-	if (c->init_state >= CRT_COMP_INIT_MAIN) {
-		if (crt_nchkpt() > BOOTER_MAX_CHKPT) {
-			BUG();
-		}
+	if (c->init_state < CRT_COMP_INIT_MAIN) return;
 
-		chkpt = ss_chkpt_alloc();
-		if (crt_chkpt_create(chkpt, c) != 0) {
-			BUG();
-		}
+	p = chkpt_pool_get(c);
+	assert(!p->chkpt);
+	ps_lock_init(&p->lock);
+	p->coreid = cos_coreid();
 
-		ss_chkpt_activate(chkpt);
-		chkpt_comp_init(new_comp, chkpt, name);
-		thdcap = crt_comp_thdcap_get(new_comp);
-		assert(thdcap);
-		if ((ret = cos_defswitch(thdcap, TCAP_PRIO_MAX, TCAP_RES_INF, cos_sched_sync()))) {
-			printc("Switch failure on thdcap %ld, with ret %d\n", thdcap, ret);
-			BUG();
-		}
+	assert(INITARGS_MAX_PATHNAME > prefix_sz + strlen(c->name));
+	memcpy(p->name, prefix, prefix_sz + 1);
+	strncat(p->name, c->name, INITARGS_MAX_PATHNAME - prefix_sz - 1);
+
+	if (crt_nchkpt() >= BOOTER_MAX_CHKPT) BUG();
+	p->chkpt = ss_chkpt_alloc();
+	assert(p->chkpt);
+	if (crt_chkpt_create(p->chkpt, c) != 0) BUG();
+	ss_chkpt_activate(p->chkpt);
+
+	/* fill the pool with instances that are ready to execute, lowest id on top */
+	for (i = 0; i < BOOTER_CHKPT_POOL_SZ; i++) {
+		struct crt_comp *new_comp = boot_comp_get(crt_ncomp() + 1);
+
+		chkpt_comp_init(new_comp, p->chkpt, p->name);
+		chkpt_instance_pools[new_comp - boot_comps] = p;
+		p->free[BOOTER_CHKPT_POOL_SZ - 1 - i] = new_comp;
 	}
+	ps_lock_take(&p->lock);
+	p->nfree = BOOTER_CHKPT_POOL_SZ;
+	ps_lock_release(&p->lock);
+
+	/* execute the first instance, returning to the checkpointed component */
+	chkpt_pool_dispatch(p, crt_comp_thdcap_get(c));
+#endif /* ENABLE_CHKPT */
 
 	return;
 }
@@ -621,9 +813,16 @@ init_exit(int retval)
 	c = boot_comp_get(client);
 	assert(c);
 
-	crt_compinit_exit(c, retval);
+#ifdef ENABLE_CHKPT
+	/* instances return to their acquirer, which recycles them (and restarts this thread) */
+	if (chkpt_instance_pools[c - boot_comps]) {
+		printc("Component %lu has terminated with error code %d, and is returned to its pool.\n", c->id, retval);
+		if (cos_defswitch(chkpt_instance_acquirers[c - boot_comps], TCAP_PRIO_MAX, TCAP_RES_INF, cos_sched_sync())) BUG();
+		BUG();
+	}
+#endif /* ENABLE_CHKPT */
 
-	/* TODO: recycle back to a chkpt via chkpt_restore() */
+	crt_compinit_exit(c, retval);
 
 	while (1) ;
 }
@@ -633,6 +832,15 @@ cos_parallel_init(coreid_t cid, int is_init_core, int ncores)
 {
 	if (!is_init_core) cos_defcompinfo_sched_init();
 
+	comps_create_parallel();
+	simple_barrier(&comps_created_barrier);
+	if (is_init_core) comps_link();
+	/*
+	 * All component resources except for those required for
+	 * execution should be setup now.
+	 */
+	simple_barrier(&comps_linked_barrier);
+
 	execution_init(is_init_core);
 }
 
@@ -641,11 +849,10 @@ cos_init(void)
 {
 	booter_init();
 	cos_defcompinfo_sched_init();
+	boot_init_core = cos_cpuid();
+	simple_barrier_init(&comps_created_barrier, init_parallelism());
+	simple_barrier_init(&comps_linked_barrier, init_parallelism());
 	comps_init();
-	/*
-	 * All component resources except for those required for
-	 * execution should be setup now.
-	 */
 }
 
 void
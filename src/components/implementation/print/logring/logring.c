@@ -0,0 +1,276 @@
+/***
+ * A printer that drains the log rings its clients share with it (see
+ * `print_ring_attach`), so that printing costs a client a copy into
+ * the ring rather than an invocation per 12 bytes, and clients on
+ * different cores don't contend for the printer. A single thread
+ * periodically drains the rings, and writes their records out to the
+ * serial in batches. Each record is a whole print, so prints aren't
+ * interleaved, but the order of prints is only kept within a client.
+ * Lines are prefixed as they start, so a line printed by many
+ * `printc`s is only split when another thread's print interleaves.
+ *
+ * The rings are in the clients' memory, so nothing in them is
+ * trusted: the printer keeps its own tail, and bounds what it reads
+ * by it.
+ *
+ * Clients that don't share a ring print through `print_str_chunk`,
+ * which, as in `print.serializing`, assembles the chunks of a print in
+ * a per-core buffer, and then writes it into a per-core ring that is
+ * drained with the others.
+ */
+
+#include <cos_component.h>
+#include <llprint.h>
+#include <ps.h>
+#include <sched.h>
+#include <memmgr.h>
+#include <cos_time.h>
+#include <print.h>
+
+#include <string.h>
+#include <errno.h>
+
+/* How often the rings are drained */
+#define LOGRING_DRAIN_US 1000
+/* The output written to the serial at once */
+#define LOGRING_BATCH_SZ 4096
+/* The records drained from a ring at once, so one client can't starve the others */
+#define LOGRING_DRAIN_RECS 64
+
+struct logring_client {
+	struct print_ring *ring;
+	/* The bytes we consumed; the ring's copy is only for the client */
+	u64_t tail;
+	/* The client's dropped prints, as of the last time we reported them */
+	u64_t dropped;
+};
+
+static struct logring_client clients[MAX_NUM_COMPS];
+
+struct logring_chunks {
+	struct ps_lock lock;
+	thdid_t thdid;
+	compid_t compid;
+	char string[PRINT_RING_REC_MAX];
+	int offset;
+} CACHE_ALIGNED;
+
+static struct logring_chunks chunks[NUM_CPU];
+static struct print_ring chunk_rings[NUM_CPU];
+static u64_t chunk_tails[NUM_CPU];
+
+static char batch[LOGRING_BATCH_SZ];
+static int  batch_off;
+
+/* The thread whose line the output is in the middle of, if any */
+static struct {
+	struct print_ring *ring;
+	u16_t coreid, thdid;
+	int midline;
+} out_line;
+
+static void
+logring_flush(void)
+{
+	if (batch_off == 0) return;
+
+	cos_llprint(batch, batch_off);
+	batch_off = 0;
+}
+
+static void
+logring_out(char *s, int len)
+{
+	if (batch_off + len > LOGRING_BATCH_SZ) logring_flush();
+
+	memcpy(&batch[batch_off], s, len);
+	batch_off += len;
+}
+
+/*
+ * Output the string of a record, prefixing each line it starts with
+ * `[core thread component]`. A line that another thread left
+ * unfinished is ended first.
+ */
+static void
+logring_rec_out(struct print_ring *r, struct print_ring_rec *rec, compid_t compid, char *s, int len)
+{
+	char prefix[64];
+	int n;
+
+	if (out_line.midline && (out_line.ring != r || out_line.coreid != rec->coreid || out_line.thdid != rec->thdid)) {
+		logring_out("\n", 1);
+		out_line.midline = 0;
+	}
+	out_line.ring   = r;
+	out_line.coreid = rec->coreid;
+	out_line.thdid  = rec->thdid;
+
+	while (len > 0) {
+		char *nl = memchr(s, '\n', len);
+
+		n = nl ? nl - s + 1 : len;
+		if (!out_line.midline) {
+			int pn = snprintf(prefix, sizeof(prefix), "[%d %d %ld] ", rec->coreid, rec->thdid, compid);
+
+			logring_out(prefix, pn);
+		}
+		logring_out(s, n);
+		out_line.midline = !nl;
+		s   += n;
+		len -= n;
+	}
+}
+
+/*
+ * Output up to `LOGRING_DRAIN_RECS` committed records of the ring `r`,
+ * from our `tail`. The records of a client's ring are attributed to its
+ * `owner`, rather than to the component the client wrote in them.
+ */
+static void
+logring_drain(struct print_ring *r, u64_t *tailp, compid_t owner)
+{
+	char str[PRINT_RING_REC_MAX];
+	u64_t tail = *tailp;
+	u64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	int i;
+
+	/* A corrupt head can't take us past what we haven't consumed */
+	if (head - tail > PRINT_RING_SZ) head = tail + PRINT_RING_SZ;
+
+	for (i = 0; i < LOGRING_DRAIN_RECS && head - tail >= sizeof(struct print_ring_rec); i++) {
+		unsigned long off = tail & (PRINT_RING_SZ - 1), sz, first;
+		struct print_ring_rec *rec = (struct print_ring_rec *)&r->data[off];
+		struct print_ring_rec hdr;
+		u32_t len = __atomic_load_n(&rec->len, __ATOMIC_ACQUIRE);
+
+		/* A thread is still writing the record */
+		if (!(len & PRINT_RING_COMMITTED)) break;
+		len &= ~PRINT_RING_COMMITTED;
+		if (len > PRINT_RING_REC_MAX) len = PRINT_RING_REC_MAX;
+		sz = print_ring_rec_sz(len);
+		if (sz > head - tail) break;
+
+		hdr   = *rec;
+		off  += sizeof(struct print_ring_rec);
+		first = PRINT_RING_SZ - off;
+		if (first >= len) {
+			memcpy(str, &r->data[off], len);
+		} else {
+			memcpy(str, &r->data[off], first);
+			memcpy(&str[first], r->data, len - first);
+		}
+
+		/* Zero the record, so that a record later reserved over it isn't committed */
+		off   = tail & (PRINT_RING_SZ - 1);
+		first = PRINT_RING_SZ - off;
+		if (first >= sz) {
+			memset(&r->data[off], 0, sz);
+		} else {
+			memset(&r->data[off], 0, first);
+			memset(r->data, 0, sz - first);
+		}
+		tail += sz;
+		*tailp = tail;
+		__atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+
+		logring_rec_out(r, &hdr, owner ? owner : (compid_t)hdr.compid, str, len);
+	}
+}
+
+static void
+logring_dropped(struct logring_client *c, compid_t id)
+{
+	u64_t dropped = __atomic_load_n(&c->ring->dropped, __ATOMIC_RELAXED);
+	char line[64];
+	int n;
+
+	if (dropped == c->dropped) return;
+	if (out_line.midline) {
+		logring_out("\n", 1);
+		out_line.midline = 0;
+	}
+
+	n = snprintf(line, sizeof(line), "[%ld] %llu prints dropped\n", id, dropped - c->dropped);
+	logring_out(line, n);
+	c->dropped = dropped;
+}
+
+int
+print_ring_attach(cbuf_t ring)
+{
+	compid_t id = (compid_t)cos_inv_token();
+	unsigned long npages;
+	vaddr_t addr;
+
+	if (id >= MAX_NUM_COMPS) return -EINVAL;
+	if (clients[id].ring) return -EEXIST;
+
+	npages = memmgr_shared_page_map(ring, &addr);
+	if (npages < PRINT_RING_PAGES) return -EINVAL;
+	__atomic_store_n(&clients[id].ring, (struct print_ring *)addr, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static void
+chunks_flush(struct logring_chunks *b, coreid_t coreid)
+{
+	if (b->offset == 0) return;
+
+	print_ring_write(&chunk_rings[coreid], b->compid, b->string, b->offset);
+	b->offset = 0;
+}
+
+int
+print_str_chunk(u32_t chunk0, u32_t chunk1, u32_t chunk2, int len_left)
+{
+	u32_t str[3] = {chunk0, chunk1, chunk2};
+	coreid_t coreid = cos_coreid();
+	compid_t compid = (compid_t)cos_inv_token();
+	thdid_t thdid   = cos_thdid();
+	struct logring_chunks *b = &chunks[coreid];
+	int len = len_left;
+
+	if (len <= 0) return 0;
+	if (len > (int)sizeof(str)) len = (int)sizeof(str);
+
+	/* Only threads on this core contend for its buffer */
+	ps_lock_take(&b->lock);
+
+	/* We preempted another thread's print, so flush it out to see the interleaving */
+	if (b->offset > 0 && (b->thdid != thdid || b->compid != compid)) chunks_flush(b, coreid);
+	b->thdid  = thdid;
+	b->compid = compid;
+
+	if (b->offset + len > PRINT_RING_REC_MAX) chunks_flush(b, coreid);
+	memcpy(&b->string[b->offset], str, len);
+	b->offset += len;
+	/* This is the end of the print */
+	if (len == len_left) chunks_flush(b, coreid);
+
+	ps_lock_release(&b->lock);
+
+	return len;
+}
+
+int
+main(void)
+{
+	compid_t id;
+	int i;
+
+	while (1) {
+		for (i = 0; i < NUM_CPU; i++) logring_drain(&chunk_rings[i], &chunk_tails[i], 0);
+		for (id = 0; id < MAX_NUM_COMPS; id++) {
+			struct logring_client *c = &clients[id];
+
+			if (!__atomic_load_n(&c->ring, __ATOMIC_ACQUIRE)) continue;
+			logring_drain(c->ring, &c->tail, id);
+			logring_dropped(c, id);
+		}
+		logring_flush();
+
+		sched_thd_block_timeout(0, time_now() + time_usec2cyc(LOGRING_DRAIN_US));
+	}
+}
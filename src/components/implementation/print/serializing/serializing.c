@@ -19,6 +19,7 @@
 #include <ps.h>
 
 #include <string.h>
+#include <errno.h>
 
 
 #define PRINT_STRLEN 180
@@ -101,3 +102,10 @@ print_str_chunk(u32_t chunk0, u32_t chunk1, u32_t chunk2, int len_left)
 
 	return len;
 }
+
+int
+print_ring_attach(cbuf_t ring)
+{
+	/* Mapping the ring needs the memory manager, which we can't depend on */
+	return -ENOTSUP;
+}
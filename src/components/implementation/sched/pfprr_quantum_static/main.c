@@ -215,6 +215,18 @@ sched_debug_thd_state(thdid_t tid)
 	return t->state;
 }
 
+int
+sched_thd_running(thdid_t tid)
+{
+	struct slm_thd *t = slm_thd_lookup(tid);
+
+	if (!t) return 0;
+	/* A thread on our core can only execute once we stop spinning */
+	if (t->cpuid == cos_cpuid()) return 0;
+
+	return slm_state_is_runnable(t->state);
+}
+
 static int
 thd_block_until(cycles_t timeout)
 {
@@ -250,6 +262,26 @@ sched_thd_block_timeout(thdid_t dep_id, cycles_t abs_timeout)
 	return now;
 }
 
+cycles_t
+sched_thd_block_wakeable(thdid_t dep_id, cycles_t abs_timeout)
+{
+	struct slm_thd *current = slm_thd_current();
+
+	if (dep_id) return 0;
+
+	if (cycles_greater_than(abs_timeout, slm_now())) {
+		slm_cs_enter(current, SLM_CS_NONE);
+		/* the timer and a wakeup both make us runnable: whichever is first */
+		if (!slm_timer_add(current, abs_timeout) && slm_thd_block(current)) {
+			slm_timer_cancel(current);
+		}
+		slm_cs_exit_reschedule(current, SLM_CS_NONE);
+		slm_timer_cancel(current);
+	}
+
+	return slm_now();
+}
+
 int
 thd_sleep(cycles_t c)
 {
@@ -288,156 +320,165 @@ sched_blkpt_block(sched_blkpt_id_t blkpt, sched_blkpt_epoch_t epoch, thdid_t dep
 	return slm_blkpt_block(blkpt, current, epoch, dependency);
 }
 
-struct ipc_retvals {
-	int ready;
-	word_t r0, r1;
-};
+/***
+ * Synchronous IPC between threads. Each endpoint has a pool of server
+ * threads that `reply_wait` on it, and a FIFO of clients that have
+ * `call`ed it while all servers were busy. Clients and servers block
+ * in the scheduler when they must wait, and when the rendezvous is on
+ * a single core, we switch directly between client and server,
+ * bypassing the scheduling policy.
+ */
 
-struct ipc_ep {
-	struct slm_thd     *client, *server;
-	word_t              a0, a1;
-	struct ipc_retvals *retvals;
+/* A request, allocated on the client's stack for the call's duration */
+struct ipc_call {
+	struct slm_thd *client;
+	word_t          a0, a1;
+	word_t          r0, r1;
+	word_t          ready;
+	struct ps_list  list;
 };
 
-/* For now, mainly a testing feature, thus only one */
-#define IPC_EP_NUM 1 /* MAX_NUM_THREADS */
+struct ipc_ep;
 
-struct ipc_ep eps[IPC_EP_NUM];
-
-enum {
-	CNT_C_CALL,
-	CNT_C_LOOP,
-	CNT_C_RET,
-	CNT_S_REPLY,
-	CNT_S_LOOP,
-	CNT_S_WAIT,
-	CNT_S_RET,
-	CNT_MAX
+struct ipc_server {
+	struct slm_thd  *thd;
+	struct ipc_ep   *ep;   /* the endpoint this thread serves */
+	struct ipc_call *call; /* the call currently being serviced */
+	struct ps_list   list;
 };
-unsigned long counts[CNT_MAX];
-static void
-count_inc(int type)
-{
-	counts[type]++;
-}
 
-cycles_t readings[4];
-struct total {
-	int cnt;
-	int prev_stage_cnt[4];
-	cycles_t tot;
-} totals[4];
+struct ipc_ep {
+	struct ps_lock      lock;
+	int                 nservers;
+	struct ps_list_head clients; /* calls awaiting a server */
+	struct ps_list_head idle;    /* servers awaiting a call */
+#ifdef SYNCIPC_COUNTERS
+	unsigned long       counters[SYNCIPC_CNT_MAX];
+#endif
+} CACHE_ALIGNED;
+
+#ifndef IPC_EP_NUM
+#define IPC_EP_NUM 64
+#endif
+
+static struct ipc_ep     eps[IPC_EP_NUM];
+static struct ipc_server ipc_servers[MAX_NUM_THREADS];
+
+#ifdef SYNCIPC_COUNTERS
+#define IPC_CNT_INC(ep, type) ps_faa(&(ep)->counters[(type)], 1)
+#else
+#define IPC_CNT_INC(ep, type)
+#endif
+
+word_t
+syncipc_counter(int ipc_ep, syncipc_counter_t type)
+{
+#ifdef SYNCIPC_COUNTERS
+	if (ipc_ep < 0 || ipc_ep >= IPC_EP_NUM || type >= SYNCIPC_CNT_MAX) return 0;
+
+	return ps_load(&eps[ipc_ep].counters[type]);
+#else
+	return 0;
+#endif
+}
 
 static void
-trace_add(int reading)
+ipc_ep_init(void)
 {
-	struct total *t = &totals[reading];
-	cycles_t prev_tsc;
-	cycles_t now = ps_tsc();
-	cycles_t max = 0;
-	int i, max_idx;
-
-	/* Avoid this overhead for now! */
-	return;
+	int i;
 
-	for (i = 0; i < 4; i++) {
-		if (readings[i] > max) {
-			max = readings[i];
-			max_idx = i;
-		}
+	for (i = 0; i < IPC_EP_NUM; i++) {
+		ps_lock_init(&eps[i].lock);
+		ps_list_head_init(&eps[i].clients);
+		ps_list_head_init(&eps[i].idle);
 	}
-	prev_tsc = max;
-	t->prev_stage_cnt[max_idx]++;
-
-	t->cnt++;
-	t->tot += now - prev_tsc;
-
-	if (t->cnt % 128 == 128 - 1) {
-		int i;
-
-		for (i = 0; i < 4; i++)	{
-			int cnt = totals[i].cnt;
-			int j;
+}
 
-			if (cnt == 0) cnt = 1;
-			printc("%d:%llu (", i, totals[i].tot / cnt);
-			for (j = 0; j < 4; j++) {
-				printc("%d:%d%s", j, totals[i].prev_stage_cnt[j], j == 3 ? "" :  ", ");
-			}
-			printc(")\n");
-		}
-		printc("Counts: ");
-		for (i = 0; i < CNT_MAX; i++) {
-			printc("%ld%s", counts[i], i == CNT_MAX - 1 ? "\n\n" : ", ");
+/*
+ * Wake `to` (which is awaiting our rendezvous), block `curr` until
+ * `*done` is set, and attempt to directly switch to `to` if it is on
+ * our core. `inherit_prio` determines if `to` executes at our
+ * priority. Returns once `*done` has been set.
+ */
+static void
+ipc_wake_and_wait(struct slm_thd *curr, struct slm_thd *to, word_t *done, int inherit_prio)
+{
+	sched_tok_t tok;
+	int         ret;
+
+	slm_cs_enter(curr, SLM_CS_NONE);
+	if (to) slm_thd_wakeup(to, 0);
+	while (ps_load(done) == 0) {
+		/* Woken while setting up? Re-check the rendezvous. */
+		if (curr->state != SLM_THD_BLOCKED && slm_thd_block(curr)) continue;
+
+		tok = cos_sched_sync();
+		if (to && to->cpuid == cos_cpuid() && slm_state_is_runnable(to->state)) {
+			slm_cs_exit(NULL, SLM_CS_NONE);
+			ret = slm_switch_to(curr, to, tok, inherit_prio);
+			slm_cs_enter(curr, SLM_CS_NONE);
+			/* We were switched back to, thus woken */
+			if (likely(ret == 0)) continue;
 		}
-
-		readings[reading] = ps_tsc();
-	} else {
-		readings[reading] = now;
+		/* Only try the direct switch once, then defer to the policy */
+		to = NULL;
+		slm_cs_exit_reschedule(curr, SLM_CS_NONE);
+		slm_cs_enter(curr, SLM_CS_NONE);
 	}
+	/*
+	 * The rendezvous can complete before its wakeup (e.g. an IPI)
+	 * is processed, so make sure we leave as runnable.
+	 */
+	if (unlikely(curr->state == SLM_THD_BLOCKED)) slm_thd_wakeup(curr, 0);
+	slm_cs_exit(NULL, SLM_CS_NONE);
 }
 
 int
 syncipc_call(int ipc_ep, word_t arg0, word_t arg1, word_t *ret0, word_t *ret1)
 {
-	struct slm_thd *t = slm_thd_current(), *switchto, *client;
-	/* avoid the conditional for bounds checking, ala Nova */
-	struct ipc_ep *ep = &eps[ipc_ep % IPC_EP_NUM];
-	sched_tok_t   tok;
-	int           ret;
-	struct ipc_retvals retvals = { .ready = 0 };
-
-	count_inc(CNT_C_CALL);
-	/* No server thread yet? Nothing to do here. */
-	if (ep->server == NULL) return -EAGAIN;
-	while (1) {
-		tok      = cos_sched_sync();
-		switchto = ps_load(&ep->server);
-
+	struct slm_thd    *t = slm_thd_current();
+	struct ipc_ep     *ep;
+	struct ipc_server *s = NULL;
+	struct ipc_call    call = {
+		.client = t,
+		.a0     = arg0,
+		.a1     = arg1,
+		.ready  = 0
+	};
 
-		/* Lets try and set ourself as the client communicating with the server! */
-		if (likely(ps_cas((unsigned long *)&ep->client, 0, (unsigned long)t))) {
-			/* We are the serviced client, pass arguments! */
-			ep->a0      = arg0;
-			ep->a1      = arg1;
-			ep->retvals = &retvals;
-			assert(ps_load(&ep->client) == t);
-		}
-		/*
-		 * If another client is already communicating with the
-		 * server, and they haven't yet populated the
-		 * arguments and retvals, let them finish setting up
-		 * their communication.
-		 */
-		client = ps_load(&ep->client);
-		if (unlikely(ep->client != t && ep->retvals == NULL)) switchto = client;
+	if (unlikely(ipc_ep < 0 || ipc_ep >= IPC_EP_NUM)) return -EINVAL;
+	ep = &eps[ipc_ep];
+	IPC_CNT_INC(ep, SYNCIPC_CNT_CALL);
 
-		/*
-		 * If we are the client, then we're activating the
-		 * server here. If another client exists, we're
-		 * generally just performing priority inheritance
-		 * here.
-		 */
-		trace_add(0);
-		ret = slm_switch_to(t, switchto, tok, 1);
-		trace_add(3);
-		count_inc(CNT_C_LOOP);
-		/*
-		 * Iterate while we are not the serviced client, we
-		 * have a stale scheduling token...
-		 */
-		if (unlikely(ret)) {
-			if (ret != -EAGAIN) return ret;
-			if (ret == EAGAIN) continue;
-		}
+	ps_list_init_d(&call);
+	ps_lock_take(&ep->lock);
+	/* No server thread yet? Nothing to do here. */
+	if (unlikely(ep->nservers == 0)) {
+		ps_lock_release(&ep->lock);
 
-		/* ...or the server hasn't provided a response. */
-		if (likely(ps_load(&retvals.ready))) break;
+		return -EAGAIN;
+	}
+	if (likely(!ps_list_head_empty(&ep->idle))) {
+		/* Hand the call directly to an idle server */
+		s = ps_list_head_first_d(&ep->idle, struct ipc_server);
+		ps_list_rem_d(s);
+		ps_store(&s->call, &call);
+	} else {
+		/* All servers are busy: queue for the next available */
+		ps_list_head_append_d(&ep->clients, &call);
+		IPC_CNT_INC(ep, SYNCIPC_CNT_QUEUED);
 	}
+	ps_lock_release(&ep->lock);
+
+	/*
+	 * Activate the server with our priority (it executes on our
+	 * behalf), and await its reply.
+	 */
+	ipc_wake_and_wait(t, s ? s->thd : NULL, &call.ready, 1);
 
-	count_inc(CNT_C_RET);
-	*ret0 = ps_load(&retvals.r0);
-	*ret1 = ps_load(&retvals.r1);
+	IPC_CNT_INC(ep, SYNCIPC_CNT_RET);
+	*ret0 = ps_load(&call.r0);
+	*ret1 = ps_load(&call.r1);
 
 	return 0;
 }
@@ -445,85 +486,80 @@ syncipc_call(int ipc_ep, word_t arg0, word_t arg1, word_t *ret0, word_t *ret1)
 int
 syncipc_reply_wait(int ipc_ep, word_t arg0, word_t arg1, word_t *ret0, word_t *ret1)
 {
-	struct slm_thd *t = slm_thd_current(), *client;
-	/* avoid the conditional for bounds checking, ala Nova */
-	struct ipc_ep *ep = &eps[ipc_ep % IPC_EP_NUM];
-	sched_tok_t   tok;
-	int           ret;
+	struct slm_thd    *t = slm_thd_current(), *client = NULL;
+	struct ipc_server *s = &ipc_servers[t->tid];
+	struct ipc_ep     *ep;
+	struct ipc_call   *call;
+
+	if (unlikely(ipc_ep < 0 || ipc_ep >= IPC_EP_NUM)) return -EINVAL;
+	ep = &eps[ipc_ep];
 
 	/*
-	 * Phase 1: An EP is associated with a specific server. This
-	 * conditional is formulated to move the cas and awaiting the
-	 * first client off the fast-path.
+	 * Phase 1: Add this thread to the endpoint's server pool. A
+	 * thread only serves a single endpoint.
 	 */
-	if (unlikely(ep->server != t)) {
-		/* Another server claimed the endpoint */
-		if (ep->server != NULL)         return -1;
-		if (!ps_cas((unsigned long *)&ep->server, 0, (unsigned long)t)) return -1;
-		ret = slm_sched_thd_update(t, SCHEDP_INIT, 0);
-		assert(ret == 0);
-		assert(ep->server == t);
-
-		/* Now await the first client spinning at idle prio! */
-		while (ps_load(&ep->client) == NULL) ;
-		*ret0 = ep->a0;
-		*ret1 = ep->a1;
-
-		return 0;
+	if (unlikely(s->ep != ep)) {
+		if (s->ep != NULL) return -EINVAL;
+
+		*s = (struct ipc_server) {
+			.thd  = t,
+			.ep   = ep,
+			.call = NULL,
+		};
+		ps_list_init_d(s);
+		ps_lock_take(&ep->lock);
+		ep->nservers++;
+		ps_lock_release(&ep->lock);
 	}
 
-	count_inc(CNT_S_REPLY);
-
 	/*
 	 * Phase 2: Reply to the client we are currently servicing!
 	 */
-	client             = ps_load(&ep->client);
-	ep->retvals->r0    = arg0;
-	ep->retvals->r1    = arg1;
-	/* Make sure to set this *last*. */
-	ep->retvals->ready = 1;
-	/*
-	 * Reset the endpoint, so that the next client can make a
-	 * request. As the client variable is the sync point, we have
-	 * to write it last.
-	 */
-	ep->retvals       = NULL;
-	ep->client        = NULL;
-
-	do {
+	call = s->call;
+	if (likely(call)) {
+		IPC_CNT_INC(ep, SYNCIPC_CNT_REPLY);
+		client  = call->client;
+		s->call = NULL;
+		call->r0 = arg0;
+		call->r1 = arg1;
 		/*
-		 * Switch back to the client!
-		 *
-		 * TODO: We should add a bit that designates if there
-		 * is *contention* on the server thread, and if it is
-		 * set, instead call `slm_exit_reschedule` here to
-		 * instead run the highest-priority client.
+		 * Make sure to set this *last*: the call is on the
+		 * client's stack, and can be deallocated thereafter.
 		 */
-		trace_add(2);
-		ret = slm_switch_to(t, client, cos_sched_sync(), 1);
-		trace_add(1);
-		if (unlikely(ret) && ret != -EAGAIN) return ret;
-		count_inc(CNT_S_LOOP);
-	} while (ret == -EAGAIN);
-
-	count_inc(CNT_S_WAIT);
-	/*
-	 * Phase 3: Now await the next call! We spin as we're idle
-	 * priority.
-	 */
-	while (ps_load(&ep->client) == NULL) ;
+		ps_mem_fence();
+		ps_store(&call->ready, 1);
+	}
+
 	/*
-	 * FIXME: If we are repriorized at higher than the client, we
-	 * might preempt it after it sets ->client, but before it sets
-	 * the arguments. The *correct* design is to create a PASSIVE
-	 * priority in which threads only execute using explicit
-	 * switches from other, properly prioritized threads. Such
-	 * threads could *not* reprioritize.
+	 * Phase 3: Now get the next call, either a queued client, or
+	 * by awaiting one in the idle pool.
 	 */
-	*ret0 = ep->a0;
-	*ret1 = ep->a1;
+	ps_lock_take(&ep->lock);
+	if (!ps_list_head_empty(&ep->clients)) {
+		call = ps_list_head_first_d(&ep->clients, struct ipc_call);
+		ps_list_rem_d(call);
+		s->call = call;
+	} else {
+		ps_list_head_append_d(&ep->idle, s);
+	}
+	ps_lock_release(&ep->lock);
+
+	if (s->call) {
+		/* Let the client we replied to run when it is scheduled. */
+		if (client) {
+			slm_cs_enter(t, SLM_CS_NONE);
+			slm_thd_wakeup(client, 0);
+			slm_cs_exit(NULL, SLM_CS_NONE);
+		}
+	} else {
+		IPC_CNT_INC(ep, SYNCIPC_CNT_WAIT);
+		/* Switch back to the client at its own priority, and await a call. */
+		ipc_wake_and_wait(t, client, (word_t *)&s->call, 0);
+	}
 
-	count_inc(CNT_S_RET);
+	call  = s->call;
+	*ret0 = call->a0;
+	*ret1 = call->a1;
 
 	return 0;
 }
@@ -651,4 +687,5 @@ cos_init(void)
 	extern void calculate_initialization_schedule(void);
 	calculate_initialization_schedule();
 	cos_defcompinfo_init();
+	ipc_ep_init();
 }
@@ -5,6 +5,7 @@
 #include <simple_udp_stack.h>
 #include <netshmem.h>
 #include <sched.h>
+#include <initargs.h>
 
 static int fd;
 static volatile thdid_t init_thd = 0;
@@ -21,58 +22,8 @@ cos_init(void)
 void
 cos_parallel_init(coreid_t cid, int init_core, int ncores)
 {
-	if (cid == 0) {
-		return;
-	}
-
-	if (cos_compid() == 6 && cid != 1) {
-		return;
-	}
-	if (cos_compid() == 7 && cid != 2) {
-		return;
-	}
-	if (cos_compid() == 8 && cid != 3) {
-		return;
-	}
-	if (cos_compid() == 9 && cid != 4) {
-		return;
-	}
-	if (cos_compid() == 10 && cid != 5) {
-		return;
-	}
-	if (cos_compid() == 11 && cid != 6) {
-		return;
-	}
-	if (cos_compid() == 12 && cid != 7) {
-		return;
-	}
-	if (cos_compid() == 13 && cid != 8) {
-		return;
-	}
-	if (cos_compid() == 14 && cid != 9) {
-		return;
-	}
-	if (cos_compid() == 15 && cid != 10) {
-		return;
-	}
-	if (cos_compid() == 16 && cid != 11) {
-		return;
-	}
-	if (cos_compid() == 17 && cid != 12) {
-		return;
-	}
-	if (cos_compid() == 18 && cid != 13) {
-		return;
-	}
-	if (cos_compid() == 19 && cid != 14) {
-		return;
-	}
-	if (cos_compid() == 20 && cid != 15) {
-		return;
-	}
-	if (cos_compid() == 21 && cid != 16) {
-		return;
-	}
+	/* never on core 0; the composer places each replica on its own core(s) */
+	if (cid == 0 || !args_on_core(cid)) return;
 
 	if (init_thd != cos_thdid()) {
 		netshemem_move(init_thd, cos_thdid());
@@ -88,57 +39,8 @@ cos_parallel_init(coreid_t cid, int init_core, int ncores)
 int
 parallel_main(coreid_t cid)
 {
-	if (cid == 0) {
-		return 0;
-	}
-	if (cos_compid() == 6 && cid != 1) {
-		return 0;
-	}
-	if (cos_compid() == 7 && cid != 2) {
-		return 0;
-	}
-	if (cos_compid() == 8 && cid != 3) {
-		return 0;
-	}
-	if (cos_compid() == 9 && cid != 4) {
-		return 0;
-	}
-	if (cos_compid() == 10 && cid != 5) {
-		return 0;
-	}
-	if (cos_compid() == 11 && cid != 6) {
-		return 0;
-	}
-	if (cos_compid() == 12 && cid != 7) {
-		return 0;
-	}
-	if (cos_compid() == 13 && cid != 8) {
-		return 0;
-	}
-	if (cos_compid() == 14 && cid != 9) {
-		return 0;
-	}
-	if (cos_compid() == 15 && cid != 10) {
-		return 0;
-	}
-	if (cos_compid() == 16 && cid != 11) {
-		return 0;
-	}
-	if (cos_compid() == 17 && cid != 12) {
-		return 0;
-	}
-	if (cos_compid() == 18 && cid != 13) {
-		return 0;
-	}
-	if (cos_compid() == 19 && cid != 14) {
-		return 0;
-	}
-	if (cos_compid() == 20 && cid != 15) {
-		return 0;
-	}
-	if (cos_compid() == 21 && cid != 16) {
-		return 0;
-	}
+	if (cid == 0 || !args_on_core(cid)) return 0;
+
 	int ret;
 	u32_t ip;
 	compid_t compid;
@@ -0,0 +1,270 @@
+#include <assert.h>
+#include <string.h>
+#include <cos_types.h>
+#include <sched.h>
+#include <memmgr.h>
+#include <blkdev.h>
+#include "virtio_blk_io.h"
+#include "vpci.h"
+
+static struct virtio_blk_io_reg virtio_blk_regs;
+static struct virtio_vq_info virtio_blk_vq;
+
+static struct vmrt_vm_comp *virtio_blk_vm;
+static thdid_t virtio_blk_tid;
+/* The segments of requests, shared with the blkdev (see blkdev_shmem_map) */
+static struct blkdev_seg *virtio_blk_segs;
+
+/*
+ * Execute a request: its data descriptors become the segments of a
+ * blkdev request, which transfers the sectors directly to or from the
+ * guest's memory (shared with the blkdev), so nothing is copied here.
+ */
+static void
+virtio_blk_proc(struct vmrt_vm_vcpu *vcpu, struct virtio_vq_info *vq)
+{
+	struct iovec iov[VIRTIO_BLK_MAXSEGS + 2];
+	u16_t flags[VIRTIO_BLK_MAXSEGS + 2];
+	struct virtio_blk_outhdr *hdr;
+	u8_t *status;
+	u32_t type, iolen = 0;
+	u64_t sector;
+	int i, n, nsegs, ret;
+	u16_t idx;
+
+	/* The chain is the header, the data, then the status byte */
+	n = vq_getchain(vcpu, vq, &idx, iov, VIRTIO_BLK_MAXSEGS + 2, flags, NULL);
+	if (n < 1 || n > VIRTIO_BLK_MAXSEGS + 2) {
+		printc("vblk: virtio_blk_proc: vq_getchain = %d\n", n);
+		return;
+	}
+	/*
+	 * Fail a malformed request, through its status byte if the
+	 * guest gave us one, and otherwise just hand the chain back.
+	 */
+	if (iov[n - 1].iov_len < 1 || !(flags[n - 1] & VRING_DESC_F_WRITE)) {
+		printc("vblk: request without a status\n");
+		vq_relchain(vq, idx, 0);
+		return;
+	}
+	status = iov[n - 1].iov_base;
+	if (n < 2 || iov[0].iov_len < sizeof(struct virtio_blk_outhdr) || (flags[0] & VRING_DESC_F_WRITE)) {
+		printc("vblk: malformed request\n");
+		*status = VIRTIO_BLK_S_IOERR;
+		vq_relchain(vq, idx, 1);
+		return;
+	}
+	hdr    = iov[0].iov_base;
+	nsegs  = n - 2;
+
+	type   = hdr->type;
+	sector = hdr->sector;
+	switch (type)
+	{
+	case VIRTIO_BLK_T_IN:
+	case VIRTIO_BLK_T_OUT:
+		for (i = 0; i < nsegs; i++) {
+			virtio_blk_segs[i].off = (char *)iov[i + 1].iov_base - (char *)virtio_blk_vm->guest_addr;
+			virtio_blk_segs[i].len = iov[i + 1].iov_len;
+			if (type == VIRTIO_BLK_T_IN) iolen += iov[i + 1].iov_len;
+		}
+		if (type == VIRTIO_BLK_T_IN) {
+			ret = blkdev_readv(sector, nsegs);
+		} else {
+			ret = blkdev_writev(sector, nsegs);
+		}
+		*status = ret ? VIRTIO_BLK_S_IOERR : VIRTIO_BLK_S_OK;
+		break;
+	case VIRTIO_BLK_T_FLUSH:
+		*status = blkdev_flush() ? VIRTIO_BLK_S_IOERR : VIRTIO_BLK_S_OK;
+		break;
+	case VIRTIO_BLK_T_GET_ID:
+		if (nsegs < 1) {
+			*status = VIRTIO_BLK_S_IOERR;
+			break;
+		}
+		iolen = iov[1].iov_len < VIRTIO_BLK_ID_BYTES ? iov[1].iov_len : VIRTIO_BLK_ID_BYTES;
+		strncpy(iov[1].iov_base, "cos-vblk", iolen);
+		*status = VIRTIO_BLK_S_OK;
+		break;
+	default:
+		*status = VIRTIO_BLK_S_UNSUPP;
+		break;
+	}
+
+	/* The guest sees the data it reads, and the status */
+	vq_relchain(vq, idx, iolen + 1);
+}
+
+static void
+virtio_blk_thread(void *param)
+{
+	struct virtio_vq_info *vq = &virtio_blk_vq;
+	struct vmrt_vm_vcpu *vcpu;
+
+	while (1) {
+		/* Woken by the guest's notifications of the queue */
+		sched_thd_block(0);
+		if (!vq_ring_ready(vq))
+			continue;
+
+		vcpu = vmrt_get_vcpu(virtio_blk_vm, 0);
+		do {
+			vq_kick_disable(vq);
+			/*
+			 * Execute all of the requests made available
+			 * before a single interrupt for all of them.
+			 */
+			while (vq_has_descs(vq))
+				virtio_blk_proc(vcpu, vq);
+		} while (vq_kick_enable(vq));
+
+		vq_endchains(vcpu, vq, 1);
+	}
+}
+
+/* Writing 0 to the status resets the device, e.g. when the guest reboots */
+static void
+virtio_blk_reset(void)
+{
+	virtio_blk_vq.flags = 0;
+	virtio_blk_vq.pfn   = 0;
+	virtio_blk_regs.header.guest_features = 0;
+	virtio_blk_regs.header.queue_select   = 0;
+	virtio_blk_regs.header.ISR            = 0;
+}
+
+static void
+virtio_blk_in(u32_t port_id, int sz, struct vmrt_vm_vcpu *vcpu)
+{
+	u32_t val = 0;
+
+	switch (port_id)
+	{
+	case VIRTIO_BLK_DEV_FEATURES:
+		val = virtio_blk_regs.header.dev_features;
+		break;
+	case VIRTIO_BLK_GUEST_FEATURES:
+		val = virtio_blk_regs.header.guest_features;
+		break;
+	case VIRTIO_BLK_QUEUE_ADDR:
+		if (virtio_blk_regs.header.queue_select == 0) val = virtio_blk_vq.pfn;
+		break;
+	case VIRTIO_BLK_QUEUE_SIZE:
+		/* A size of 0 tells the guest that the queue doesn't exist */
+		if (virtio_blk_regs.header.queue_select == 0) val = virtio_blk_vq.qsize;
+		break;
+	case VIRTIO_BLK_QUEUE_SELECT:
+		val = virtio_blk_regs.header.queue_select;
+		break;
+	case VIRTIO_BLK_DEV_STATUS:
+		val = virtio_blk_regs.header.dev_status;
+		break;
+	case VIRTIO_BLK_ISR:
+		/* reading the ISR acknowledges the interrupt */
+		val = virtio_blk_regs.header.ISR;
+		virtio_blk_regs.header.ISR = 0;
+		break;
+	default:
+		if (port_id < VIRTIO_BLK_CONFIG || port_id + (1 << sz) > VIRTIO_BLK_CONFIG_END) {
+			VM_PANIC(vcpu);
+		}
+		memcpy(&val, (char *)&virtio_blk_regs.config_reg + (port_id - VIRTIO_BLK_CONFIG), 1 << sz);
+		break;
+	}
+
+	vcpu->shared_region->ax = val;
+}
+
+static void
+virtio_blk_out(u32_t port_id, int sz, struct vmrt_vm_vcpu *vcpu)
+{
+	u32_t val = vcpu->shared_region->ax;
+
+	switch (port_id)
+	{
+	case VIRTIO_BLK_GUEST_FEATURES:
+		virtio_blk_regs.header.guest_features = val & virtio_blk_regs.header.dev_features;
+		break;
+	case VIRTIO_BLK_QUEUE_ADDR:
+		if (virtio_blk_regs.header.queue_select != 0) break;
+		if (val == 0) {
+			virtio_blk_vq.flags = 0;
+			virtio_blk_vq.pfn   = 0;
+			break;
+		}
+		virtio_vq_init(vcpu, &virtio_blk_vq, val);
+		break;
+	case VIRTIO_BLK_QUEUE_SELECT:
+		virtio_blk_regs.header.queue_select = val;
+		break;
+	case VIRTIO_BLK_QUEUE_NOTIFY:
+		virtio_blk_regs.header.queue_notify = val;
+		if (val == 0) sched_thd_wakeup(virtio_blk_tid);
+		break;
+	case VIRTIO_BLK_DEV_STATUS:
+		virtio_blk_regs.header.dev_status = val;
+		if (val == 0) virtio_blk_reset();
+		break;
+	default:
+		VM_PANIC(vcpu);
+		break;
+	}
+}
+
+void
+virtio_blk_handler(u16_t port, int dir, int sz, struct vmrt_vm_vcpu *vcpu)
+{
+	if (dir == IO_IN) {
+		virtio_blk_in(port, sz, vcpu);
+	} else {
+		virtio_blk_out(port, sz, vcpu);
+	}
+}
+
+void
+virtio_blk_io_init(void)
+{
+	memset(&virtio_blk_regs, 0, sizeof(virtio_blk_regs));
+	memset(&virtio_blk_vq, 0, sizeof(virtio_blk_vq));
+
+	/*
+	 * Indirect descriptors let the guest post a request with many
+	 * segments using a single descriptor of the ring.
+	 */
+	virtio_blk_regs.header.dev_features |= (1 << VIRTIO_BLK_F_SEG_MAX);
+	virtio_blk_regs.header.dev_features |= (1 << VIRTIO_BLK_F_BLK_SIZE);
+	virtio_blk_regs.header.dev_features |= (1 << VIRTIO_BLK_F_FLUSH);
+	virtio_blk_regs.header.dev_features |= (1 << VIRTIO_RING_F_INDIRECT_DESC);
+	virtio_blk_regs.header.dev_features |= (1 << VIRTIO_RING_F_EVENT_IDX);
+	virtio_blk_regs.config_reg.seg_max  = VIRTIO_BLK_MAXSEGS;
+	virtio_blk_regs.config_reg.blk_size = BLKDEV_SECTOR_SZ;
+
+	virtio_blk_vq.qsize       = VQ_MAX_DESCRIPTORS;
+	virtio_blk_vq.hdr         = &virtio_blk_regs.header;
+	virtio_blk_vq.intr_vector = VIRTIO_BLK_INTR_VECTOR;
+}
+
+/*
+ * Connect the device to the blkdev: it shares the guest's memory,
+ * and a page for the segments of requests.
+ */
+void
+virtio_blk_backend_init(struct vmrt_vm_comp *vm, cbuf_t mem_id)
+{
+	cbuf_t segs_id;
+	vaddr_t addr;
+
+	virtio_blk_vm = vm;
+
+	segs_id = memmgr_shared_page_allocn(1, &addr);
+	assert(segs_id && addr);
+	virtio_blk_segs = (struct blkdev_seg *)addr;
+	if (blkdev_shmem_map(mem_id, segs_id)) assert(0);
+
+	virtio_blk_regs.config_reg.capacity = blkdev_capacity();
+	printc("virtio-blk: %llu sectors\n", virtio_blk_regs.config_reg.capacity);
+
+	virtio_blk_tid = sched_thd_create(virtio_blk_thread, NULL);
+	assert(virtio_blk_tid);
+}
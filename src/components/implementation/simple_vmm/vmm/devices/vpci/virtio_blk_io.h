@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cos_types.h>
+#include <vmrt.h>
+#include "virtio_vq.h"
+
+#define VIRTIO_BLK_IO_ADDR 0x8000
+
+#define VIRTIO_BLK_DEV_FEATURES (VIRTIO_BLK_IO_ADDR + VIRTIO_PCI_DEV_FEATURES)
+#define VIRTIO_BLK_GUEST_FEATURES (VIRTIO_BLK_IO_ADDR + VIRTIO_PCI_GUEST_FEATURES)
+#define VIRTIO_BLK_QUEUE_ADDR (VIRTIO_BLK_IO_ADDR + VIRTIO_PCI_QUEUE_ADDR)
+#define VIRTIO_BLK_QUEUE_SIZE (VIRTIO_BLK_IO_ADDR + VIRTIO_PCI_QUEUE_SIZE)
+#define VIRTIO_BLK_QUEUE_SELECT (VIRTIO_BLK_IO_ADDR + VIRTIO_PCI_QUEUE_SELECT)
+#define VIRTIO_BLK_QUEUE_NOTIFY (VIRTIO_BLK_IO_ADDR + VIRTIO_PCI_QUEUE_NOTIFY)
+#define VIRTIO_BLK_DEV_STATUS (VIRTIO_BLK_IO_ADDR + VIRTIO_PCI_DEV_STATUS)
+#define VIRTIO_BLK_ISR (VIRTIO_BLK_IO_ADDR + VIRTIO_PCI_ISR)
+
+/* The device configuration (struct virtio_blk_config), accessed a byte at a time */
+#define VIRTIO_BLK_CONFIG (VIRTIO_BLK_IO_ADDR + VIRTIO_PCI_CONFIG)
+#define VIRTIO_BLK_CONFIG_END (VIRTIO_BLK_CONFIG + sizeof(struct virtio_blk_config))
+
+#define VIRTIO_BLK_F_SIZE_MAX (1)
+#define VIRTIO_BLK_F_SEG_MAX (2)
+#define VIRTIO_BLK_F_GEOMETRY (4)
+#define VIRTIO_BLK_F_RO (5)
+#define VIRTIO_BLK_F_BLK_SIZE (6)
+#define VIRTIO_BLK_F_FLUSH (9)
+
+/* TODO: as with virtio-net's, this is the vector the guest happens to use */
+#define VIRTIO_BLK_INTR_VECTOR 58
+
+/* Data segments of a request, excluding its header and status */
+#define VIRTIO_BLK_MAXSEGS 128
+
+#define VIRTIO_BLK_T_IN 0
+#define VIRTIO_BLK_T_OUT 1
+#define VIRTIO_BLK_T_FLUSH 4
+#define VIRTIO_BLK_T_GET_ID 8
+
+#define VIRTIO_BLK_S_OK 0
+#define VIRTIO_BLK_S_IOERR 1
+#define VIRTIO_BLK_S_UNSUPP 2
+
+#define VIRTIO_BLK_ID_BYTES 20
+
+struct virtio_blk_config {
+	u64_t capacity;
+	u32_t size_max;
+	u32_t seg_max;
+	u16_t cylinders;
+	u8_t heads;
+	u8_t sectors;
+	u32_t blk_size;
+} __attribute__((packed));
+
+struct virtio_blk_io_reg {
+	struct virtio_header header;
+	struct virtio_blk_config config_reg;
+} __attribute__((packed));
+
+/* The first descriptor of each request */
+struct virtio_blk_outhdr {
+	u32_t type;
+	u32_t ioprio;
+	u64_t sector;
+} __attribute__((packed));
+
+void virtio_blk_handler(u16_t port, int dir, int sz, struct vmrt_vm_vcpu *vcpu);
+void virtio_blk_backend_init(struct vmrt_vm_comp *vm, cbuf_t mem_id);
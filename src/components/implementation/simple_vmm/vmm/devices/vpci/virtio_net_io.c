@@ -26,64 +26,28 @@
  * $FreeBSD$
  */
 #include <assert.h>
+#include <string.h>
+#include <byteswap.h>
 #include <cos_types.h>
+#include <sched.h>
+#include <nic.h>
+#include <netshmem.h>
+#include <memmgr.h>
 #include "virtio_net_io.h"
 #include "vpci.h"
-#include "virtio_ring.h"
-
-/* TODO: remove this warning flag when virtio-net is done */
-#pragma GCC diagnostic ignored "-Wunused-but-set-variable"
 
 static struct virtio_net_io_reg virtio_net_regs;
 static struct virtio_queue virtio_queues[2];
 struct virtio_vq_info virtio_net_vqs[VIRTIO_NET_MAXQ - 1];
 
-static unsigned char icmp_reply[] = {
-	/* TODO: remove icmp reply and process nic input from nic component */
-};
-
-static inline int
-vq_ring_ready(struct virtio_vq_info *vq)
-{
-	return 1;
-}
-
-static inline int 
-vq_has_descs(struct virtio_vq_info *vq)
-{
-	int ret = 0;
-	if (vq_ring_ready(vq) && vq->last_avail != vq->avail->idx) {
-		if ((u16_t)((unsigned int)vq->avail->idx - vq->last_avail) > vq->qsize)
-			printc ("no valid descriptor\n");
-		else
-			ret = 1;
-	}
-	return ret;
-
-}
-
-void *
-paddr_guest2host(uintptr_t gaddr, struct vmrt_vm_comp *vm)
-{
-	void *va = GPA2HVA(gaddr, vm);
-	return va;
-}
-
-#define roundup2(x, y)  (((x)+((y)-1))&(~((y)-1)))
-#define mb()    ({ asm volatile("mfence" ::: "memory"); (void)0; })
-
-void
-vq_endchains(struct vmrt_vm_vcpu *vcpu, struct virtio_vq_info *vq, int used_all_avail)
-{
-	u16_t event_idx, new_idx, old_idx;
-	int intr;
-
-	if (!vq || !vq->used)
-		return;
-	
-	/* TODO: 57 is virtio-net interrupt, should read it from somewhere else more reliable */
-	lapic_intr_inject(vcpu, 57, 0);
-}
+static struct vmrt_vm_comp *virtio_net_vm;
+static thdid_t virtio_net_tx_tid, virtio_net_rx_tid, virtio_net_init_tid;
+/* set while the rx thread waits for the guest to post buffers */
+static volatile int virtio_net_rx_waiting;
+/* frames lent to the guest (see VIRTIO_NET_F_RX_SHM), by the descriptor pointing at them */
+static struct netshmem_pkt_buf *virtio_net_rx_lent[VQ_MAX_DESCRIPTORS];
+/* the guest only sees the rx buffers' pages from this offset on, not the shm_bm's bitmap */
+static size_t virtio_net_rx_shm_off;
 
 static inline struct iovec *
 rx_iov_trim(struct iovec *iov, int *niov, size_t tlen)
@@ -112,301 +76,141 @@ rx_iov_trim(struct iovec *iov, int *niov, size_t tlen)
 	return riov;
 }
 
-static void
-virtio_vq_init(struct vmrt_vm_vcpu *vcpu, int nr_queue, u32_t pfn)
+/*
+ * Pass a frame received by nicmgr to the guest in its next rx chain,
+ * after its (zeroed) virtio-net header. Returns whether the frame was
+ * lent to the guest rather than copied.
+ */
+static int
+virtio_net_tap_rx(struct vmrt_vm_vcpu *vcpu, struct virtio_vq_info *vq, struct netshmem_pkt_buf *obj, u16_t len)
 {
-	struct virtio_vq_info *vq;
-	u64_t phys;
-	size_t size;
-	char *vb;
-
-	vq = &virtio_net_vqs[nr_queue];
-	vq->pfn = pfn;
-	phys = (u64_t)pfn << VRING_PAGE_BITS;
-	size = vring_size(vq->qsize, VIRTIO_PCI_VRING_ALIGN);
-	vb = paddr_guest2host(phys, vcpu->vm);
-	if (!vb)
-		goto error;
-
-	/* First page(s) are descriptors... */
-	vq->desc = (struct vring_desc *)vb;
-	vb += vq->qsize * sizeof(struct vring_desc);
-
-	/* ... immediately followed by "avail" ring (entirely u16_t's) */
-	vq->avail = (struct vring_avail *)vb;
-	vb += (2 + vq->qsize + 1) * sizeof(u16_t);
-
-	/* Then it's rounded up to the next page... */
-	vb = (char *)roundup2((uintptr_t)vb, VIRTIO_PCI_VRING_ALIGN);
-
-	/* ... and the last page(s) are the used ring. */
-	vq->used = (struct vring_used *)vb;
-
-	/* Start at 0 when we use it. */
-	vq->last_avail = 0;
-	vq->save_used = 0;
-
-	/* Mark queue as allocated after initialization is complete. */
-	mb();
-	vq->flags = VQ_ALLOC;
-
-	printc("%s: vq enable done\n", __func__);
-	return;
-
-error:
-	vq->flags = 0;
-	printc("%s: vq enable failed\n", __func__);
-}
-
-static inline int
-_vq_record(int i, volatile struct vring_desc *vd,
-	   struct iovec *iov, int n_iov, u16_t *flags, struct vmrt_vm_vcpu *vcpu) {
-
-	void *host_addr;
-
-	if (i >= n_iov)
-		return -1;
-	host_addr = paddr_guest2host(vd->addr, vcpu->vm);
-	if (!host_addr)
-		return -1;
-	iov[i].iov_base = host_addr;
-	iov[i].iov_len = vd->len;
-	if (flags != NULL)
-		flags[i] = vd->flags;
-	return 0;
-}
+	struct iovec iov[VIRTIO_NET_MAXSEGS], *riov;
+	u16_t descs[VIRTIO_NET_MAXSEGS];
+	volatile struct vring_desc *vd;
+	size_t shm_off;
+	void *vrx;
+	int i, n;
+	size_t off, sz;
+	u16_t idx;
 
-static void
-dump_packet(char *p, u16_t sz)
-{
-	for (int i = 0; i < sz; i++) {
-		if (i > 0 && (i % 8 == 0)) printc("\n");
-		u8_t c = p[i];
-		printc("%02x ", c);
+	/*
+	 * Get descriptor chain.
+	 */
+	n = vq_getchain(vcpu, vq, &idx, iov, VIRTIO_NET_MAXSEGS, NULL, descs);
+	if (n < 1 || n > VIRTIO_NET_MAXSEGS) {
+		printc("vtnet: virtio_net_tap_rx: vq_getchain = %d\n", n);
+		VM_PANIC(vcpu);
+		return 0;
 	}
-	printc("\n");
-}
+	/* The guest is done with the frames it was lent in this chain's descriptors */
+	for (i = 0; i < n; i++) {
+		if (descs[i] == VQ_DESC_INDIRECT || !virtio_net_rx_lent[descs[i]]) continue;
 
-int
-vq_getchain(struct vmrt_vm_vcpu *vcpu, struct virtio_vq_info *vq, u16_t *pidx,
-	    struct iovec *iov, int n_iov, u16_t *flags)
-{
-	int i;
-	unsigned int ndesc, n_indir;
-	unsigned int idx, next;
+		shm_bm_free_net_pkt_buf(virtio_net_rx_lent[descs[i]]);
+		virtio_net_rx_lent[descs[i]] = NULL;
+	}
 
-	volatile struct vring_desc *vdir, *vindir, *vp;
-	const char *name = "testnic"; 
 	/*
-	 * Note: it's the responsibility of the guest not to
-	 * update vq->avail->idx until all of the descriptors
-	 * the guest has written are valid (including all their
-	 * next fields and vd_flags).
-	 *
-	 * Compute (last_avail - idx) in integers mod 2**16.  This is
-	 * the number of descriptors the device has made available
-	 * since the last time we updated vq->last_avail.
-	 *
-	 * We just need to do the subtraction as an unsigned int,
-	 * then trim off excess bits.
+	 * Get a pointer to the rx header, and use the
+	 * data immediately following it for the packet buffer.
 	 */
-	idx = vq->last_avail;
-	ndesc = (u16_t)((unsigned int)vq->avail->idx - idx);
-	if (ndesc == 0)
-		return 0;
-	if (ndesc > vq->qsize) {
-		/* XXX need better way to diagnose issues */
-		printc("%s: ndesc (%u) out of range, driver confused?\r\n",
-		    name, (unsigned int)ndesc);
-		return -1;
-	}
+	vrx = iov[0].iov_base;
+	/*
+	 * The only valid field in the rx packet header is the
+	 * number of buffers if merged rx bufs were negotiated.
+	 */
+	memset(vrx, 0, sizeof(struct virtio_net_rxhdr));
 
 	/*
-	 * Now count/parse "involved" descriptors starting from
-	 * the head of the chain.
-	 *
-	 * To prevent loops, we could be more complicated and
-	 * check whether we're re-visiting a previously visited
-	 * index, but we just abort if the count gets excessive.
+	 * Lend the frame through the chain's second descriptor, unless
+	 * the frame shares a page with the shm_bm's bitmap, which isn't
+	 * mapped into the guest.
 	 */
-	*pidx = next = vq->avail->ring[idx & (vq->qsize - 1)];
-	vq->last_avail++;
-	for (i = 0; i < VQ_MAX_DESCRIPTORS; next = vdir->next) {
-		if (next >= vq->qsize) {
-			printc("tx: descriptor index %u out of range, "
-			    "driver confused?\r\n",
-			     next);
-			return -1;
-		}
-		vdir = &vq->desc[next];
-		if ((vdir->flags & VRING_DESC_F_INDIRECT) == 0) {
-			if (_vq_record(i, vdir, iov, n_iov, flags, vcpu)) {
-				printc("%s: mapping to host failed\r\n", name);
-				return -1;
-			}
-			i++;
-		} else if ((virtio_net_regs.header.dev_features &
-		    (1 << VIRTIO_RING_F_INDIRECT_DESC)) == 0) {
-			printc("%s: descriptor has forbidden INDIRECT flag, "
-			    "driver confused?\r\n",
-			    name);
-			return -1;
-		} else {
-			n_indir = vdir->len / 16;
-			if ((vdir->len & 0xf) || n_indir == 0) {
-				printc("%s: invalid indir len 0x%x, "
-				    "driver confused?\r\n",
-				    name, (unsigned int)vdir->len);
-				return -1;
-			}
-			vindir = paddr_guest2host(
-			    vdir->addr, vcpu->vm);
-
-			if (!vindir) {
-				printc("%s cannot get host memory\r\n", name);
-				return -1;
-			}
-			/*
-			 * Indirects start at the 0th, then follow
-			 * their own embedded "next"s until those run
-			 * out.  Each one's indirect flag must be off
-			 * (we don't really have to check, could just
-			 * ignore errors...).
-			 */
-			next = 0;
-			for (;;) {
-				vp = &vindir[next];
-				if (vp->flags & VRING_DESC_F_INDIRECT) {
-					printc("%s: indirect desc has INDIR flag,"
-					    " driver confused?\r\n",
-					    name);
-					return -1;
-				}
-				if (_vq_record(i, vp, iov, n_iov, flags, vcpu)) {
-					printc("%s: mapping to host failed\r\n", name);
-					return -1;
-				}
-				if (++i > VQ_MAX_DESCRIPTORS)
-					goto loopy;
-				if ((vp->flags & VRING_DESC_F_NEXT) == 0)
-					break;
-				next = vp->next;
-				if (next >= n_indir) {
-					printc("%s: invalid next %u > %u, "
-					    "driver confused?\r\n",
-					    name, (unsigned int)next, n_indir);
-					return -1;
-				}
-			}
-		}
-		if ((vdir->flags & VRING_DESC_F_NEXT) == 0)
-			return i;
+	shm_off = (char *)obj->data - (char *)netshmem_get_shm();
+	if (vq_has_feature(vq, VIRTIO_NET_F_RX_SHM) && n >= 2 && descs[1] != VQ_DESC_INDIRECT
+	    && shm_off >= virtio_net_rx_shm_off) {
+		vd       = &vq->desc[descs[1]];
+		vd->addr = virtio_net_regs.config_reg.rx_shm_addr + (shm_off - virtio_net_rx_shm_off);
+		vd->len  = len;
+		virtio_net_rx_lent[descs[1]] = obj;
+
+		vq_relchain(vq, idx, len + sizeof(struct virtio_net_rxhdr));
+		return 1;
 	}
-loopy:
-	printc("%s: descriptor loop? count > %d - driver confused?\r\n",
-	    name, i);
-	return -1;
-}
 
-void
-vq_relchain(struct virtio_vq_info *vq, u16_t idx, u32_t iolen)
-{
-	u16_t uidx, mask;
-	volatile struct vring_used *vuh;
-	volatile struct vring_used_elem *vue;
+	riov = rx_iov_trim(iov, &n, sizeof(struct virtio_net_rxhdr));
+	if (riov == NULL)
+		VM_PANIC(vcpu);
+
+	/* Scatter the frame over the chain, truncating it if the chain is too short */
+	for (i = 0, off = 0; i < n && off < len; i++) {
+		sz = riov[i].iov_len < len - off ? riov[i].iov_len : len - off;
+		memcpy(riov[i].iov_base, obj->data + off, sz);
+		off += sz;
+	}
 
 	/*
-	 * Notes:
-	 *  - mask is N-1 where N is a power of 2 so computes x % N
-	 *  - vuh points to the "used" data shared with guest
-	 *  - vue points to the "used" ring entry we want to update
-	 *  - head is the same value we compute in vq_iovecs().
-	 *
-	 * (I apologize for the two fields named idx; the
-	 * virtio spec calls the one that vue points to, "id"...)
+	 * Release this chain.
 	 */
-	mask = vq->qsize - 1;
-	vuh = vq->used;
-
-	uidx = vuh->idx;
-	vue = &vuh->ring[uidx++ & mask];
-	vue->id = idx;
-	vue->len = iolen;
-	vuh->idx = uidx;
+	vq_relchain(vq, idx, off + sizeof(struct virtio_net_rxhdr));
+
+	return 0;
 }
 
+/*
+ * Each thread that uses nicmgr needs its own session with its own
+ * shared packet buffers.
+ */
 static void
-virtio_net_tap_rx(struct vmrt_vm_vcpu *vcpu)
+virtio_net_nic_bind(u16_t port)
 {
-	struct iovec iov[VIRTIO_NET_MAXSEGS], *riov;
-	struct virtio_vq_info *vq;
-	void *vrx;
-	int len, n;
-	u16_t idx;
-	int ret;
-
-	/*
-	 * Check for available rx buffers
-	 */
-	vq = &virtio_net_vqs[VIRTIO_NET_RXQ];
-	if (!vq_has_descs(vq)) {
-		VM_PANIC(vcpu);
-	}
-
-	do {
-		/*
-		 * Get descriptor chain.
-		 */
-		n = vq_getchain(vcpu, vq, &idx, iov, VIRTIO_NET_MAXSEGS, NULL);
-		if (n < 1 || n > VIRTIO_NET_MAXSEGS) {
-			printc("vtnet: virtio_net_tap_rx: vq_getchain = %d\n", n);
-			VM_PANIC(vcpu);
-			return;
-		}
-		/*
-		 * Get a pointer to the rx header, and use the
-		 * data immediately following it for the packet buffer.
-		 */
-		vrx = iov[0].iov_base;
-		riov = rx_iov_trim(iov, &n, sizeof(struct virtio_net_rxhdr));
-
-		memcpy(iov[0].iov_base, icmp_reply, sizeof(icmp_reply));
+	nic_shmem_map(netshmem_get_shm_id());
+	nic_bind_port(VIRTIO_NET_IP, port);
+}
 
-		len = sizeof(icmp_reply);
-		if (riov == NULL)
-			VM_PANIC(vcpu);
+static void
+virtio_net_rx_thread(void *param)
+{
+	struct virtio_vq_info *vq = &virtio_net_vqs[VIRTIO_NET_RXQ];
+	struct vmrt_vm_vcpu *vcpu;
+	struct netshmem_pkt_buf *obj;
+	shm_bm_objid_t objid;
+	u16_t len;
 
-		memset(vrx, 0, sizeof(struct virtio_net_rxhdr));
-		
+	/* The rx buffers were created (and mapped into the guest) at init */
+	netshemem_move(virtio_net_init_tid, cos_thdid());
+	virtio_net_nic_bind(VIRTIO_NET_PORT);
 
-		if (len < 0 ) {
-			/*
-			 * No more packets, but still some avail ring
-			 * entries.  Interrupt if needed/appropriate.
-			 */
-			/*TODO: fix the erro case */
-			VM_PANIC(vcpu);
-		}
+	while (1) {
+		objid = nic_get_a_packet(&len);
+		obj   = shm_bm_borrow_net_pkt_buf(netshmem_get_shm(), objid);
+		assert(obj);
 
 		/*
-		 * The only valid field in the rx packet header is the
-		 * number of buffers if merged rx bufs were negotiated.
+		 * Rather than dropping the frame, wait for the guest to
+		 * post rx buffers: it notifies the rxq when it does.
 		 */
+		virtio_net_rx_waiting = 1;
+		while (!vq_has_descs(vq) && !vq_kick_enable(vq))
+			sched_thd_block(0);
+		virtio_net_rx_waiting = 0;
 
-		/*
-		 * Release this chain and handle more chains.
-		 */
-		vq_relchain(vq, idx, len);
-	} while (vq_has_descs(vq));
+		vcpu = vmrt_get_vcpu(virtio_net_vm, 0);
+		if (!virtio_net_tap_rx(vcpu, vq, obj, len))
+			shm_bm_free_net_pkt_buf(obj);
 
-	/* Interrupt if needed, including for NOTIFY_ON_EMPTY. */
-	vq_endchains(vcpu, vq, 1);
+		/* Interrupt if needed, including for NOTIFY_ON_EMPTY. */
+		vq_endchains(vcpu, vq, !vq_has_descs(vq));
+	}
 }
 
 static void
 virtio_net_proctx(struct vmrt_vm_vcpu *vcpu, struct virtio_vq_info *vq)
 {
 	struct iovec iov[VIRTIO_NET_MAXSEGS + 1];
+	struct netshmem_pkt_buf *obj;
+	shm_bm_objid_t objid;
+	char *data;
 	int i, n;
 	int plen, tlen;
 	u16_t idx;
@@ -417,7 +221,7 @@ virtio_net_proctx(struct vmrt_vm_vcpu *vcpu, struct virtio_vq_info *vq)
 	 * really the header descriptor, so we need to sum
 	 * up two lengths: packet length and transfer length.
 	 */
-	n = vq_getchain(vcpu, vq, &idx, iov, VIRTIO_NET_MAXSEGS, NULL);
+	n = vq_getchain(vcpu, vq, &idx, iov, VIRTIO_NET_MAXSEGS, NULL, NULL);
 	if (n < 1 || n > VIRTIO_NET_MAXSEGS) {
 		printc("vtnet: virtio_net_proctx: vq_getchain = %d\n", n);
 		return;
@@ -429,40 +233,60 @@ virtio_net_proctx(struct vmrt_vm_vcpu *vcpu, struct virtio_vq_info *vq)
 		tlen += iov[i].iov_len;
 	}
 
-	printc("virtio: packet send, %d bytes, %d segs\n\r", plen, n);
-	/* begin to send packets */
-	dump_packet(iov[1].iov_base, plen);
-	/* TODO: process tx output to nic component */
-	/* net->virtio_net_tx(net, &iov[1], n - 1, plen); */
+	/*
+	 * Gather the frame (without the header, as we don't offer
+	 * ANY_LAYOUT it has its own descriptor) into a packet buffer,
+	 * and send it. The frame is dropped if no buffer is free.
+	 */
+	obj = NULL;
+	if (plen <= netshmem_get_max_data_buf_sz())
+		obj = shm_bm_alloc_net_pkt_buf(netshmem_get_shm(), &objid);
+	if (obj) {
+		data = netshmem_get_data_buf(obj);
+		for (i = 1; i < n; i++) {
+			memcpy(data, iov[i].iov_base, iov[i].iov_len);
+			data += iov[i].iov_len;
+		}
+		nic_send_packet(objid, netshmem_get_data_offset(), plen);
+		shm_bm_free_net_pkt_buf(obj);
+	}
 
 	/* chain is processed, release it and set tlen */
 	vq_relchain(vq, idx, tlen);
 }
 
 static void
-virtio_net_tx_thread(void *param, struct vmrt_vm_vcpu *vcpu)
+virtio_net_tx_thread(void *param)
 {
 	struct virtio_vq_info *vq = &virtio_net_vqs[VIRTIO_NET_TXQ];
+	struct vmrt_vm_vcpu *vcpu;
 
-	while (!vq_ring_ready(vq))
-		VM_PANIC(vcpu);
+	/* The tx session only sends, so nothing is addressed to its port */
+	netshmem_create();
+	virtio_net_nic_bind(0);
 
-	vq->used->flags |= VRING_USED_F_NO_NOTIFY;
+	while (1) {
+		/* Woken by the guest's notifications of the txq */
+		sched_thd_block(0);
+		if (!vq_ring_ready(vq))
+			continue;
 
-	do {
-		/*
-		* Run through entries, placing them into
-		* iovecs and sending when an end-of-packet
-		* is found
-		*/
-		virtio_net_proctx(vcpu, vq);
-	} while (vq_has_descs(vq));
-	printc("tx done on busrt\n");
+		vcpu = vmrt_get_vcpu(virtio_net_vm, 0);
+		do {
+			vq_kick_disable(vq);
+			/*
+			 * Run through all of the chains made available,
+			 * sending each, before a single interrupt.
+			 */
+			while (vq_has_descs(vq))
+				virtio_net_proctx(vcpu, vq);
+		} while (vq_kick_enable(vq));
 
-	/*
-	 * Generate an interrupt if needed.
-	 */
-	vq_endchains(vcpu, vq, 1);
+		/*
+		 * Generate an interrupt if needed.
+		 */
+		vq_endchains(vcpu, vq, 1);
+	}
 }
 
 static void
@@ -493,7 +317,9 @@ virtio_net_inb(u32_t port_id, struct vmrt_vm_vcpu *vcpu)
 		vcpu->shared_region->ax = virtio_net_regs.header.dev_status;
 		break;
 	case VIRTIO_NET_ISR:
+		/* reading the ISR acknowledges the interrupt */
 		vcpu->shared_region->ax = virtio_net_regs.header.ISR;
+		virtio_net_regs.header.ISR = 0;
 		break;
 	case VIRTIO_NET_STATUS:
 		vcpu->shared_region->ax = virtio_net_regs.config_reg.status; 
@@ -501,24 +327,13 @@ virtio_net_inb(u32_t port_id, struct vmrt_vm_vcpu *vcpu)
 	case VIRTIO_NET_STATUS_H:
 		vcpu->shared_region->ax = virtio_net_regs.config_reg.status >> 8; 
 		break;
-	/* TODO: read mac address from virtio-net config space */
 	case VIRTIO_NET_MAC:
-		vcpu->shared_region->ax = 0x10;
-		break;
 	case VIRTIO_NET_MAC1:
-		vcpu->shared_region->ax = 0x10;
-		break;
 	case VIRTIO_NET_MAC2:
-		vcpu->shared_region->ax = 0x10;
-		break;
 	case VIRTIO_NET_MAC3:
-		vcpu->shared_region->ax = 0x10;
-		break;
 	case VIRTIO_NET_MAC4:
-		vcpu->shared_region->ax = 0x10;
-		break;
 	case VIRTIO_NET_MAC5:
-		vcpu->shared_region->ax = 0x11;
+		vcpu->shared_region->ax = virtio_net_regs.config_reg.mac[port_id - VIRTIO_NET_MAC];
 		break;
 	default:
 		VM_PANIC(vcpu);
@@ -559,8 +374,9 @@ virtio_net_outw(u32_t port_id, struct vmrt_vm_vcpu *vcpu)
 		break;
 	case VIRTIO_NET_QUEUE_NOTIFY:
 		if (val == VIRTIO_NET_TXQ) {
-			virtio_net_tx_thread(0, vcpu);
-			virtio_net_tap_rx(vcpu);
+			sched_thd_wakeup(virtio_net_tx_tid);
+		} else if (val == VIRTIO_NET_RXQ && virtio_net_rx_waiting) {
+			sched_thd_wakeup(virtio_net_rx_tid);
 		}
 		virtio_net_regs.header.queue_notify = val;
 		break;
@@ -583,7 +399,7 @@ virtio_net_outl(u32_t port_id, struct vmrt_vm_vcpu *vcpu)
 		break;
 	case VIRTIO_NET_QUEUE_ADDR:
 		virtio_queues[virtio_net_regs.header.queue_select].queue = (void *)tmp;
-		virtio_vq_init(vcpu, virtio_net_regs.header.queue_select, val);
+		virtio_vq_init(vcpu, &virtio_net_vqs[virtio_net_regs.header.queue_select], val);
 		break;
 	default:
 		VM_PANIC(vcpu);
@@ -606,6 +422,12 @@ virtio_net_inl(u32_t port_id, struct vmrt_vm_vcpu *vcpu)
 	case VIRTIO_NET_QUEUE_ADDR:
 		vcpu->shared_region->ax = virtio_net_regs.header.queue_addr;
 		break;
+	case VIRTIO_NET_RX_SHM_ADDR:
+		vcpu->shared_region->ax = virtio_net_regs.config_reg.rx_shm_addr;
+		break;
+	case VIRTIO_NET_RX_SHM_SIZE:
+		vcpu->shared_region->ax = virtio_net_regs.config_reg.rx_shm_size;
+		break;
 	default:
 		VM_PANIC(vcpu);
 		break;
@@ -651,15 +473,60 @@ virtio_net_handler(u16_t port, int dir, int sz, struct vmrt_vm_vcpu *vcpu)
 void
 virtio_net_io_init(void)
 {
+	int i;
+
 	memset(&virtio_net_regs, 0, sizeof(virtio_net_regs));
 	memset(&virtio_queues, 0, sizeof(virtio_queues));
 	memset(&virtio_net_vqs, 0, sizeof(virtio_net_vqs));
 
 	virtio_net_regs.header.dev_features |= (1 << VIRTIO_NET_F_STATUS);
 	virtio_net_regs.header.dev_features |= (1 << VIRTIO_NET_F_MAC);
+	virtio_net_regs.header.dev_features |= (1 << VIRTIO_RING_F_EVENT_IDX);
+	virtio_net_regs.header.dev_features |= (1 << VIRTIO_NET_F_RX_SHM);
 	virtio_net_regs.config_reg.status = VIRTIO_NET_S_LINK_UP;
 	virtio_queues[0].queue_sz = VQ_MAX_DESCRIPTORS;
 	virtio_queues[1].queue_sz = VQ_MAX_DESCRIPTORS;
 	virtio_net_vqs[VIRTIO_NET_RX].qsize = VQ_MAX_DESCRIPTORS;
 	virtio_net_vqs[VIRTIO_NET_TX].qsize = VQ_MAX_DESCRIPTORS;
-}
\ No newline at end of file
+	for (i = 0; i < VIRTIO_NET_MAXQ - 1; i++) {
+		virtio_net_vqs[i].hdr         = &virtio_net_regs.header;
+		virtio_net_vqs[i].intr_vector = VIRTIO_NET_INTR_VECTOR;
+	}
+}
+
+/*
+ * Connect the device to nicmgr: the rx and tx threads each have a
+ * session, and run once the guest has set up the queues. nicmgr
+ * demultiplexes received frames on their port, so the guest shares
+ * the NIC's MAC. The rx session's packet buffers are mapped into the
+ * guest, so that frames can be lent to it in place. Only the pages
+ * past the shm_bm's bitmap and refcounts are mapped, so the guest can't
+ * corrupt the allocator's state.
+ */
+void
+virtio_net_backend_init(struct vmrt_vm_comp *vm)
+{
+	u64_t mac = nic_get_port_mac_address(0);
+	char *mac_arr = (char *)&mac;
+	size_t meta_sz;
+	vaddr_t gpa;
+	int i;
+
+	virtio_net_vm = vm;
+	virtio_net_init_tid = cos_thdid();
+
+	netshmem_create();
+	meta_sz = SHM_BM_DATA(netshmem_get_shm(), PKT_BUF_NUM) - (unsigned char *)netshmem_get_shm();
+	virtio_net_rx_shm_off = round_up_to_page(meta_sz);
+	memmgr_shared_page_map_range_in_vm(netshmem_get_shm_id(), virtio_net_rx_shm_off / PAGE_SIZE, &gpa, vm->comp_id);
+	assert(gpa);
+	virtio_net_regs.config_reg.rx_shm_addr = gpa;
+	virtio_net_regs.config_reg.rx_shm_size = round_up_to_page(shm_bm_size_net_pkt_buf()) - virtio_net_rx_shm_off;
+	for (i = 0; i < 6; i++) {
+		virtio_net_regs.config_reg.mac[i] = mac_arr[5 - i];
+	}
+
+	virtio_net_tx_tid = sched_thd_create(virtio_net_tx_thread, NULL);
+	virtio_net_rx_tid = sched_thd_create(virtio_net_rx_thread, NULL);
+	assert(virtio_net_tx_tid && virtio_net_rx_tid);
+}
@@ -2,6 +2,7 @@
 
 #include <cos_types.h>
 #include <vmrt.h>
+#include "virtio_vq.h"
 
 #define VIRTIO_NET_IO_ADDR 0x4000
 
@@ -24,8 +25,21 @@
 #define VIRTIO_NET_STATUS (VIRTIO_NET_IO_ADDR + 26)
 #define VIRTIO_NET_STATUS_H (VIRTIO_NET_IO_ADDR + 27)
 
+#define VIRTIO_NET_RX_SHM_ADDR (VIRTIO_NET_IO_ADDR + 28)
+#define VIRTIO_NET_RX_SHM_SIZE (VIRTIO_NET_IO_ADDR + 32)
+
 #define VIRTIO_NET_F_CSUM (0)
 #define VIRTIO_NET_F_GUEST_CSUM (1)
+/*
+ * Not a standard feature: the rx packet buffers shared with nicmgr are
+ * mapped into the guest at VIRTIO_NET_RX_SHM_ADDR (less the pages
+ * holding the allocator's bitmap, whose frames are copied). Rather than copying
+ * a frame into the guest's rx chain, the device points the chain's
+ * second descriptor at the frame in those buffers (and sets its length).
+ * The frame is the guest's until it makes the chain available again,
+ * so the guest must reset the descriptor's address when it does.
+ */
+#define VIRTIO_NET_F_RX_SHM (4)
 #define VIRTIO_NET_F_MAC (5)
 #define VIRTIO_NET_F_GSO (6)
 #define VIRTIO_NET_F_GUEST_TSO4 (7)
@@ -43,25 +57,18 @@
 #define VIRTIO_NET_F_CTRL_VLAN (19)
 #define VIRTIO_NET_F_GUEST_ANNOUNCE (21)
 
+/* TODO: 57 is virtio-net interrupt, should read it from somewhere else more reliable */
+#define VIRTIO_NET_INTR_VECTOR 57
+
+/*
+ * The guest's address (10.10.1.3), and the port on which nicmgr
+ * delivers its frames, both in network order.
+ */
+#define VIRTIO_NET_IP ((3U << 24) | (1U << 16) | (10U << 8) | 10U)
+#define VIRTIO_NET_PORT bswap_16(6)
+
 #define VIRTIO_NET_RINGSZ	512
 #define VIRTIO_NET_MAXSEGS	256
-#define	VQ_MAX_DESCRIPTORS	512
-
-struct virtio_header {
-	u32_t dev_features;
-	u32_t guest_features;
-	u32_t queue_addr;
-	u16_t queue_size;
-	u16_t queue_select;
-	u16_t queue_notify;
-	u8_t dev_status;
-	u8_t ISR;
-} __attribute__((packed));
-
-struct virtio_queue {
-	u16_t queue_sz;
-	void *queue;
-};
 
 #define VIRTIO_NET_S_LINK_UP 1
 #define VIRTIO_NET_S_ANNOUNCE 2
@@ -75,15 +82,11 @@ struct virtio_queue {
 
 #define VIRTIO_NET_MAXQ	3
 
-#define VRING_PAGE_BITS		12
-#define VIRTIO_PCI_VRING_ALIGN	4096
-
-#define	VQ_ALLOC	0x01	/* set once we have a pfn */
-#define	VQ_BROKED	0x02
-
 struct virtio_net_config {
 	u8_t mac[6];
 	u16_t status;
+	u32_t rx_shm_addr;
+	u32_t rx_shm_size;
 } __attribute__((packed));
 
 struct virtio_net_io_reg {
@@ -91,39 +94,6 @@ struct virtio_net_io_reg {
 	struct virtio_net_config config_reg;
 } __attribute__((packed));
 
-struct iovec
-{
-    void *iov_base;	/* Pointer to data.  */
-    size_t iov_len;	/* Length of data.  */
-};
-
-struct virtio_vq_info {
-	u16_t qsize;		/* size of this queue (a power of 2) */
-	void (*notify)(void *, struct virtio_vq_info *);
-				/* called instead of notify, if not NULL */
-
-	u16_t num;		/* the num'th queue in the virtio_base */
-
-	u16_t flags;		/* flags (see above) */
-	u16_t last_avail;	/* a recent value of avail->idx */
-	u16_t save_used;	/* saved used->idx; see vq_endchains */
-	u16_t msix_idx;		/* MSI-X index, or VIRTIO_MSI_NO_VECTOR */
-
-	u32_t pfn;		/* PFN of virt queue (not shifted!) */
-
-	volatile struct vring_desc *desc;
-				/* descriptor array */
-	volatile struct vring_avail *avail;
-				/* the "avail" ring */
-	volatile struct vring_used *used;
-				/* the "used" ring */
-
-	u32_t gpa_desc[2];	/* gpa of descriptors */
-	u32_t gpa_avail[2];	/* gpa of avail_ring */
-	u32_t gpa_used[2];	/* gpa of used_ring */
-	int enabled;		/* whether the virtqueue is enabled */
-};
-
 /*
  * Fixed network header size
  */
@@ -138,3 +108,4 @@ struct virtio_net_rxhdr {
 } __attribute__((packed));
 
 void virtio_net_handler(u16_t port, int dir, int sz, struct vmrt_vm_vcpu *vcpu);
+void virtio_net_backend_init(struct vmrt_vm_comp *vm);
@@ -0,0 +1,282 @@
+/*-
+ * Copyright (c) 2011 NetApp, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NETAPP, INC ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL NETAPP, INC OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+#include <cos_types.h>
+#include "virtio_vq.h"
+
+void *
+paddr_guest2host(uintptr_t gaddr, struct vmrt_vm_comp *vm)
+{
+	void *va = GPA2HVA(gaddr, vm);
+	return va;
+}
+
+#define roundup2(x, y)  (((x)+((y)-1))&(~((y)-1)))
+
+void
+vq_endchains(struct vmrt_vm_vcpu *vcpu, struct virtio_vq_info *vq, int used_all_avail)
+{
+	u16_t event_idx, new_idx, old_idx;
+	int intr;
+
+	if (!vq || !vq->used)
+		return;
+
+	/*
+	 * Interrupt only if the guest wants one for the chains used
+	 * since the last interrupt: with event-idx, if they moved the
+	 * used index past the used_event it published, otherwise
+	 * unless it asked for no interrupts at all.
+	 */
+	mb();
+	old_idx = vq->save_used;
+	vq->save_used = new_idx = vq->used->idx;
+	if (used_all_avail && vq_has_feature(vq, VIRTIO_F_NOTIFY_ON_EMPTY)) {
+		intr = 1;
+	} else if (vq_has_feature(vq, VIRTIO_RING_F_EVENT_IDX)) {
+		event_idx = VQ_USED_EVENT_IDX(vq);
+		intr = vring_need_event(event_idx, new_idx, old_idx);
+	} else {
+		intr = new_idx != old_idx && !(vq->avail->flags & VRING_AVAIL_F_NO_INTERRUPT);
+	}
+	if (!intr)
+		return;
+
+	vq->hdr->ISR |= VIRTIO_PCI_ISR_INTR;
+	lapic_intr_inject(vcpu, vq->intr_vector, 0);
+}
+
+void
+virtio_vq_init(struct vmrt_vm_vcpu *vcpu, struct virtio_vq_info *vq, u32_t pfn)
+{
+	u64_t phys;
+	size_t size;
+	char *vb;
+
+	vq->pfn = pfn;
+	phys = (u64_t)pfn << VRING_PAGE_BITS;
+	vb = paddr_guest2host(phys, vcpu->vm);
+	if (!vb)
+		goto error;
+
+	/* First page(s) are descriptors... */
+	vq->desc = (struct vring_desc *)vb;
+	vb += vq->qsize * sizeof(struct vring_desc);
+
+	/* ... immediately followed by "avail" ring (entirely u16_t's) */
+	vq->avail = (struct vring_avail *)vb;
+	vb += (2 + vq->qsize + 1) * sizeof(u16_t);
+
+	/* Then it's rounded up to the next page... */
+	vb = (char *)roundup2((uintptr_t)vb, VIRTIO_PCI_VRING_ALIGN);
+
+	/* ... and the last page(s) are the used ring. */
+	vq->used = (struct vring_used *)vb;
+
+	/* Start at 0 when we use it. */
+	vq->last_avail = 0;
+	vq->save_used = 0;
+
+	/* Mark queue as allocated after initialization is complete. */
+	mb();
+	vq->flags = VQ_ALLOC;
+
+	printc("%s: vq enable done\n", __func__);
+	return;
+
+error:
+	vq->flags = 0;
+	printc("%s: vq enable failed\n", __func__);
+}
+
+static inline int
+_vq_record(int i, volatile struct vring_desc *vd, u16_t desc,
+	   struct iovec *iov, int n_iov, u16_t *flags, u16_t *descs, struct vmrt_vm_vcpu *vcpu) {
+
+	void *host_addr;
+
+	if (i >= n_iov)
+		return -1;
+	host_addr = paddr_guest2host(vd->addr, vcpu->vm);
+	if (!host_addr)
+		return -1;
+	iov[i].iov_base = host_addr;
+	iov[i].iov_len = vd->len;
+	if (flags != NULL)
+		flags[i] = vd->flags;
+	if (descs != NULL)
+		descs[i] = desc;
+	return 0;
+}
+
+int
+vq_getchain(struct vmrt_vm_vcpu *vcpu, struct virtio_vq_info *vq, u16_t *pidx,
+	    struct iovec *iov, int n_iov, u16_t *flags, u16_t *descs)
+{
+	int i;
+	unsigned int ndesc, n_indir;
+	unsigned int idx, next;
+
+	volatile struct vring_desc *vdir, *vindir, *vp;
+	const char *name = "virtio";
+	/*
+	 * Note: it's the responsibility of the guest not to
+	 * update vq->avail->idx until all of the descriptors
+	 * the guest has written are valid (including all their
+	 * next fields and vd_flags).
+	 *
+	 * Compute (last_avail - idx) in integers mod 2**16.  This is
+	 * the number of descriptors the device has made available
+	 * since the last time we updated vq->last_avail.
+	 *
+	 * We just need to do the subtraction as an unsigned int,
+	 * then trim off excess bits.
+	 */
+	idx = vq->last_avail;
+	ndesc = (u16_t)((unsigned int)vq->avail->idx - idx);
+	if (ndesc == 0)
+		return 0;
+	if (ndesc > vq->qsize) {
+		/* XXX need better way to diagnose issues */
+		printc("%s: ndesc (%u) out of range, driver confused?\r\n",
+		    name, (unsigned int)ndesc);
+		return -1;
+	}
+
+	/*
+	 * Now count/parse "involved" descriptors starting from
+	 * the head of the chain.
+	 *
+	 * To prevent loops, we could be more complicated and
+	 * check whether we're re-visiting a previously visited
+	 * index, but we just abort if the count gets excessive.
+	 */
+	*pidx = next = vq->avail->ring[idx & (vq->qsize - 1)];
+	vq->last_avail++;
+	for (i = 0; i < VQ_MAX_DESCRIPTORS; next = vdir->next) {
+		if (next >= vq->qsize) {
+			printc("tx: descriptor index %u out of range, "
+			    "driver confused?\r\n",
+			     next);
+			return -1;
+		}
+		vdir = &vq->desc[next];
+		if ((vdir->flags & VRING_DESC_F_INDIRECT) == 0) {
+			if (_vq_record(i, vdir, next, iov, n_iov, flags, descs, vcpu)) {
+				printc("%s: mapping to host failed\r\n", name);
+				return -1;
+			}
+			i++;
+		} else if ((vq->hdr->dev_features &
+		    (1 << VIRTIO_RING_F_INDIRECT_DESC)) == 0) {
+			printc("%s: descriptor has forbidden INDIRECT flag, "
+			    "driver confused?\r\n",
+			    name);
+			return -1;
+		} else {
+			n_indir = vdir->len / 16;
+			if ((vdir->len & 0xf) || n_indir == 0) {
+				printc("%s: invalid indir len 0x%x, "
+				    "driver confused?\r\n",
+				    name, (unsigned int)vdir->len);
+				return -1;
+			}
+			vindir = paddr_guest2host(
+			    vdir->addr, vcpu->vm);
+
+			if (!vindir) {
+				printc("%s cannot get host memory\r\n", name);
+				return -1;
+			}
+			/*
+			 * Indirects start at the 0th, then follow
+			 * their own embedded "next"s until those run
+			 * out.  Each one's indirect flag must be off
+			 * (we don't really have to check, could just
+			 * ignore errors...).
+			 */
+			next = 0;
+			for (;;) {
+				vp = &vindir[next];
+				if (vp->flags & VRING_DESC_F_INDIRECT) {
+					printc("%s: indirect desc has INDIR flag,"
+					    " driver confused?\r\n",
+					    name);
+					return -1;
+				}
+				if (_vq_record(i, vp, VQ_DESC_INDIRECT, iov, n_iov, flags, descs, vcpu)) {
+					printc("%s: mapping to host failed\r\n", name);
+					return -1;
+				}
+				if (++i > VQ_MAX_DESCRIPTORS)
+					goto loopy;
+				if ((vp->flags & VRING_DESC_F_NEXT) == 0)
+					break;
+				next = vp->next;
+				if (next >= n_indir) {
+					printc("%s: invalid next %u > %u, "
+					    "driver confused?\r\n",
+					    name, (unsigned int)next, n_indir);
+					return -1;
+				}
+			}
+		}
+		if ((vdir->flags & VRING_DESC_F_NEXT) == 0)
+			return i;
+	}
+loopy:
+	printc("%s: descriptor loop? count > %d - driver confused?\r\n",
+	    name, i);
+	return -1;
+}
+
+void
+vq_relchain(struct virtio_vq_info *vq, u16_t idx, u32_t iolen)
+{
+	u16_t uidx, mask;
+	volatile struct vring_used *vuh;
+	volatile struct vring_used_elem *vue;
+
+	/*
+	 * Notes:
+	 *  - mask is N-1 where N is a power of 2 so computes x % N
+	 *  - vuh points to the "used" data shared with guest
+	 *  - vue points to the "used" ring entry we want to update
+	 *  - head is the same value we compute in vq_iovecs().
+	 *
+	 * (I apologize for the two fields named idx; the
+	 * virtio spec calls the one that vue points to, "id"...)
+	 */
+	mask = vq->qsize - 1;
+	vuh = vq->used;
+
+	uidx = vuh->idx;
+	vue = &vuh->ring[uidx++ & mask];
+	vue->id = idx;
+	vue->len = iolen;
+	vuh->idx = uidx;
+}
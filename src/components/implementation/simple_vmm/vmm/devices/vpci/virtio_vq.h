@@ -0,0 +1,164 @@
+#pragma once
+
+/*
+ * The virtqueues of the legacy virtio devices: the register header
+ * that the devices share at the start of their io bar, and the
+ * handling of their descriptor chains.
+ */
+
+#include <cos_types.h>
+#include <vmrt.h>
+#include "virtio_ring.h"
+
+/* The offsets of the header's registers in a device's io bar */
+#define VIRTIO_PCI_DEV_FEATURES 0
+#define VIRTIO_PCI_GUEST_FEATURES 4
+#define VIRTIO_PCI_QUEUE_ADDR 8
+#define VIRTIO_PCI_QUEUE_SIZE 12
+#define VIRTIO_PCI_QUEUE_SELECT 14
+#define VIRTIO_PCI_QUEUE_NOTIFY 16
+#define VIRTIO_PCI_DEV_STATUS 18
+#define VIRTIO_PCI_ISR 19
+#define VIRTIO_PCI_CONFIG 20
+
+#define VIRTIO_F_NOTIFY_ON_EMPTY (24)
+
+#define VIRTIO_PCI_ISR_INTR 0x1
+
+#define	VQ_MAX_DESCRIPTORS	512
+
+struct virtio_header {
+	u32_t dev_features;
+	u32_t guest_features;
+	u32_t queue_addr;
+	u16_t queue_size;
+	u16_t queue_select;
+	u16_t queue_notify;
+	u8_t dev_status;
+	u8_t ISR;
+} __attribute__((packed));
+
+struct virtio_queue {
+	u16_t queue_sz;
+	void *queue;
+};
+
+#define VRING_PAGE_BITS		12
+#define VIRTIO_PCI_VRING_ALIGN	4096
+
+#define	VQ_ALLOC	0x01	/* set once we have a pfn */
+#define	VQ_BROKED	0x02
+
+/* With VIRTIO_RING_F_EVENT_IDX, each side publishes an index after the other's ring */
+#define VQ_USED_EVENT_IDX(vq) ((vq)->avail->ring[(vq)->qsize])
+#define VQ_AVAIL_EVENT_IDX(vq) (*(volatile u16_t *)&(vq)->used->ring[(vq)->qsize])
+
+#define mb()    ({ asm volatile("mfence" ::: "memory"); (void)0; })
+
+struct iovec
+{
+    void *iov_base;	/* Pointer to data.  */
+    size_t iov_len;	/* Length of data.  */
+};
+
+struct virtio_vq_info {
+	u16_t qsize;		/* size of this queue (a power of 2) */
+	void (*notify)(void *, struct virtio_vq_info *);
+				/* called instead of notify, if not NULL */
+
+	u16_t num;		/* the num'th queue in the virtio_base */
+
+	u16_t flags;		/* flags (see above) */
+	u16_t last_avail;	/* a recent value of avail->idx */
+	u16_t save_used;	/* saved used->idx; see vq_endchains */
+	u16_t msix_idx;		/* MSI-X index, or VIRTIO_MSI_NO_VECTOR */
+
+	u32_t pfn;		/* PFN of virt queue (not shifted!) */
+
+	struct virtio_header *hdr;
+				/* registers of the device */
+	int intr_vector;	/* vector of the device's interrupt */
+
+	volatile struct vring_desc *desc;
+				/* descriptor array */
+	volatile struct vring_avail *avail;
+				/* the "avail" ring */
+	volatile struct vring_used *used;
+				/* the "used" ring */
+
+	u32_t gpa_desc[2];	/* gpa of descriptors */
+	u32_t gpa_avail[2];	/* gpa of avail_ring */
+	u32_t gpa_used[2];	/* gpa of used_ring */
+	int enabled;		/* whether the virtqueue is enabled */
+};
+
+static inline int
+vq_ring_ready(struct virtio_vq_info *vq)
+{
+	return vq->flags & VQ_ALLOC;
+}
+
+static inline int
+vq_has_descs(struct virtio_vq_info *vq)
+{
+	int ret = 0;
+	if (vq_ring_ready(vq) && vq->last_avail != vq->avail->idx) {
+		if ((u16_t)((unsigned int)vq->avail->idx - vq->last_avail) > vq->qsize)
+			printc ("no valid descriptor\n");
+		else
+			ret = 1;
+	}
+	return ret;
+
+}
+
+static inline int
+vq_has_feature(struct virtio_vq_info *vq, int feature)
+{
+	return vq->hdr->guest_features & (1U << feature);
+}
+
+/*
+ * Suppress the guest's notifications while we are processing the
+ * queue. With event-idx, the guest only notifies when it makes
+ * available the chain at avail_event, so leaving it behind is enough.
+ */
+static inline void
+vq_kick_disable(struct virtio_vq_info *vq)
+{
+	if (!vq_has_feature(vq, VIRTIO_RING_F_EVENT_IDX))
+		vq->used->flags |= VRING_USED_F_NO_NOTIFY;
+}
+
+/*
+ * Ask for a notification of the next chain the guest makes
+ * available. Returns whether chains raced with this, in which case
+ * the caller should process them instead of waiting.
+ */
+static inline int
+vq_kick_enable(struct virtio_vq_info *vq)
+{
+	if (!vq_ring_ready(vq))
+		return 0;
+
+	if (vq_has_feature(vq, VIRTIO_RING_F_EVENT_IDX))
+		VQ_AVAIL_EVENT_IDX(vq) = vq->last_avail;
+	else
+		vq->used->flags &= ~VRING_USED_F_NO_NOTIFY;
+	mb();
+
+	return vq_has_descs(vq);
+}
+
+void *paddr_guest2host(uintptr_t gaddr, struct vmrt_vm_comp *vm);
+void virtio_vq_init(struct vmrt_vm_vcpu *vcpu, struct virtio_vq_info *vq, u32_t pfn);
+/*
+ * descs (if not NULL) gets the index in the ring of each descriptor of
+ * the chain, or VQ_DESC_INDIRECT for those in an indirect table. Use
+ * these rather than following the guest's next fields again.
+ */
+#define VQ_DESC_INDIRECT 0xffff
+int vq_getchain(struct vmrt_vm_vcpu *vcpu, struct virtio_vq_info *vq, u16_t *pidx,
+		struct iovec *iov, int n_iov, u16_t *flags, u16_t *descs);
+void vq_relchain(struct virtio_vq_info *vq, u16_t idx, u32_t iolen);
+void vq_endchains(struct vmrt_vm_vcpu *vcpu, struct virtio_vq_info *vq, int used_all_avail);
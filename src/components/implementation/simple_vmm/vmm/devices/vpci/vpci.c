@@ -2,8 +2,8 @@
 #include <cos_debug.h>
 #include "vpci.h"
 
-/* Only two are supported: one bridge pci and one virtio-net pci */
-#define MAX_VPCI_NUM 2
+/* Only three are supported: one bridge pci, one virtio-net pci, and one virtio-blk pci */
+#define MAX_VPCI_NUM 3
 
 #define PCI_HOST_BRIDGE_VENDOR		0x8086
 #define PCI_HOST_BRIDGE_DEV		0x29C0
@@ -260,7 +260,7 @@ set_vpci_reg(u32_t bdf, u32_t val, u8_t idx, u8_t sz)
 	memcpy(&vbdf, &bdf, sizeof(vbdf));
 
 	index = vbdf.bus_num + vbdf.dev_num;
-	if (vbdf.bus_num > 0 || vbdf.dev_num > 1) return;
+	if (vbdf.bus_num > 0 || vbdf.dev_num >= MAX_VPCI_NUM) return;
 
 	vpci = &vpci_devs[index];
 
@@ -295,7 +295,7 @@ get_vpci_reg(u32_t bdf)
 	memcpy(&vbdf, &bdf, sizeof(vbdf));
 	index = vbdf.bus_num + vbdf.dev_num;
 
-	if (vbdf.bus_num > 0 || vbdf.dev_num > 1) return 0XFFFFFFFF;
+	if (vbdf.bus_num > 0 || vbdf.dev_num >= MAX_VPCI_NUM) return 0XFFFFFFFF;
 
 	vpci = &vpci_devs[index];
 
@@ -303,6 +303,7 @@ get_vpci_reg(u32_t bdf)
 }
 
 extern void virtio_net_dev_init(void);
+extern void virtio_blk_dev_init(void);
 
 static void __attribute__((constructor))
 init(void)
@@ -310,4 +311,5 @@ init(void)
 	memset(&vpci_devs, 0, sizeof(vpci_devs));
 	vpci_regist((struct vpci_config_space *)&vpci_host_bridge, sizeof(vpci_host_bridge));
 	virtio_net_dev_init();
+	virtio_blk_dev_init();
 }
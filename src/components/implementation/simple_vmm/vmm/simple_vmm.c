@@ -22,8 +22,13 @@ INCBIN(bios, "guest/guest.img")
 
 /* Currently only have one VM component globally managed by this VMM */
 static struct vmrt_vm_comp *g_vm;
+/* The guest's memory, shared with the devices' backends */
+static cbuf_t g_vm_mem_id;
 
 #define VM_MAX_COMPS (2)
+/* contigmem physically aligns memory at least this aligned */
+#define VM_MEM_LARGE_PAGE_SZ (1 << 21)
+#define VM_BSP_APIC_ID (3)
 
 SS_STATIC_SLAB(vm_comp, struct vmrt_vm_comp, VM_MAX_COMPS);
 SS_STATIC_SLAB(vm_lapic, struct acrn_vlapic, VM_MAX_COMPS * VMRT_VM_MAX_VCPU);
@@ -47,7 +52,8 @@ init_lapic(struct vmrt_vm_vcpu *vcpu)
 	/* Status: enable APIC and vector be 0xFF */
 	lapic->svr.v = 0x1FF;
 	lapic->version.v = 0x50015;
-	lapic->id.v = 0x3000000;
+	/* The BSP keeps the id 3 it has always had, the APs follow it */
+	lapic->id.v = (VM_BSP_APIC_ID + vcpu->cpuid) << 24;
 
 	lapic->dfr.v = 0xFFFFFFFFU;
 	lapic->icr_timer.v = 0U;
@@ -64,11 +70,12 @@ struct vmrt_vm_comp *
 vm_comp_create(void)
 {
 	u64_t guest_mem_sz = 64*1024*1024;
-	u64_t num_vpu = 1;
+	/* A vcpu on each core (see cos_parallel_init) */
+	u64_t num_vpu = NUM_CPU;
 	void *start;
 	void *end;
 	cbuf_t shm_id;
-	void  *mem, *vm_mem;
+	void  *mem, *vm_mem, *pad;
 	size_t sz;
 
 	struct vmrt_vm_comp *vm = ss_vm_comp_alloc();
@@ -76,8 +83,16 @@ vm_comp_create(void)
 	
 	vmrt_vm_create(vm, "vmlinux-5.15", num_vpu, guest_mem_sz);
 
-	/* Allocate memory for the VM */
+	/*
+	 * Allocate memory for the VM. Guest memory starts at GPA 4K, so
+	 * place it a page after a 2M-aligned physical address (contigmem
+	 * allocates contiguously): guest and host physical addresses are
+	 * then congruent, and the EPT maps the guest memory with 2M pages.
+	 */
+	contigmem_shared_alloc_aligned(1, VM_MEM_LARGE_PAGE_SZ, (vaddr_t *)&pad);
 	shm_id	= contigmem_shared_alloc_aligned(guest_mem_sz / PAGE_SIZE_4K, PAGE_SIZE_4K, (vaddr_t *)&mem);
+	assert(mem == pad + PAGE_SIZE_4K);
+	g_vm_mem_id = shm_id;
 	/* Make the memory accessible to VM */
 	memmgr_shared_page_map_aligned_in_vm(shm_id, PAGE_SIZE_4K, (vaddr_t *)&vm_mem, vm->comp_id);
 	vmrt_vm_mem_init(vm, mem);
@@ -105,10 +120,15 @@ vm_comp_create(void)
 	return vm;
 }
 
+extern void virtio_net_backend_init(struct vmrt_vm_comp *vm);
+extern void virtio_blk_backend_init(struct vmrt_vm_comp *vm, cbuf_t mem_id);
+
 void
 cos_init(void)
 {
 	g_vm = vm_comp_create();
+	virtio_net_backend_init(g_vm);
+	virtio_blk_backend_init(g_vm, g_vm_mem_id);
 }
 
 void
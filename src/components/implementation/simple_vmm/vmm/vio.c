@@ -5,6 +5,7 @@
 #include "devices/vrtc/vrtc.h"
 #include "devices/vps2/vps2.h"
 #include "devices/vpci/virtio_net_io.h"
+#include "devices/vpci/virtio_blk_io.h"
 
 void 
 io_handler(struct vmrt_vm_vcpu *vcpu)
@@ -63,11 +64,27 @@ io_handler(struct vmrt_vm_vcpu *vcpu)
 	case VIRTIO_NET_MAC5:
 	case VIRTIO_NET_STATUS:
 	case VIRTIO_NET_STATUS_H:	
+	case VIRTIO_NET_RX_SHM_ADDR:
+	case VIRTIO_NET_RX_SHM_SIZE:
 		virtio_net_handler(port_id, access_dir, access_sz, vcpu);
 		goto done;	
+	case VIRTIO_BLK_DEV_FEATURES:
+	case VIRTIO_BLK_GUEST_FEATURES:
+	case VIRTIO_BLK_QUEUE_ADDR:
+	case VIRTIO_BLK_QUEUE_SIZE:
+	case VIRTIO_BLK_QUEUE_SELECT:
+	case VIRTIO_BLK_QUEUE_NOTIFY:
+	case VIRTIO_BLK_DEV_STATUS:
+	case VIRTIO_BLK_ISR:
+		virtio_blk_handler(port_id, access_dir, access_sz, vcpu);
+		goto done;
 	default:
 		break;
 	}
+	if (port_id >= VIRTIO_BLK_CONFIG && port_id < VIRTIO_BLK_CONFIG_END) {
+		virtio_blk_handler(port_id, access_dir, access_sz, vcpu);
+		goto done;
+	}
 
 	switch (port_id)
 	{
@@ -633,6 +633,41 @@ vlapic_set_error(struct acrn_vlapic *vlapic, uint32_t mask)
 	}
 }
 
+/* Is the target vcpu a destination of the IPI? */
+static bool
+vlapic_ipi_is_dest(struct acrn_vlapic *vlapic, struct vmrt_vm_vcpu *target_vcpu, uint32_t dest,
+		   bool phys, bool is_broadcast, uint32_t shorthand)
+{
+	struct acrn_vlapic *target = vcpu_vlapic(target_vcpu);
+	struct lapic_regs *lapic;
+
+	/* The vcpu isn't initialized (on its core) yet */
+	if (target == NULL) {
+		return false;
+	}
+	lapic = target->apic_page;
+
+	switch (shorthand) {
+	case APIC_DEST_SELF:
+		return target == vlapic;
+	case APIC_DEST_ALLISELF:
+		return true;
+	case APIC_DEST_ALLESELF:
+		return target != vlapic;
+	default:
+		break;
+	}
+
+	if (is_broadcast) {
+		return true;
+	}
+	if (phys) {
+		return dest == (lapic->id.v >> APIC_ID_SHIFT);
+	}
+	/* Flat logical mode: the destination is a mask of logical ids */
+	return (dest & (lapic->ldr.v >> 24U)) != 0U;
+}
+
 static void vlapic_write_icrlo(struct acrn_vlapic *vlapic)
 {
 	uint16_t vcpu_id;
@@ -669,13 +704,30 @@ static void vlapic_write_icrlo(struct acrn_vlapic *vlapic)
 		printc("Invalid ICR value");
 		assert(0);
 	} else {
-		struct vmrt_vm_vcpu *vcpu = vlapic2vcpu(vlapic);
+		struct vmrt_vm_comp *vm = vlapic2vcpu(vlapic)->vm;
 
-		printc(
-			"icrlo 0x%08x icrhi 0x%08x triggered ipi %u",
-				icr_low, icr_high, vec);
+		for (vcpu_id = 0U; vcpu_id < vm->num_vpu; vcpu_id++) {
+			target_vcpu = vmrt_get_vcpu(vm, vcpu_id);
+			if (!vlapic_ipi_is_dest(vlapic, target_vcpu, dest, phys, is_broadcast, shorthand)) {
+				continue;
+			}
 
-		assert(0);
+			switch (mode) {
+			case APIC_DELMODE_FIXED:
+				lapic_intr_inject(target_vcpu, vec, 0);
+				break;
+			case APIC_DELMODE_INIT:
+				/* vcpus wait for their startup IPI from their creation */
+				break;
+			case APIC_DELMODE_STARTUP:
+				vmrt_vcpu_startup(target_vcpu, vec);
+				break;
+			default:
+				printc("icrlo 0x%08x icrhi 0x%08x: unsupported ipi mode 0x%x\n",
+					icr_low, icr_high, mode);
+				assert(0);
+			}
+		}
 	}
 }
 
@@ -1411,8 +1463,16 @@ lapic_intr_inject(struct vmrt_vm_vcpu *vcpu, u8_t vector, int autoeoi)
 	u8_t offset = vector / 32;
 	u8_t bit = vector % 32;
 
-	u8_t svi = (u8_t)(shared_region->interrupt_status >> 8);
-	u8_t rvi = (u8_t)shared_region->interrupt_status;
+	u8_t svi, rvi;
+
+	/* Other threads post the interrupt to the vcpu's handler */
+	if (cos_thdid() != vcpu->handler_tid) {
+		vmrt_vcpu_intr_post(vcpu, vector);
+		return;
+	}
+
+	svi = (u8_t)(shared_region->interrupt_status >> 8);
+	rvi = (u8_t)shared_region->interrupt_status;
 
 	if (svi == vector && autoeoi) {
 		/* TODO: svi should be the second highest priority bit in isr */
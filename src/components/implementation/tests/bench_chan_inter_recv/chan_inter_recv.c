@@ -19,9 +19,14 @@ struct evt e;
 /* Keep these settings below consistent with the sender side */
 #define READER_HIGH
 #define USE_EVTMGR
+/* #define CHAN_BATCH 8 */
 
 #define TEST_CHAN_ITEM_SZ   sizeof(u32_t)
+#ifdef CHAN_BATCH
+#define TEST_CHAN_NSLOTS    (CHAN_BATCH * 2)
+#else
 #define TEST_CHAN_NSLOTS    2
+#endif
 #define TEST_CHAN_SEND_ID   3
 #define TEST_CHAN_RECV_ID   4
 /* We are the receiver, and we don't care about data gathering */
@@ -33,6 +38,10 @@ struct evt e;
 
 typedef unsigned int cycles_32_t;
 
+#ifdef CHAN_BATCH
+cycles_32_t batch[CHAN_BATCH];
+#endif
+
 int
 main(void)
 {
@@ -68,11 +77,26 @@ main(void)
 	/* Never stops running; sender controls how many iters to run. */
 	while(1) {
 		debug("r1,");
+#ifdef CHAN_BATCH
+		/* Reply only once the entire batch has been received */
+		for (int n = 0; n < CHAN_BATCH; ) {
+			int ret;
+
+#ifdef USE_EVTMGR
+			while ((ret = chan_recv_batch(&r, batch + n, CHAN_BATCH - n, CHAN_NONBLOCKING)) == 0) evt_get(&e, EVT_WAIT_DEFAULT, &evtsrc, &evtdata);
+#else
+			ret = chan_recv_batch(&r, batch + n, CHAN_BATCH - n, 0);
+#endif
+			n += ret;
+		}
+		tmp = batch[0];
+#else
 #ifdef USE_EVTMGR
 		/* Receive from the events then the channel */
 		while (chan_recv(&r, &tmp, CHAN_NONBLOCKING) == CHAN_TRY_AGAIN) evt_get(&e, EVT_WAIT_DEFAULT, &evtsrc, &evtdata);
 #else
 		chan_recv(&r, &tmp, 0);
+#endif
 #endif
 		debug("tsr1: %d,", tmp);
 		debug("r2,");
@@ -22,9 +22,19 @@ struct evt e;
 #define READER_HIGH
 #define USE_EVTMGR
 /* #define PRINT_ALL */
+/*
+ * Send CHAN_BATCH timestamps per iteration with a single
+ * chan_send_batch, and have the receiver reply once per batch. The
+ * channels must be configured with TEST_CHAN_NSLOTS slots.
+ */
+/* #define CHAN_BATCH 8 */
 
 #define TEST_CHAN_ITEM_SZ   sizeof(u32_t)
+#ifdef CHAN_BATCH
+#define TEST_CHAN_NSLOTS    (CHAN_BATCH * 2)
+#else
 #define TEST_CHAN_NSLOTS    2
+#endif
 #define TEST_CHAN_SEND_ID   4
 #define TEST_CHAN_RECV_ID   3
 /* We are the sender, and we will be responsible for collecting resulting data */
@@ -40,6 +50,9 @@ struct perfdata perf1, perf2, perf3;
 cycles_t result1[ITERATION] = {0, };
 cycles_t result2[ITERATION] = {0, };
 cycles_t result3[ITERATION] = {0, };
+#ifdef CHAN_BATCH
+cycles_32_t batch[CHAN_BATCH];
+#endif
 
 int
 main(void)
@@ -81,7 +94,12 @@ main(void)
 		ts1 = time_now();
 		debug("ts1: %d,", ts1);
 		debug("w2,");
+#ifdef CHAN_BATCH
+		for (int j = 0; j < CHAN_BATCH; j++) batch[j] = ts1;
+		chan_send_batch(&s, batch, CHAN_BATCH, 0);
+#else
 		chan_send(&s, &ts1, 0);
+#endif
 		debug("w3,");
 #ifdef USE_EVTMGR
 		/* Receive from the events then the channel */
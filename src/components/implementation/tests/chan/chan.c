@@ -50,6 +50,121 @@ receiver(void *d)
 	assert(0);
 }
 
+#define MP_NSENDERS 2
+
+struct mp_item {
+	int sender, seq;
+};
+struct chan_snd mp_s[MP_NSENDERS];
+struct chan_rcv mp_r;
+
+void
+mp_sender(void *d)
+{
+	int id = (int)(word_t)d;
+	int i;
+
+	for (i = 0; i < COMM_AMNT; i++) {
+		struct mp_item item = { .sender = id, .seq = i };
+
+		if (chan_send(&mp_s[id], &item, 0)) {
+			printc("chan_send (MPSC) error\n");
+			assert(0);
+		}
+	}
+	sched_thd_block(0);
+	assert(0);
+}
+
+void
+mp_receiver(void *d)
+{
+	int next[MP_NSENDERS] = { 0 };
+	int i;
+
+	for (i = 0; i < COMM_AMNT * MP_NSENDERS; i++) {
+		struct mp_item item;
+
+		if (chan_recv(&mp_r, &item, 0)) {
+			printc("chan_recv (MPSC) error\n");
+			assert(0);
+		}
+		/* Each sender's items must be received in order */
+		assert(item.sender >= 0 && item.sender < MP_NSENDERS);
+		assert(item.seq == next[item.sender]);
+		next[item.sender]++;
+	}
+
+	printc("MPSC: received all items from %d senders in order\n", MP_NSENDERS);
+
+	sched_thd_wakeup(init_thd);
+	sched_thd_block(0);
+	assert(0);
+}
+
+static void
+mpsc_test(void)
+{
+	struct chan c;
+	thdid_t tid;
+	int i;
+
+	if (chan_init(&c, sizeof(struct mp_item), 64, CHAN_MPSC)) {
+		printc("chan_init (MPSC) failure.\n");
+		assert(0);
+	}
+	if (chan_rcv_init(&mp_r, &c)) assert(0);
+
+	tid = sched_thd_create(mp_receiver, NULL);
+	assert(tid);
+	sched_thd_param_set(tid, sched_param_pack(SCHEDP_PRIO, 4));
+	for (i = 0; i < MP_NSENDERS; i++) {
+		if (chan_snd_init(&mp_s[i], &c)) assert(0);
+		tid = sched_thd_create(mp_sender, (void *)(word_t)i);
+		assert(tid);
+		sched_thd_param_set(tid, sched_param_pack(SCHEDP_PRIO, 5));
+	}
+
+	sched_thd_block(0);
+}
+
+#define BATCH_SZ 8
+
+/* Batched and in-place sends, all on the same thread so nothing blocks */
+static void
+batch_test(void)
+{
+	struct chan c;
+	int items[BATCH_SZ], i, j;
+	int *slot;
+
+	if (chan_init(&c, sizeof(int), BATCH_SZ * 2, CHAN_DEFAULT)) assert(0);
+	if (chan_snd_init(&s, &c) || chan_rcv_init(&r, &c)) assert(0);
+
+	for (i = 0; i < COMM_AMNT; i += BATCH_SZ) {
+		for (j = 0; j < BATCH_SZ; j++) items[j] = i + j;
+		if (chan_send_batch(&s, items, BATCH_SZ, 0) != BATCH_SZ) assert(0);
+		memset(items, 0, sizeof(items));
+		if (chan_recv_batch(&r, items, BATCH_SZ, 0) != BATCH_SZ) assert(0);
+		for (j = 0; j < BATCH_SZ; j++) assert(items[j] == i + j);
+	}
+	/* only `nslots - 1` items fit, and the remainder is reported */
+	assert(chan_send_batch(&s, items, BATCH_SZ * 2, CHAN_NONBLOCKING) == BATCH_SZ * 2 - 1);
+	assert(chan_recv_batch(&r, items, BATCH_SZ * 2, CHAN_NONBLOCKING) == BATCH_SZ * 2 - 1);
+	assert(chan_recv_batch(&r, items, BATCH_SZ, CHAN_NONBLOCKING) == 0);
+
+	for (i = 0; i < COMM_AMNT; i++) {
+		slot = chan_send_reserve(&s, 0);
+		assert(slot);
+		*slot = i;
+		if (chan_send_commit(&s)) assert(0);
+		if (chan_recv(&r, &j, 0)) assert(0);
+		assert(j == i);
+	}
+
+	printc("Batched and reserve/commit sends received in order\n");
+}
+
 int
 main(void)
 {
@@ -91,6 +206,8 @@ main(void)
 	}
 
 	sched_thd_block(0);
+	mpsc_test();
+	batch_test();
 	printc("Chan test: SUCCESS.\n");
 
 	return 0;
@@ -1,13 +1,14 @@
 #include <cos_component.h>
 #include <llprint.h>
 #include <cos_types.h>
+#include <chkpt.h>
 
 /* 
  * USE THE chkpt.toml RUNSCRIPT FOR THIS TEST TO PASS
  * UNCOMMENT THE #DEFINE ENABLE_CHKPT IN llbooter.c FOR THIS TEST TO PASS
  * Component IDs are hardcoded: 
  * we must be creating a checkpoint of component with ID 2
- * and the component created from the checkpoint must have ID 3
+ * and the components created from the checkpoint must have IDs from 3
  */
 static compid_t test_compid = 2;
 static compid_t chkpt_compid = 3;
@@ -30,11 +31,30 @@ cos_parallel_init(coreid_t cid, int init_core, int ncores)
 	}
 }
 
+/* More than the booter's pool, so that instances are recycled */
+#define CHKPT_NACQUIRE 16
+
 void
-parallel_main(coreid_t cid)
+parallel_main(coreid_t cid, int init_core, int ncores)
 {
-	assert(cos_compid() == chkpt_compid);
+	compid_t id;
+	int i;
+
+	assert(test_var == 5);
+
+	if (cos_compid() != test_compid) {
+		/* An instance: the next one must see the checkpoint's value, not this */
+		test_var = 7;
+		return;
+	}
+
+	/* The first instance has run, and exited: acquire (and run) others */
+	if (!init_core) return;
+	for (i = 0; i < CHKPT_NACQUIRE; i++) {
+		id = chkpt_acquire(test_compid);
+		assert(id >= chkpt_compid);
+	}
 	assert(test_var == 5);
 
-	printc("Success: Checkpoint created and executed\n");
+	printc("Success: Checkpoint created, and its instances executed and recycled\n");
 }
@@ -44,6 +44,10 @@
 /* Two options are available: Sender at low/high prio, data words 4 */
 #define DATA_WORDS 2
 
+/* Items per batch for the batched selfloop, and the slots in its channel */
+#define BATCH_SZ     16
+#define BATCH_NSLOTS (BATCH_SZ * 2)
+
 thdid_t chan_reader = 0, chan_writer = 0;
 
 typedef unsigned int cycles_32_t;
@@ -72,12 +76,19 @@ cycles_t result3[ITERATION] = {
   0,
 };
 
+cycles_32_t batch[BATCH_SZ] = {
+  0,
+};
+
 patina_chan_t   cid;
 patina_chan_t   cid2;
+patina_chan_t   cid3;
 patina_chan_r_t rid;
 patina_chan_r_t rid2;
+patina_chan_r_t rid3;
 patina_chan_s_t sid;
 patina_chan_s_t sid2;
+patina_chan_s_t sid3;
 
 volatile char pool[CACHE_SIZE * 4] = {
   0,
@@ -182,6 +193,25 @@ test_chan(void)
 	perfdata_calc(&perf1);
 	perfdata_print(&perf1);
 
+	/* The same selfloop, but amortizing the index updates and wakeups across a batch */
+	perfdata_init(&perf1, "Uncontended channel - batched selfloop (per item)", result1, ITERATION);
+	for (i = 0; i < ITERATION; i++) {
+		begin = time_now();
+
+		debug("send batch\n");
+		patina_channel_send_batch(sid3, batch, BATCH_SZ, 0);
+		debug("recv batch\n");
+		if (patina_channel_recv_batch(rid3, batch, BATCH_SZ, 0) != BATCH_SZ) assert(0);
+
+		end = time_now();
+		perfdata_add(&perf1, (end - begin) / BATCH_SZ);
+	}
+#ifdef PRINT_ALL
+	perfdata_raw(&perf1);
+#endif
+	perfdata_calc(&perf1);
+	perfdata_print(&perf1);
+
 	perfdata_init(&perf1, "Contended channel - reader high use this", result1, ITERATION);
 	perfdata_init(&perf2, "Contended channel - writer high use this", result2, ITERATION);
 	perfdata_init(&perf3, "Contended channel - roundtrip", result3, ITERATION);
@@ -212,6 +242,7 @@ main(void)
 
 	cid  = patina_channel_create(sizeof(cycles_32_t), DATA_WORDS, 0, CHAN_DEFAULT);
 	cid2 = patina_channel_create(sizeof(cycles_32_t), DATA_WORDS, 0, CHAN_DEFAULT);
+	cid3 = patina_channel_create(sizeof(cycles_32_t), BATCH_NSLOTS, 0, CHAN_DEFAULT);
 
 	printc("Initializing end points\n");
 
@@ -219,6 +250,8 @@ main(void)
 	rid  = patina_channel_get_recv(cid);
 	sid2 = patina_channel_get_send(cid2);
 	rid2 = patina_channel_get_recv(cid2);
+	sid3 = patina_channel_get_send(cid3);
+	rid3 = patina_channel_get_recv(cid3);
 
 	test_chan();
 
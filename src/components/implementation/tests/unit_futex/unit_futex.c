@@ -0,0 +1,170 @@
+/*
+ * Test the futexes of posix_sched: WAIT/WAKE, timeouts (that are cut
+ * short by wakeups), and (CMP_)REQUEUE, including timeouts of requeued
+ * waiters.
+ */
+
+#include <cos_component.h>
+#include <cos_debug.h>
+#include <llprint.h>
+#include <sched.h>
+#include <cos_time.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+
+#define FUTEX_WAIT		0
+#define FUTEX_WAKE		1
+#define FUTEX_REQUEUE		3
+#define FUTEX_CMP_REQUEUE	4
+
+/* Long enough for the waiters to block */
+#define SETTLE_US 1000
+#define TIMEOUT_US 2000
+#define LONG_TIMEOUT_US 1000000
+
+int cos_futex(int *uaddr, int op, int val, const struct timespec *timeout, int *uaddr2, int val3);
+
+struct waiter {
+	int *uaddr;
+	int val;
+	microsec_t timeout;
+	volatile int ret;
+	volatile int done;
+	cycles_t elapsed;
+};
+
+static int f1, f2;
+
+static void
+settle(microsec_t us)
+{
+	sched_thd_block_timeout(0, time_now() + time_usec2cyc(us));
+}
+
+static void
+waiter_fn(void *d)
+{
+	struct waiter *w = d;
+	struct timespec ts, *t = NULL;
+	cycles_t start;
+
+	if (w->timeout) {
+		ts.tv_sec  = w->timeout / 1000000;
+		ts.tv_nsec = (w->timeout % 1000000) * 1000;
+		t = &ts;
+	}
+	start      = time_now();
+	w->ret     = cos_futex(w->uaddr, FUTEX_WAIT, w->val, t, NULL, 0);
+	w->elapsed = time_now() - start;
+	w->done    = 1;
+
+	while (1) sched_thd_block(0);
+}
+
+static void
+waiter_start(struct waiter *w, int *uaddr, int val, microsec_t timeout)
+{
+	*w = (struct waiter) {
+		.uaddr   = uaddr,
+		.val     = val,
+		.timeout = timeout,
+	};
+	assert(sched_thd_create(waiter_fn, w));
+}
+
+static void
+waiter_join(struct waiter *w)
+{
+	while (!w->done) settle(SETTLE_US);
+}
+
+static void
+test_wait_wake(void)
+{
+	struct waiter w;
+
+	f1 = 0;
+	assert(cos_futex(&f1, FUTEX_WAIT, 1, NULL, NULL, 0) == -EAGAIN);
+	assert(cos_futex(&f1, FUTEX_WAKE, 1, NULL, NULL, 0) == 0);
+
+	waiter_start(&w, &f1, 0, 0);
+	settle(SETTLE_US);
+	assert(!w.done);
+
+	f1 = 1;
+	assert(cos_futex(&f1, FUTEX_WAKE, INT_MAX, NULL, NULL, 0) == 1);
+	waiter_join(&w);
+	assert(w.ret == 0);
+
+	printc("futex: wait/wake passed\n");
+}
+
+static void
+test_timeout(void)
+{
+	struct waiter w;
+
+	f1 = 0;
+	waiter_start(&w, &f1, 0, TIMEOUT_US);
+	waiter_join(&w);
+	assert(w.ret == -ETIMEDOUT);
+	assert(w.elapsed >= time_usec2cyc(TIMEOUT_US));
+
+	/* A wakeup ends a timed wait well before its timeout */
+	waiter_start(&w, &f1, 0, LONG_TIMEOUT_US);
+	settle(SETTLE_US);
+	assert(!w.done);
+	assert(cos_futex(&f1, FUTEX_WAKE, 1, NULL, NULL, 0) == 1);
+	waiter_join(&w);
+	assert(w.ret == 0);
+	assert(w.elapsed < time_usec2cyc(LONG_TIMEOUT_US));
+
+	printc("futex: timeouts passed\n");
+}
+
+static void
+test_requeue(void)
+{
+	struct waiter w[2];
+
+	f1 = f2 = 0;
+	waiter_start(&w[0], &f1, 0, 0);
+	waiter_start(&w[1], &f1, 0, 0);
+	settle(SETTLE_US);
+
+	assert(cos_futex(&f1, FUTEX_CMP_REQUEUE, 1, (struct timespec *)INT_MAX, &f2, 1) == -EAGAIN);
+	/* Wake one, and move the other to f2 */
+	assert(cos_futex(&f1, FUTEX_CMP_REQUEUE, 1, (struct timespec *)INT_MAX, &f2, 0) == 2);
+	settle(SETTLE_US);
+	assert(w[0].done + w[1].done == 1);
+
+	assert(cos_futex(&f1, FUTEX_WAKE, INT_MAX, NULL, NULL, 0) == 0);
+	assert(cos_futex(&f2, FUTEX_WAKE, INT_MAX, NULL, NULL, 0) == 1);
+	waiter_join(&w[0]);
+	waiter_join(&w[1]);
+	assert(w[0].ret == 0 && w[1].ret == 0);
+
+	/* A requeued waiter times out from its new futex */
+	waiter_start(&w[0], &f1, 0, TIMEOUT_US);
+	settle(SETTLE_US / 2);
+	assert(cos_futex(&f1, FUTEX_REQUEUE, 0, (struct timespec *)1, &f2, 0) == 1);
+	waiter_join(&w[0]);
+	assert(w[0].ret == -ETIMEDOUT);
+	assert(cos_futex(&f2, FUTEX_WAKE, INT_MAX, NULL, NULL, 0) == 0);
+
+	printc("futex: requeue passed\n");
+}
+
+int
+main(void)
+{
+	test_wait_wake();
+	test_timeout();
+	test_requeue();
+
+	printc("SUCCESS: futex tests passed\n");
+
+	return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * Test printing through a log ring drained by print.logring: lines
+ * printed by many printcs on each core (which should each come out
+ * whole, with one prefix), prints of many lines, and a burst that
+ * overflows the ring, whose prints are dropped (and reported), after
+ * which the printer drains the ring.
+ */
+
+#include <cos_component.h>
+#include <cos_debug.h>
+#include <llprint.h>
+#include <ps.h>
+#include <sched.h>
+#include <cos_time.h>
+#include <print.h>
+
+#define NLINES 16
+/*
+ * Records are at least 16 bytes, and the printer drains at most 64 of
+ * them each millisecond, so this overflows the ring.
+ */
+#define BURST  (PRINT_RING_SZ / 4)
+/* Milliseconds to wait for the printer to drain the ring */
+#define DRAIN_WAIT_MS 1000
+
+static word_t barrier_cnt;
+
+static void
+barrier(word_t round, int ncores)
+{
+	ps_faa(&barrier_cnt, 1);
+	while (ps_load(&barrier_cnt) < round * ncores) ;
+}
+
+void
+cos_init(void)
+{
+	int ret = print_ring_init();
+
+	assert(ret == 0);
+	assert(print_ring_init() == -EEXIST);
+}
+
+void
+parallel_main(coreid_t cid, int init_core, int ncores)
+{
+	int i;
+
+	for (i = 0; i < NLINES; i++) {
+		printc("core %d: ", cid);
+		printc("line %d ", i);
+		printc("of %d\n", NLINES);
+	}
+	printc("core %d: first of two lines\ncore %d: second of two lines\n", cid, cid);
+	barrier(1, ncores);
+
+	if (init_core) {
+		for (i = 0; i < BURST; i++) printc("burst %d\n", i);
+		assert(__atomic_load_n(&print_ring->dropped, __ATOMIC_RELAXED) > 0);
+
+		for (i = 0; __atomic_load_n(&print_ring->tail, __ATOMIC_ACQUIRE) != __atomic_load_n(&print_ring->head, __ATOMIC_RELAXED); i++) {
+			assert(i < DRAIN_WAIT_MS);
+			sched_thd_block_timeout(0, time_now() + time_usec2cyc(1000));
+		}
+		printc("Log ring test: SUCCESS (if the lines above are whole, and drops are reported)\n");
+	}
+
+	return;
+}
+
+int
+main(void)
+{
+	/* It should never come here */
+	assert(0);
+
+	return 0;
+}
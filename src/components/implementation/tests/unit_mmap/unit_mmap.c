@@ -0,0 +1,80 @@
+/*
+ * Test the anonymous mappings of posix_cap: the reuse of unmapped
+ * areas, shrinking and growing mremaps in place, and moving mremaps.
+ * This component makes no other mappings, so the areas are allocated
+ * from the memory manager at increasing addresses.
+ */
+
+#define _GNU_SOURCE
+#include <cos_component.h>
+#include <cos_debug.h>
+#include <llprint.h>
+#include <assert.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define P PAGE_SIZE
+
+static void *
+map(size_t sz)
+{
+	void *m = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	assert(m != MAP_FAILED);
+
+	return m;
+}
+
+static int
+is_filled(char *m, size_t sz, char val)
+{
+	size_t i;
+
+	for (i = 0; i < sz; i++) {
+		if (m[i] != val) return 0;
+	}
+
+	return 1;
+}
+
+int
+main(void)
+{
+	char *a, *b, *c, *d;
+
+	/* An unmapped area is reused, and cleared */
+	a = map(4 * P);
+	memset(a, 1, 4 * P);
+	assert(munmap(a, 4 * P) == 0);
+	assert(munmap(a, 4 * P) == -1 && errno == EINVAL);
+	b = map(4 * P);
+	assert(b == a && is_filled(b, 4 * P, 0));
+
+	/* Shrink, then grow back in place into the freed tail */
+	memset(b, 2, 4 * P);
+	assert(mremap(b, 4 * P, 2 * P, 0) == b);
+	assert(munmap(b + 2 * P, 2 * P) == -1 && errno == EINVAL);
+	assert(mremap(b, 2 * P, 4 * P, 0) == b);
+	assert(is_filled(b, 2 * P, 2) && is_filled(b + 2 * P, 2 * P, 0));
+
+	/* c is after b, so b can only grow by moving */
+	c = map(P);
+	assert(c >= b + 4 * P);
+	memset(b, 3, 4 * P);
+	assert(mremap(b, 4 * P, 8 * P, 0) == MAP_FAILED && errno == ENOMEM);
+	d = mremap(b, 4 * P, 8 * P, MREMAP_MAYMOVE);
+	assert(d != MAP_FAILED && d != b);
+	assert(is_filled(d, 4 * P, 3) && is_filled(d + 4 * P, 4 * P, 0));
+	assert(mremap(b, 4 * P, 4 * P, 0) == MAP_FAILED && errno == EFAULT);
+
+	/* The area the mapping moved from is reused */
+	a = map(4 * P);
+	assert(a == b);
+
+	assert(munmap(a, 4 * P) == 0 && munmap(c, P) == 0 && munmap(d, 8 * P) == 0);
+	printc("mmap test: SUCCESS\n");
+
+	return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * Test pcmalloc: objects allocated on one core and freed on another
+ * (and then reallocated on the first), and large and aligned
+ * allocations, including alignments over a slab.
+ */
+
+#include <cos_component.h>
+#include <cos_debug.h>
+#include <llprint.h>
+#include <ps.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#define NOBJ    512
+#define SLAB_SZ (1UL << 16)
+
+static char    *objs[NOBJ];
+static word_t   barrier_cnt;
+
+static void
+barrier(word_t round, int ncores)
+{
+	ps_faa(&barrier_cnt, 1);
+	while (ps_load(&barrier_cnt) < round * ncores) ;
+}
+
+static inline size_t
+obj_sz(int i)
+{
+	/* From 1 byte to the largest size class */
+	return (i * 37) % 8192 + 1;
+}
+
+static void
+objs_alloc(void)
+{
+	int i;
+
+	for (i = 0; i < NOBJ; i++) {
+		objs[i] = malloc(obj_sz(i));
+		assert(objs[i]);
+		assert(((unsigned long)objs[i] & 15) == 0);
+		assert(malloc_usable_size(objs[i]) >= obj_sz(i));
+		memset(objs[i], i & 0xff, obj_sz(i));
+	}
+}
+
+/* The objects don't overlap, so none overwrote another's pattern */
+static void
+objs_check_free(void)
+{
+	size_t j;
+	int i;
+
+	for (i = 0; i < NOBJ; i++) {
+		for (j = 0; j < obj_sz(i); j++) assert(objs[i][j] == (char)(i & 0xff));
+		free(objs[i]);
+		objs[i] = NULL;
+	}
+}
+
+static void
+test_large(void)
+{
+	size_t align;
+	char *p, *q;
+
+	p = malloc(3 * SLAB_SZ);
+	assert(p && malloc_usable_size(p) >= 3 * SLAB_SZ);
+	memset(p, 1, 3 * SLAB_SZ);
+	q = realloc(p, 5 * SLAB_SZ);
+	assert(q && q[3 * SLAB_SZ - 1] == 1);
+	free(q);
+
+	/* Up to, and over, a slab: the latter's header is forwarded to */
+	for (align = 128; align <= 8 * SLAB_SZ; align *= 2) {
+		p = memalign(align, 1000);
+		assert(p && ((unsigned long)p & (align - 1)) == 0);
+		assert(malloc_usable_size(p) >= 1000);
+		memset(p, 2, 1000);
+		free(p);
+
+		p = memalign(align, 2 * SLAB_SZ);
+		assert(p && ((unsigned long)p & (align - 1)) == 0);
+		assert(malloc_usable_size(p) >= 2 * SLAB_SZ);
+		free(p);
+	}
+	assert(posix_memalign((void **)&p, 3 * SLAB_SZ, 16) != 0);
+}
+
+void
+cos_init(void)
+{
+	assert(NUM_CPU >= 2);
+}
+
+void
+parallel_main(coreid_t cid, int init_core, int ncores)
+{
+	test_large();
+	barrier(1, ncores);
+
+	/* Allocated on core 0, and freed on core 1 */
+	if (cid == 0) objs_alloc();
+	barrier(2, ncores);
+	if (cid == 1) objs_check_free();
+	barrier(3, ncores);
+
+	/* Core 0 takes back the remotely freed objects */
+	if (cid == 0) {
+		objs_alloc();
+		objs_check_free();
+		printc("pcmalloc test: SUCCESS\n");
+	}
+
+	return;
+}
+
+int
+main(void)
+{
+	/* It should never come here */
+	assert(0);
+
+	return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef BLKDEV_H
+#define BLKDEV_H
+
+/***
+ * A block device of 512 byte sectors. Rather than passing data
+ * through the invocations, the client shares its memory with the
+ * server, which reads and writes the sectors directly to and from
+ * it. A request can scatter (gather) consecutive sectors over many
+ * segments of that memory, which are described in a page of
+ * segments that the client also shares.
+ */
+
+#include <cos_types.h>
+#include <cos_component.h>
+#include <cos_stubs.h>
+
+#define BLKDEV_SECTOR_SZ 512
+
+/* A segment of the client's shared memory */
+struct blkdev_seg {
+	unsigned long off;
+	unsigned long len;
+};
+
+#define BLKDEV_MAX_SEGS (PAGE_SIZE / sizeof(struct blkdev_seg))
+
+/**
+ * Share memory with the block device.
+ *
+ * - @data - the memory that segments refer to (by their offset)
+ * - @segs - a page holding the segments of requests
+ * - @return - `0` on success, `-n` for error `n`
+ */
+int blkdev_shmem_map(cbuf_t data, cbuf_t segs);
+
+/**
+ * - @return - the number of sectors of the device.
+ */
+u64_t blkdev_capacity(void);
+
+/**
+ * Read (write) the sectors starting at `sector` into (from) the first
+ * `nsegs` segments in the segment page, in order. A request that
+ * ends within a sector only transfers the start of that sector.
+ *
+ * - @return - `0` on success, `-n` for error `n`
+ */
+int blkdev_readv(u64_t sector, unsigned long nsegs);
+int blkdev_writev(u64_t sector, unsigned long nsegs);
+
+/**
+ * Make the writes so far durable.
+ *
+ * - @return - `0` on success, `-n` for error `n`
+ */
+int blkdev_flush(void);
+
+#endif /* BLKDEV_H */
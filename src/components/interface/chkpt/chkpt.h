@@ -0,0 +1,33 @@
+#ifndef CHKPT_H
+#define CHKPT_H
+
+/***
+ * Components that have completed their initialization can be
+ * checkpointed by the booter, and new components can be created from
+ * the checkpoint. The booter keeps a pool of instances created from
+ * each checkpoint that are ready to run, so that they can be handed
+ * out without creating their resource tables, memory, and threads.
+ * Instances that exit are reset to the checkpoint, and returned to
+ * the pool.
+ */
+
+#include <cos_types.h>
+#include <cos_stubs.h>
+
+/**
+ * Acquire an instance of the checkpoint of component `id`, and
+ * execute it until it exits, after which it is returned to the pool.
+ * This can only be called by components that the booter executes
+ * (i.e. that are not scheduled by a scheduler), on the core that
+ * checkpointed `id`.
+ *
+ * - @id - the checkpointed component
+ * - @return - the id of the instance that executed, or `0` if there
+ *   is no checkpoint of `id`, all of its instances are in use, or the
+ *   caller can't execute them.
+ */
+compid_t chkpt_acquire(compid_t id);
+/***/
+compid_t COS_STUB_DECL(chkpt_acquire)(compid_t id);
+
+#endif /* CHKPT_H */
@@ -39,4 +39,7 @@ unsigned long COS_STUB_DECL(memmgr_shared_page_map_aligned)(cbuf_t id, unsigned
 unsigned long memmgr_shared_page_map_aligned_in_vm(cbuf_t id, unsigned long align, vaddr_t *pgaddr, compid_t cid);
 unsigned long COS_STUB_DECL(memmgr_shared_page_map_aligned_in_vm)(cbuf_t id, unsigned long align, vaddr_t *pgaddr, compid_t cid);
 
+unsigned long memmgr_shared_page_map_range_in_vm(cbuf_t id, unsigned long off, vaddr_t *pgaddr, compid_t cid);
+unsigned long COS_STUB_DECL(memmgr_shared_page_map_range_in_vm)(cbuf_t id, unsigned long off, vaddr_t *pgaddr, compid_t cid);
+
 #endif /* MEMMGR_H */
@@ -61,3 +61,15 @@ COS_CLIENT_STUB(unsigned long, memmgr_shared_page_map_aligned_in_vm, cbuf_t id,
 
 	return ret;
 }
+
+COS_CLIENT_STUB(unsigned long, memmgr_shared_page_map_range_in_vm, cbuf_t id, unsigned long off, vaddr_t *pgaddr, compid_t cid)
+{
+	COS_CLIENT_INVCAP;
+	word_t unused, addrret;
+	unsigned long ret;
+
+	ret = cos_sinv_2rets(uc, id, off, cid, 0, &addrret, &unused);
+	*pgaddr = addrret;
+
+	return ret;
+}
@@ -25,3 +25,8 @@ COS_SERVER_3RET_STUB(unsigned long, memmgr_shared_page_map_aligned_in_vm)
 {
 	return memmgr_shared_page_map_aligned_in_vm(p0, p1, r1, p2);
 }
+
+COS_SERVER_3RET_STUB(unsigned long, memmgr_shared_page_map_range_in_vm)
+{
+	return memmgr_shared_page_map_range_in_vm(p0, p1, r1, p2);
+}
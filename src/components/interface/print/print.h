@@ -3,6 +3,8 @@
 
 #include <cos_component.h>
 #include <cos_stubs.h>
+#include <string.h>
+#include <errno.h>
 
 /**
  * `print_str_chunk` prints out three chunks of a string, serialized
@@ -24,4 +26,116 @@
 int print_str_chunk(u32_t chunk0, u32_t chunk1, u32_t chunk2, int len);
 int COS_STUB_DECL(print_str_chunk)(u32_t chunk0, u32_t chunk1, u32_t chunk2, int len);
 
+/***
+ * A log ring is memory a client shares with the printer so that its
+ * prints don't invoke it at all: `cos_print_str` copies each string
+ * into the ring as a record, and the printer drains the records and
+ * writes them out in batches. The client's threads reserve records
+ * with a `cas` on `head`, and commit them by setting
+ * `PRINT_RING_COMMITTED` in the record's length, so the client never
+ * takes a lock. The printer consumes committed records in order,
+ * zeroes them, and advances `tail`. When the ring is full, the client
+ * drops the print rather than wait, and counts it in `dropped`.
+ */
+
+#define PRINT_RING_SZ        (1 << 14)
+#define PRINT_RING_COMMITTED (1U << 31)
+/* The longest string in a record; longer prints are split across records */
+#define PRINT_RING_REC_MAX   256
+
+struct print_ring_rec {
+	u32_t len;
+	u16_t coreid;
+	u16_t thdid;
+	u32_t compid;
+	u32_t unused;
+};
+
+struct print_ring {
+	/* Bytes reserved by the client's threads */
+	u64_t head CACHE_ALIGNED;
+	/* Bytes consumed by the printer */
+	u64_t tail CACHE_ALIGNED;
+	/* Prints dropped by the client as the ring was full */
+	u64_t dropped;
+	char  data[PRINT_RING_SZ] CACHE_ALIGNED;
+};
+
+#define PRINT_RING_PAGES (round_up_to_page(sizeof(struct print_ring)) / PAGE_SIZE)
+
+/*
+ * Records are padded to the header's size, so the header never wraps
+ * around the end of the ring (the string might).
+ */
+static inline unsigned long
+print_ring_rec_sz(int len)
+{
+	return round_up_to_pow2(sizeof(struct print_ring_rec) + len, sizeof(struct print_ring_rec));
+}
+
+/*
+ * Copy a string of at most `PRINT_RING_REC_MAX` bytes into a record
+ * of the ring `r`. Returns `0`, or `-EAGAIN` if the ring is full.
+ */
+static inline int
+print_ring_write(struct print_ring *r, compid_t compid, char *s, int len)
+{
+	struct print_ring_rec *rec;
+	unsigned long sz = print_ring_rec_sz(len), off, first;
+	u64_t head;
+
+	head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+	do {
+		if (head + sz - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) > PRINT_RING_SZ) {
+			__atomic_fetch_add(&r->dropped, 1, __ATOMIC_RELAXED);
+			return -EAGAIN;
+		}
+	} while (!__atomic_compare_exchange_n(&r->head, &head, head + sz, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	off = head & (PRINT_RING_SZ - 1);
+	rec = (struct print_ring_rec *)&r->data[off];
+	rec->coreid = cos_coreid();
+	rec->thdid  = cos_thdid();
+	rec->compid = compid;
+
+	off  += sizeof(struct print_ring_rec);
+	first = PRINT_RING_SZ - off;
+	if (first >= (unsigned long)len) {
+		memcpy(&r->data[off], s, len);
+	} else {
+		memcpy(&r->data[off], s, first);
+		memcpy(r->data, s + first, len - first);
+	}
+	__atomic_store_n(&rec->len, (u32_t)len | PRINT_RING_COMMITTED, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/**
+ * `print_ring_attach` shares a log ring with the printer, which then
+ * drains it.
+ *
+ * - `@ring` - the shared memory (of `PRINT_RING_PAGES` pages) holding
+ *   the zeroed `struct print_ring`.
+ * - `@return` - `0` on success, `-EEXIST` if the client already has a
+ *   ring, and `-ENOTSUP` if the printer doesn't drain rings.
+ */
+int print_ring_attach(cbuf_t ring);
+int COS_STUB_DECL(print_ring_attach)(cbuf_t ring);
+
+/**
+ * `print_ring_init` allocates the client's log ring, and attaches it
+ * to the printer so that all subsequent `printc`s go through it. The
+ * client must depend on `memmgr`. Call it once, before the client's
+ * threads print concurrently.
+ *
+ * - `@return` - `0` on success, or the error of the allocation or of
+ *   `print_ring_attach`, in which case the client keeps printing
+ *   through `print_str_chunk`.
+ */
+int print_ring_init(void);
+
+/* The client's log ring, NULL until `print_ring_init` attaches it */
+extern struct print_ring *print_ring;
+
 #endif /* PRINT_H */
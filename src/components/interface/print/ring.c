@@ -0,0 +1,29 @@
+/*
+ * Separate from `lib.c` so that only the clients that use log rings
+ * (and thus depend on `memmgr`) link with it.
+ */
+
+#include <print.h>
+#include <memmgr.h>
+
+extern struct print_ring *print_ring;
+
+int
+print_ring_init(void)
+{
+	struct print_ring *r;
+	cbuf_t id;
+	int ret;
+
+	if (print_ring) return -EEXIST;
+
+	id = memmgr_shared_page_allocn(PRINT_RING_PAGES, (vaddr_t *)&r);
+	if (id == 0) return -ENOMEM;
+	memset(r, 0, sizeof(struct print_ring));
+
+	ret = print_ring_attach(id);
+	if (ret) return ret;
+	print_ring = r;
+
+	return 0;
+}
@@ -29,10 +29,24 @@ int      sched_thd_wakeup(thdid_t t);
 int      COS_STUB_DECL(sched_thd_wakeup)(thdid_t t);
 int      sched_debug_thd_state(thdid_t t);
 int      COS_STUB_DECL(sched_debug_thd_state)(thdid_t t);
+/*
+ * Is the thread runnable on a core other than the caller's, thus
+ * possibly executing in parallel? Used for adaptive spinning.
+ */
+int      sched_thd_running(thdid_t t);
+int      COS_STUB_DECL(sched_thd_running)(thdid_t t);
 int      sched_thd_block(thdid_t dep_id);
 int      COS_STUB_DECL(sched_thd_block)(thdid_t dep_id);
 cycles_t sched_thd_block_timeout(thdid_t dep_id, cycles_t abs_timeout);
 cycles_t COS_STUB_DECL(sched_thd_block_timeout)(thdid_t dep_id, cycles_t abs_timeout);
+/*
+ * Block until woken by sched_thd_wakeup, or until abs_timeout, which
+ * ever comes first (sched_thd_block_timeout ignores wakeups). A wakeup
+ * that raced ahead of the block is not lost. Returns the time at which
+ * the thread returns, so the caller can tell if it timed out.
+ */
+cycles_t sched_thd_block_wakeable(thdid_t dep_id, cycles_t abs_timeout);
+cycles_t COS_STUB_DECL(sched_thd_block_wakeable)(thdid_t dep_id, cycles_t abs_timeout);
 
 void     sched_set_tls(void* tls_addr);
 unsigned long sched_get_cpu_freq(void);
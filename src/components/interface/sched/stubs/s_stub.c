@@ -14,6 +14,18 @@ COS_SERVER_3RET_STUB(int, sched_thd_block_timeout)
 	return 0;
 }
 
+COS_SERVER_3RET_STUB(int, sched_thd_block_wakeable)
+{
+	cycles_t now, abs_timeout;
+
+	COS_ARG_WORDS_TO_DWORD(p1, p2, abs_timeout);
+	now = sched_thd_block_wakeable((thdid_t)p0, abs_timeout);
+	*r1 = (now >> 32);
+	*r2 = (now << 32) >> 32;
+
+	return 0;
+}
+
 COS_SERVER_3RET_STUB(thdid_t, sched_aep_create_closure)
 {
 	struct cos_defcompinfo *dci;
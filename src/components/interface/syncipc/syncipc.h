@@ -7,6 +7,10 @@
  * A simple API to mimic the L4-based synchronous rendezvous between
  * threads. Use `call` and `reply_wait` to minimize "system calls" (in
  * our case, thread migration-based invocations).
+ *
+ * Each endpoint can be served by a pool of server threads (any
+ * thread that `reply_wait`s on it), and clients that `call` while all
+ * servers are busy are queued in FIFO order.
  */
 
 /**
@@ -26,4 +30,20 @@ int syncipc_call(int ipc_ep, word_t arg0, word_t arg1, word_t *ret0, word_t *ret
  */
 int syncipc_reply_wait(int ipc_ep, word_t arg0, word_t arg1, word_t *ret0, word_t *ret1);
 
+typedef enum {
+	SYNCIPC_CNT_CALL,   /* calls made on the endpoint */
+	SYNCIPC_CNT_QUEUED, /* ...that had to wait for a busy server */
+	SYNCIPC_CNT_RET,    /* calls that returned with a reply */
+	SYNCIPC_CNT_REPLY,  /* replies sent by servers */
+	SYNCIPC_CNT_WAIT,   /* servers that went idle awaiting a call */
+	SYNCIPC_CNT_MAX
+} syncipc_counter_t;
+
+/**
+ * `syncipc_counter` returns the value of an endpoint's counter. The
+ * counters are only maintained if the server is compiled with
+ * `SYNCIPC_COUNTERS` defined, and are otherwise always `0`.
+ */
+word_t syncipc_counter(int ipc_ep, syncipc_counter_t type);
+
 #endif /* SYNCIPC_H */
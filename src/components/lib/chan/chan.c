@@ -47,6 +47,7 @@ __chan_gather_resources(struct __chan_meta *m, chan_id_t id, unsigned int item_s
 		.nslots          = nslots,
 		.item_sz         = item_sz,
 		.wraparound_mask = (1 << log32(nslots)) - 1,
+		.flags           = flags,
 		.id              = id,
 		.cbuf_id         = cb,
 		.blkpt_full_id   = full,
@@ -65,7 +66,6 @@ chan_init(struct chan *c, unsigned int item_sz, unsigned int nslots, chan_flags_
 	int ret;
 
 	assert((flags & CHAN_EXACT_SIZE) == 0);
-	assert((flags & CHAN_MPSC) == 0);
 	nslots = (unsigned int)nlepow2((u32_t)nslots);
 
 	id = chanmgr_create(item_sz, nslots, flags);
@@ -79,7 +79,8 @@ chan_init(struct chan *c, unsigned int item_sz, unsigned int nslots, chan_flags_
 int
 chan_snd_init_with(struct chan_snd *s, chan_id_t cap_id, unsigned int item_sz, unsigned int nslots, chan_flags_t flags)
 {
-	s->c = NULL;
+	s->c        = NULL;
+	s->reserved = NULL;
 	return __chan_gather_resources(&s->meta, cap_id, item_sz, nslots, flags);
 }
 
@@ -145,8 +146,10 @@ chan_rcv_get_chan(struct chan_rcv *r)
 }
 
 unsigned int
-chan_mem_sz(unsigned int item_sz, unsigned int slots)
+chan_mem_sz(unsigned int item_sz, unsigned int slots, chan_flags_t flags)
 {
+	if (__chan_is_mp(flags)) return sizeof(struct __chan_mem) + __chan_slot_sz(item_sz) * slots;
+
 	return sizeof(struct __chan_mem) + item_sz * slots;
 }
 
@@ -9,8 +9,9 @@
 
 /***
  * Channel implementation that enables intra- and inter-core
- * communication. Currently, we assume only single-producer,
- * single-consumer communication (SPSC).
+ * communication. By default, channels are single-producer,
+ * single-consumer (SPSC), and `CHAN_MPSC` or `CHAN_MPMC` at
+ * initialization select multi-producer variants.
  */
 
 /* Internal implementation details of the channel */
@@ -40,7 +41,11 @@ chan_send(struct chan_snd *c, void *item, chan_comm_t flags)
 {
 	int ret;
 
-	ret = __chan_send_pow2(c, item, c->meta.wraparound_mask, c->meta.item_sz, !(flags & CHAN_NONBLOCKING));
+	if (__chan_is_mp(c->meta.flags)) {
+		ret = __chan_send_mp_pow2(c, item, c->meta.wraparound_mask, c->meta.item_sz, !(flags & CHAN_NONBLOCKING));
+	} else {
+		ret = __chan_send_pow2(c, item, c->meta.wraparound_mask, c->meta.item_sz, !(flags & CHAN_NONBLOCKING));
+	}
 	if (likely(ret == 0)) {
 		return 0;
 	} else if (ret > 0) {
@@ -72,7 +77,12 @@ static inline int
 chan_recv(struct chan_rcv *c, void *item, chan_comm_t flags)
 {
 	int ret;
-	ret = __chan_recv_pow2(c, item, c->meta.wraparound_mask, c->meta.item_sz, !(flags & CHAN_NONBLOCKING));
+
+	if (__chan_is_mp(c->meta.flags)) {
+		ret = __chan_recv_mp_pow2(c, item, c->meta.wraparound_mask, c->meta.item_sz, !(flags & CHAN_NONBLOCKING), c->meta.flags & CHAN_MPMC);
+	} else {
+		ret = __chan_recv_pow2(c, item, c->meta.wraparound_mask, c->meta.item_sz, !(flags & CHAN_NONBLOCKING));
+	}
 	if (likely(ret == 0)) {
 		return 0;
 	} else if (ret > 0) {
@@ -83,6 +93,84 @@ chan_recv(struct chan_rcv *c, void *item, chan_comm_t flags)
 	}
 }
 
+/**
+ * `chan_send_batch` sends an array of `nitems` items to the channel,
+ * waking up the receiver once per batch, rather than once per
+ * item. Unless `CHAN_NONBLOCKING` is passed, this blocks until all
+ * items have been sent. Otherwise, it sends as many items as fit.
+ *
+ * - @c      - Channel to send to.
+ * - @items  - Array of `nitems` items, each of the channel's item size.
+ * - @nitems - The number of items to send.
+ * - @flags  - The flags.
+ * - @return - The number of items sent (only `< nitems` with
+ *             `CHAN_NONBLOCKING`, `0` if the channel was full), or
+ *             `-CHAN_ERR_*` if an error occurred.
+ */
+static inline int
+chan_send_batch(struct chan_snd *c, void *items, unsigned int nitems, chan_comm_t flags)
+{
+	int ret;
+
+	ret = __chan_send_batch_pow2(c, items, nitems, c->meta.wraparound_mask, c->meta.item_sz, !(flags & CHAN_NONBLOCKING));
+	if (unlikely(ret < 0)) return -CHAN_ERR_INVAL_ARG;
+
+	return ret;
+}
+
+/**
+ * `chan_recv_batch` receives up to `nitems` items off of the channel
+ * into an array. Unless `CHAN_NONBLOCKING` is passed, this blocks
+ * only until the channel is non-empty, so it can return fewer items
+ * than requested.
+ *
+ * - @c      - Channel to receive from.
+ * - @items  - Array with space for `nitems` items.
+ * - @nitems - The maximum number of items to receive.
+ * - @flags  - The flags.
+ * - @return - The number of items received (`0` only with
+ *             `CHAN_NONBLOCKING` if the channel was empty).
+ */
+static inline int
+chan_recv_batch(struct chan_rcv *c, void *items, unsigned int nitems, chan_comm_t flags)
+{
+	return __chan_recv_batch_pow2(c, items, nitems, c->meta.wraparound_mask, c->meta.item_sz, !(flags & CHAN_NONBLOCKING));
+}
+
+/**
+ * `chan_send_reserve` and `chan_send_commit` enable large items to
+ * be written directly into the channel's memory, avoiding the copy in
+ * `chan_send`. `chan_send_reserve` returns a pointer to the next
+ * slot, which the sender fills, then makes visible to the receiver
+ * with `chan_send_commit`. Only a single reservation can be
+ * outstanding per send endpoint, and for SPSC channels, reserving
+ * doesn't advance the ring, thus commits must not be interleaved with
+ * `chan_send`s on the same endpoint.
+ *
+ * - @c      - Channel to send to.
+ * - @flags  - The flags.
+ * - @return - `chan_send_reserve`: A pointer to the slot of the
+ *             channel's item size, or `NULL` if `CHAN_NONBLOCKING` was
+ *             passed and the channel is full. `chan_send_commit`: `0`
+ *             on success, or `-CHAN_ERR_*` if there is no reservation,
+ *             or an error occurred.
+ */
+static inline void *
+chan_send_reserve(struct chan_snd *c, chan_comm_t flags)
+{
+	assert(c->reserved == NULL);
+
+	return __chan_send_reserve_pow2(c, c->meta.wraparound_mask, c->meta.item_sz, !(flags & CHAN_NONBLOCKING));
+}
+
+static inline int
+chan_send_commit(struct chan_snd *c)
+{
+	if (unlikely(__chan_send_commit_pow2(c, c->meta.wraparound_mask))) return -CHAN_ERR_INVAL_ARG;
+
+	return 0;
+}
+
 /**
  * `chan_init` initializes a channel data-structure, and creates a new
  * channel with `slots` items each of maximum size `item_sz`.
@@ -143,9 +231,10 @@ int  chan_teardown(struct chan *c);
  *
  * - @item_sz - size of each item
  * - @slots   - number of items
+ * - @flags   - the channel's flags (multi-producer channels require more memory)
  * - @return  - number of bytes required for the channel's memory
  */
-unsigned int chan_mem_sz(unsigned int item_sz, unsigned int slots);
+unsigned int chan_mem_sz(unsigned int item_sz, unsigned int slots, chan_flags_t flags);
 
 /**
  * Add the event resource id into the channel so that when a send
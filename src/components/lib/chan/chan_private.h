@@ -61,6 +61,9 @@ struct chan {
 struct chan_snd {
 	struct __chan_meta meta;
 	struct chan *c;
+	/* The slot handed out by `chan_send_reserve`, awaiting `chan_send_commit` */
+	void *reserved;
+	u32_t reserved_ticket;
 };
 
 struct chan_rcv {
@@ -124,6 +127,29 @@ __chan_consume_pow2(struct __chan_mem *m, void *d, u32_t wraparound_mask, u32_t
 
 void __chan_meta_evt_update(struct __chan_meta *meta);
 
+/*
+ * Wake up the receivers, and trigger the receiver's event after items
+ * have been produced into the channel. Batched sends call this once
+ * per batch, rather than once per item.
+ */
+static inline int
+__chan_send_notify(struct chan_snd *s)
+{
+	struct __chan_meta *meta = &s->meta;
+	struct __chan_mem  *m    = meta->mem;
+
+	sync_blkpt_id_trigger(&m->empty, meta->blkpt_empty_id, 0);
+	if (unlikely(m->producer_update)) {
+		m->producer_update = 0;
+		__chan_meta_evt_update(meta);
+	}
+	if (meta->evt_id) {
+		if (evt_trigger(meta->evt_id)) return -1;
+	}
+
+	return 0;
+}
+
 /**
  * The next two functions pass all of the variables in via arguments,
  * so that we can use them for constant propagation along with
@@ -145,17 +171,8 @@ __chan_send_pow2(struct chan_snd *s, void *item, u32_t wraparound_mask, u32_t it
 
 		sync_blkpt_checkpoint(&m->full, &chkpt);
 		if (!__chan_produce_pow2(m, item, wraparound_mask, item_sz)) {
-			struct __chan_meta *meta = &s->meta;
-
 			/* success! */
-			sync_blkpt_id_trigger(&m->empty, s->meta.blkpt_empty_id, 0);
-			if (unlikely(meta->mem->producer_update)) {
-				meta->mem->producer_update = 0;
-				__chan_meta_evt_update(meta);
-			}
-			if (meta->evt_id) {
-				if (evt_trigger(meta->evt_id)) return -1;
-			}
+			if (__chan_send_notify(s)) return -1;
 			break;
 		}
 		if (!blking) return 1;
@@ -195,6 +212,415 @@ __chan_recv_pow2(struct chan_rcv *r, void *item, u32_t wraparound_mask, u32_t it
 	return 0;
 }
 
+/***
+ * Multi-producer (`CHAN_MPSC`) and multi-producer, multi-consumer
+ * (`CHAN_MPMC`) channels. These use a ticketed ring in the same
+ * `__chan_mem` layout: `producer` and `consumer` are tickets, and each
+ * slot is prefixed with a `turn` word that sequences the producer and
+ * consumer of each ticket. For ticket `t` in round `r` (`t / nslots`),
+ * the producer waits for `turn == 2r`, and the consumer for
+ * `turn == 2r + 1`. Producers (and, for MPMC, consumers) claim tickets
+ * with a `cas` only once the slot is ready, so non-blocking operations
+ * never wait on another thread's in-progress operation. Zeroed memory
+ * is a valid, empty channel.
+ */
+
+struct __chan_slot {
+	u32_t turn;
+	char  item[0];
+} __attribute__((aligned(sizeof(word_t))));
+
+/* The tickets are 32 bit, so we can't use `ps_cas` which is word-sized */
+static inline int
+__chan_cas32(u32_t *target, u32_t old, u32_t updated)
+{ return __sync_bool_compare_and_swap(target, old, updated); }
+
+static inline int
+__chan_is_mp(chan_flags_t flags)
+{ return flags & (CHAN_MPSC | CHAN_MPMC); }
+
+static inline u32_t
+__chan_slot_sz(u32_t item_sz)
+{ return round_up_to_pow2(sizeof(struct __chan_slot) + item_sz, sizeof(word_t)); }
+
+static inline struct __chan_slot *
+__chan_slot_mp(struct __chan_mem *m, u32_t ticket, u32_t wraparound_mask, u32_t item_sz)
+{ return (struct __chan_slot *)(m->mem + (__chan_buff_idx_pow2(ticket, wraparound_mask) * __chan_slot_sz(item_sz))); }
+
+/* The producer's turn for a ticket. As nslots = mask + 1 is a power of two, this wraps correctly. */
+static inline u32_t
+__chan_turn_mp(u32_t ticket, u32_t wraparound_mask)
+{ return (ticket / (wraparound_mask + 1)) * 2; }
+
+static inline int
+__chan_full_mp(struct __chan_mem *m, u32_t wraparound_mask, u32_t item_sz)
+{
+	u32_t p = ps_load(&m->producer);
+
+	return ps_load(&__chan_slot_mp(m, p, wraparound_mask, item_sz)->turn) != __chan_turn_mp(p, wraparound_mask);
+}
+
+static inline int
+__chan_empty_mp(struct __chan_mem *m, u32_t wraparound_mask, u32_t item_sz)
+{
+	u32_t c = ps_load(&m->consumer);
+
+	return ps_load(&__chan_slot_mp(m, c, wraparound_mask, item_sz)->turn) != (__chan_turn_mp(c, wraparound_mask) | 1);
+}
+
+static inline int
+__chan_produce_mp(struct __chan_mem *m, void *d, u32_t wraparound_mask, u32_t item_sz)
+{
+	u32_t p = ps_load(&m->producer);
+
+	while (1) {
+		struct __chan_slot *slot = __chan_slot_mp(m, p, wraparound_mask, item_sz);
+		u32_t turn = __chan_turn_mp(p, wraparound_mask), prev;
+
+		if (ps_load(&slot->turn) == turn) {
+			if (!__chan_cas32(&m->producer, p, p + 1)) {
+				p = ps_load(&m->producer);
+				continue;
+			}
+			memcpy(slot->item, d, item_sz);
+			/* publish the item only after its contents are written */
+			ps_mem_fence();
+			ps_store(&slot->turn, turn | 1);
+
+			return 0;
+		}
+		/* If the ticket hasn't moved, the slot is still occupied: full */
+		prev = p;
+		p    = ps_load(&m->producer);
+		if (p == prev) return 1;
+	}
+}
+
+static inline int
+__chan_consume_mp(struct __chan_mem *m, void *d, u32_t wraparound_mask, u32_t item_sz, int mc)
+{
+	u32_t c = ps_load(&m->consumer);
+
+	while (1) {
+		struct __chan_slot *slot = __chan_slot_mp(m, c, wraparound_mask, item_sz);
+		u32_t turn = __chan_turn_mp(c, wraparound_mask), prev;
+
+		if (ps_load(&slot->turn) == (turn | 1)) {
+			/* Single consumers needn't synchronize on the ticket */
+			if (mc && !__chan_cas32(&m->consumer, c, c + 1)) {
+				c = ps_load(&m->consumer);
+				continue;
+			}
+			if (!mc) m->consumer = c + 1;
+			memcpy(d, slot->item, item_sz);
+			ps_mem_fence();
+			/* hand the slot to the producer of the next round */
+			ps_store(&slot->turn, __chan_turn_mp(c + wraparound_mask + 1, wraparound_mask));
+
+			return 0;
+		}
+		prev = c;
+		c    = ps_load(&m->consumer);
+		if (c == prev) return 1;
+	}
+}
+
+/*
+ * Multi-producer versions of `__chan_send_pow2` and
+ * `__chan_recv_pow2` with the same return values. As there can be
+ * multiple blocked threads on each side, the blockpoints wake all of
+ * them, and the losers of the race re-block.
+ */
+static inline int
+__chan_send_mp_pow2(struct chan_snd *s, void *item, u32_t wraparound_mask, u32_t item_sz, int blking)
+{
+	struct __chan_mem *m = s->meta.mem;
+
+	while (1) {
+		struct sync_blkpt_checkpoint chkpt;
+
+		sync_blkpt_checkpoint(&m->full, &chkpt);
+		if (!__chan_produce_mp(m, item, wraparound_mask, item_sz)) {
+			/* success! */
+			if (__chan_send_notify(s)) return -1;
+			break;
+		}
+		if (!blking) return 1;
+
+		if (sync_blkpt_id_blocking(&m->full, s->meta.blkpt_full_id, 0, &chkpt)) continue;
+		if (!__chan_full_mp(m, wraparound_mask, item_sz)) continue;
+		sync_blkpt_id_wait(&m->full, s->meta.blkpt_full_id, 0, &chkpt);
+	}
+
+	return 0;
+}
+
+static inline int
+__chan_recv_mp_pow2(struct chan_rcv *r, void *item, u32_t wraparound_mask, u32_t item_sz, int blking, int mc)
+{
+	struct __chan_mem *m = r->meta.mem;
+
+	while (1) {
+		struct sync_blkpt_checkpoint chkpt;
+
+		sync_blkpt_checkpoint(&m->empty, &chkpt);
+		if (!__chan_consume_mp(m, item, wraparound_mask, item_sz, mc)) {
+			/* success! */
+			sync_blkpt_id_trigger(&m->full, r->meta.blkpt_full_id, 0);
+			break;
+		}
+		if (!blking) return 1;
+
+		if (sync_blkpt_id_blocking(&m->empty, r->meta.blkpt_empty_id, 0, &chkpt)) continue;
+		if (!__chan_empty_mp(m, wraparound_mask, item_sz)) continue;
+		sync_blkpt_id_wait(&m->empty, r->meta.blkpt_empty_id, 0, &chkpt);
+	}
+
+	return 0;
+}
+
+/***
+ * Batched and zero-copy communication. The SPSC ring moves a batch
+ * with (at most) two `memcpy`s and a single update of the
+ * producer/consumer index. The multi-producer rings must still
+ * sequence each slot, so they move items individually. In both
+ * cases, the blockpoint (and event) is triggered once per batch.
+ */
+
+/* How many items are in the SPSC ring? Note that the ring holds at most `wraparound_mask` items. */
+static inline u32_t
+__chan_nitems_pow2(struct __chan_mem *m)
+{ return ps_load(&m->producer) - ps_load(&m->consumer); }
+
+static inline u32_t
+__chan_produce_batch_pow2(struct __chan_mem *m, char *d, u32_t n, u32_t wraparound_mask, u32_t item_sz)
+{
+	u32_t p = m->producer, idx, first;
+	u32_t free = wraparound_mask - __chan_nitems_pow2(m);
+
+	if (n > free) n = free;
+	if (n == 0) return 0;
+
+	/* copy up to the end of the ring, then the rest from its start */
+	idx   = __chan_buff_idx_pow2(p, wraparound_mask);
+	first = (wraparound_mask + 1) - idx;
+	if (first > n) first = n;
+	memcpy(m->mem + (idx * item_sz), d, first * item_sz);
+	if (n > first) memcpy(m->mem, d + (first * item_sz), (n - first) * item_sz);
+	ps_store(&m->producer, p + n);
+
+	return n;
+}
+
+static inline u32_t
+__chan_consume_batch_pow2(struct __chan_mem *m, char *d, u32_t n, u32_t wraparound_mask, u32_t item_sz)
+{
+	u32_t c = m->consumer, idx, first;
+	u32_t avail = __chan_nitems_pow2(m);
+
+	if (n > avail) n = avail;
+	if (n == 0) return 0;
+
+	idx   = __chan_buff_idx_pow2(c, wraparound_mask);
+	first = (wraparound_mask + 1) - idx;
+	if (first > n) first = n;
+	memcpy(d, m->mem + (idx * item_sz), first * item_sz);
+	if (n > first) memcpy(d + (first * item_sz), m->mem, (n - first) * item_sz);
+	ps_store(&m->consumer, c + n);
+
+	return n;
+}
+
+static inline u32_t
+__chan_produce_batch(struct chan_snd *s, char *d, u32_t n, u32_t wraparound_mask, u32_t item_sz)
+{
+	struct __chan_mem *m = s->meta.mem;
+	u32_t i;
+
+	if (!__chan_is_mp(s->meta.flags)) return __chan_produce_batch_pow2(m, d, n, wraparound_mask, item_sz);
+	for (i = 0; i < n; i++) {
+		if (__chan_produce_mp(m, d + (i * item_sz), wraparound_mask, item_sz)) break;
+	}
+
+	return i;
+}
+
+static inline u32_t
+__chan_consume_batch(struct chan_rcv *r, char *d, u32_t n, u32_t wraparound_mask, u32_t item_sz)
+{
+	struct __chan_mem *m = r->meta.mem;
+	u32_t i;
+
+	if (!__chan_is_mp(r->meta.flags)) return __chan_consume_batch_pow2(m, d, n, wraparound_mask, item_sz);
+	for (i = 0; i < n; i++) {
+		if (__chan_consume_mp(m, d + (i * item_sz), wraparound_mask, item_sz, r->meta.flags & CHAN_MPMC)) break;
+	}
+
+	return i;
+}
+
+static inline int
+__chan_full(struct chan_snd *s, u32_t wraparound_mask, u32_t item_sz)
+{
+	if (__chan_is_mp(s->meta.flags)) return __chan_full_mp(s->meta.mem, wraparound_mask, item_sz);
+
+	return __chan_full_pow2(s->meta.mem, wraparound_mask);
+}
+
+static inline int
+__chan_empty(struct chan_rcv *r, u32_t wraparound_mask, u32_t item_sz)
+{
+	if (__chan_is_mp(r->meta.flags)) return __chan_empty_mp(r->meta.mem, wraparound_mask, item_sz);
+
+	return __chan_empty_pow2(r->meta.mem, wraparound_mask);
+}
+
+/*
+ * Send all `n` items, blocking as the channel fills if `blking`.
+ *
+ * - @return - `-n` on error, or the number of items sent, which is
+ *   only less than `n` if `!blking`.
+ */
+static inline int
+__chan_send_batch_pow2(struct chan_snd *s, char *items, u32_t n, u32_t wraparound_mask, u32_t item_sz, int blking)
+{
+	struct __chan_mem *m = s->meta.mem;
+	u32_t sent = 0;
+
+	while (sent < n) {
+		struct sync_blkpt_checkpoint chkpt;
+		u32_t amnt;
+
+		sync_blkpt_checkpoint(&m->full, &chkpt);
+		amnt = __chan_produce_batch(s, items + (sent * item_sz), n - sent, wraparound_mask, item_sz);
+		if (amnt > 0) {
+			sent += amnt;
+			if (__chan_send_notify(s)) return -1;
+			continue;
+		}
+		if (!blking) break;
+
+		if (sync_blkpt_id_blocking(&m->full, s->meta.blkpt_full_id, 0, &chkpt)) continue;
+		if (!__chan_full(s, wraparound_mask, item_sz)) continue;
+		sync_blkpt_id_wait(&m->full, s->meta.blkpt_full_id, 0, &chkpt);
+	}
+
+	return sent;
+}
+
+/*
+ * Receive up to `n` items, blocking only while the channel is empty
+ * if `blking`.
+ *
+ * - @return - the number of items received, which is only `0` if `!blking`.
+ */
+static inline int
+__chan_recv_batch_pow2(struct chan_rcv *r, char *items, u32_t n, u32_t wraparound_mask, u32_t item_sz, int blking)
+{
+	struct __chan_mem *m = r->meta.mem;
+	u32_t amnt;
+
+	while (1) {
+		struct sync_blkpt_checkpoint chkpt;
+
+		sync_blkpt_checkpoint(&m->empty, &chkpt);
+		amnt = __chan_consume_batch(r, items, n, wraparound_mask, item_sz);
+		if (amnt > 0) {
+			sync_blkpt_id_trigger(&m->full, r->meta.blkpt_full_id, 0);
+			break;
+		}
+		if (!blking) break;
+
+		if (sync_blkpt_id_blocking(&m->empty, r->meta.blkpt_empty_id, 0, &chkpt)) continue;
+		if (!__chan_empty(r, wraparound_mask, item_sz)) continue;
+		sync_blkpt_id_wait(&m->empty, r->meta.blkpt_empty_id, 0, &chkpt);
+	}
+
+	return amnt;
+}
+
+/*
+ * Claim the next slot without writing into it. For SPSC rings, the
+ * producer index is only advanced on commit; for multi-producer
+ * rings, the ticket is claimed here, and the slot is only published
+ * (by updating its `turn`) on commit.
+ */
+static inline void *
+__chan_reserve(struct chan_snd *s, u32_t wraparound_mask, u32_t item_sz)
+{
+	struct __chan_mem *m = s->meta.mem;
+	u32_t p;
+
+	if (!__chan_is_mp(s->meta.flags)) {
+		if (__chan_full_pow2(m, wraparound_mask)) return NULL;
+		s->reserved_ticket = m->producer;
+
+		return m->mem + (__chan_buff_idx_pow2(m->producer, wraparound_mask) * item_sz);
+	}
+
+	p = ps_load(&m->producer);
+	while (1) {
+		struct __chan_slot *slot = __chan_slot_mp(m, p, wraparound_mask, item_sz);
+		u32_t prev;
+
+		if (ps_load(&slot->turn) == __chan_turn_mp(p, wraparound_mask)) {
+			if (!__chan_cas32(&m->producer, p, p + 1)) {
+				p = ps_load(&m->producer);
+				continue;
+			}
+			s->reserved_ticket = p;
+
+			return slot->item;
+		}
+		prev = p;
+		p    = ps_load(&m->producer);
+		if (p == prev) return NULL;
+	}
+}
+
+static inline void *
+__chan_send_reserve_pow2(struct chan_snd *s, u32_t wraparound_mask, u32_t item_sz, int blking)
+{
+	struct __chan_mem *m = s->meta.mem;
+	void *slot;
+
+	while (1) {
+		struct sync_blkpt_checkpoint chkpt;
+
+		sync_blkpt_checkpoint(&m->full, &chkpt);
+		slot = __chan_reserve(s, wraparound_mask, item_sz);
+		if (slot) break;
+		if (!blking) return NULL;
+
+		if (sync_blkpt_id_blocking(&m->full, s->meta.blkpt_full_id, 0, &chkpt)) continue;
+		if (!__chan_full(s, wraparound_mask, item_sz)) continue;
+		sync_blkpt_id_wait(&m->full, s->meta.blkpt_full_id, 0, &chkpt);
+	}
+	s->reserved = slot;
+
+	return slot;
+}
+
+static inline int
+__chan_send_commit_pow2(struct chan_snd *s, u32_t wraparound_mask)
+{
+	struct __chan_mem *m = s->meta.mem;
+	u32_t t = s->reserved_ticket;
+
+	if (!s->reserved) return -1;
+	s->reserved = NULL;
+	if (!__chan_is_mp(s->meta.flags)) {
+		ps_store(&m->producer, t + 1);
+	} else {
+		struct __chan_slot *slot = __chan_slot_mp(m, t, wraparound_mask, s->meta.item_sz);
+
+		ps_mem_fence();
+		ps_store(&slot->turn, __chan_turn_mp(t, wraparound_mask) | 1);
+	}
+
+	return __chan_send_notify(s);
+}
+
 /* How many slots can we fit into an allocation of a specific mem_sz */
 static inline int
 chan_nslots(int item_sz, int mem_sz)
@@ -78,6 +78,57 @@ crt_nchkpt()
 	return nchkpt;
 }
 
+static inline size_t
+crt_comp_rw_sz(struct crt_comp *c)
+{
+	return c->tot_sz_mem - round_up_to_page(c->ro_sz);
+}
+
+/* Our pointer to the component's memory at vaddr, which must be read-write */
+static inline void *
+crt_comp_rw_ptr(struct crt_comp *c, vaddr_t vaddr)
+{
+	assert(vaddr >= c->rw_addr && vaddr < c->rw_addr + crt_comp_rw_sz(c));
+
+	return c->rw_mem + (vaddr - c->rw_addr);
+}
+
+/* Does the callgate of one of c's sinvs overlap the page at addr? */
+static int
+crt_comp_callgate_on(struct crt_comp *c, vaddr_t addr)
+{
+	u32_t i;
+
+	for (i = 0; i < c->n_sinvs; i++) {
+		vaddr_t cg = c->sinvs[i].c_fast_callgate_addr;
+
+		if (cg && cg < addr + PAGE_SIZE && cg + JIT_CALLGATE_LEN_BYTES > addr) return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Our pointer to the component's read-only memory at vaddr, to JIT
+ * into it. If the image is shared with a checkpoint, only the private
+ * copies of pages (in ro_pages) can be modified, so this returns NULL
+ * for the rest.
+ */
+static inline void *
+crt_comp_ro_ptr(struct crt_comp *c, vaddr_t vaddr)
+{
+	u32_t i;
+
+	assert(vaddr >= c->ro_addr && vaddr < c->ro_addr + c->ro_sz);
+	if (c->rw_mem == c->mem + round_up_to_page(c->ro_sz)) return c->mem + (vaddr - c->ro_addr);
+
+	for (i = 0; i < c->n_ro_pages; i++) {
+		if (c->ro_pages[i].addr == round_to_page(vaddr)) return c->ro_pages[i].mem + (vaddr - c->ro_pages[i].addr);
+	}
+
+	return NULL;
+}
+
 int
 crt_chkpt_create(struct crt_chkpt *chkpt, struct crt_comp *c)
 {
@@ -87,15 +138,16 @@ crt_chkpt_create(struct crt_chkpt *chkpt, struct crt_comp *c)
 	chkpt->c = c;
 	ps_faa(&nchkpt, 1);
 
-	/* allocate space for saving the component's memory */
+	/* allocate space for saving the component's read-write memory */
 	root_ci = cos_compinfo_get(cos_defcompinfo_curr_get());
-	mem = cos_page_bump_allocn(root_ci, c->tot_sz_mem);
+	mem = cos_page_bump_allocn(root_ci, crt_comp_rw_sz(c));
 	if (!mem) return -ENOMEM;
 
+	chkpt->ro_mem = c->mem;
 	chkpt->mem = mem;
 	chkpt->tot_sz_mem = c->tot_sz_mem;
 
-	memcpy(mem, c->mem, c->tot_sz_mem);
+	memcpy(mem, c->rw_mem, crt_comp_rw_sz(c));
 	/*
 	 * TODO: capabilities aren't copied, so components that could modify their capabilities
 	 * while running (schedulers/cap mgrs) shouldn't be checkpointed
@@ -105,11 +157,47 @@ crt_chkpt_create(struct crt_chkpt *chkpt, struct crt_comp *c)
 	return 0;
 }
 
+/*
+ * Return c, a terminated component created from chkpt, to the state
+ * saved in the checkpoint so that it can be executed again. Its
+ * synchronous invocations (and their capabilities) are retained, and
+ * its initial thread, which must be suspended, is restarted at the
+ * component's entry.
+ */
 int
 crt_chkpt_restore(struct crt_chkpt *chkpt, struct crt_comp *c)
 {
-	/* turning c, a terminated component, back into a chkpt */
-	/* TODO: return memory to a previous saved state */
+	struct usr_inv_cap ucaps[CRT_COMP_SINVS_LEN];
+	struct cos_component_information *comp_info;
+	struct cos_compinfo *ci        = cos_compinfo_get(cos_defcompinfo_curr_get());
+	struct cos_compinfo *target_ci = cos_compinfo_get(c->comp_res);
+	thdcap_t thd                   = cos_sched_aep_get(c->comp_res)->thd;
+	u32_t i;
+
+	assert(chkpt && c);
+	if (c->mem != chkpt->ro_mem || c->tot_sz_mem != chkpt->tot_sz_mem) return -EINVAL;
+
+	/* The checkpoint's invocation capabilities are those of chkpt->c, not ours */
+	assert(c->n_sinvs <= CRT_COMP_SINVS_LEN);
+	for (i = 0; i < c->n_sinvs; i++) {
+		if (c->sinvs[i].client != c) continue;
+		ucaps[i] = *(struct usr_inv_cap *)crt_comp_rw_ptr(c, c->sinvs[i].c_ucap_addr);
+	}
+	memcpy(c->rw_mem, chkpt->mem, crt_comp_rw_sz(c));
+	for (i = 0; i < c->n_sinvs; i++) {
+		if (c->sinvs[i].client != c) continue;
+		*(struct usr_inv_cap *)crt_comp_rw_ptr(c, c->sinvs[i].c_ucap_addr) = ucaps[i];
+	}
+
+	comp_info = crt_comp_rw_ptr(c, c->info);
+	comp_info->cos_this_spd_id = c->id;
+
+	c->init_state = CRT_COMP_INIT_PREINIT;
+	c->main_type  = INIT_MAIN_NONE;
+	simple_barrier_init(&c->barrier, init_parallelism());
+	/* Reuse the exited thread, as its kernel memory and capability can't be reclaimed */
+	if (thd && cos_thd_restart(ci, thd, target_ci->comp_cap_shared ? target_ci->comp_cap_shared : target_ci->comp_cap)) return -EINVAL;
+
 	return 0;
 }
 
@@ -308,11 +396,11 @@ crt_comp_create_from(struct crt_comp *c, char *name, compid_t id, struct crt_chk
 {
 	struct cos_compinfo *ci, *root_ci;
 	struct cos_component_information *comp_info;
-	unsigned long info_offset;
-	size_t  ro_sz,   rw_sz, data_sz, bss_sz;
+	size_t  ro_sz,   data_sz, bss_sz, ro_pgs_sz, off, len;
 	char   *ro_src, *data_src, *mem;
 	int     ret;
 	vaddr_t	info = chkpt->c->info;
+	vaddr_t ro_addr, rw_addr;
 
 	assert(c && name);
 
@@ -339,22 +427,51 @@ crt_comp_create_from(struct crt_comp *c, char *name, compid_t id, struct crt_chk
 	ret = cos_compinfo_alloc(ci, c->ro_addr, BOOT_CAPTBL_FREE, c->entry_addr, root_ci, 0);
 	assert(!ret);
 
-	mem = cos_page_bump_allocn(root_ci, chkpt->tot_sz_mem);
-	if (!mem) return -ENOMEM;
-	c->mem = mem;
+	/* The read-only image is shared; only the read-write memory is copied */
+	c->mem = chkpt->ro_mem;
 	c->tot_sz_mem = chkpt->tot_sz_mem;
 	c->ro_sz = chkpt->c->ro_sz;
+	mem = cos_page_bump_allocn(root_ci, crt_comp_rw_sz(c));
+	if (!mem) return -ENOMEM;
+	c->rw_mem = mem;
 
-	memcpy(mem, chkpt->mem, round_up_to_page(chkpt->tot_sz_mem));
+	memcpy(mem, chkpt->mem, crt_comp_rw_sz(c));
 
-	info_offset = info - c->rw_addr;
-	comp_info   = (struct cos_component_information *)(mem + round_up_to_page(c->ro_sz) + info_offset);
-	comp_info->cos_this_spd_id = 0;
-	assert(comp_info->cos_this_spd_id == 0);
+	comp_info = crt_comp_rw_ptr(c, info);
 	comp_info->cos_this_spd_id = id;
 
-	if (c->ro_addr != cos_mem_aliasn(ci, root_ci, (vaddr_t)mem, round_up_to_page(c->ro_sz), COS_PAGE_READABLE)) return -ENOMEM;
-	if (c->rw_addr != cos_mem_aliasn(ci, root_ci, (vaddr_t)mem + round_up_to_page(c->ro_sz), c->tot_sz_mem - round_to_page(c->ro_sz), COS_PAGE_READABLE | COS_PAGE_WRITABLE)) return -ENOMEM;
+	/*
+	 * The checkpointed component's callgates are JITed for it, so the
+	 * runs of pages holding callgates are instead copied, from the
+	 * original (un-JITed) object, into memory private to us.
+	 */
+	assert(chkpt->c->elf_hdr);
+	if (elf_load_info(chkpt->c->elf_hdr, &ro_addr, &ro_sz, &ro_src, &rw_addr, &data_sz, &data_src, &bss_sz)) return -EINVAL;
+	assert(ro_addr == c->ro_addr && ro_sz == c->ro_sz);
+	ro_pgs_sz = round_up_to_page(c->ro_sz);
+	for (off = 0; off < ro_pgs_sz; off += len) {
+		char *priv;
+
+		for (len = 0; off + len < ro_pgs_sz && crt_comp_callgate_on(c, c->ro_addr + off + len); len += PAGE_SIZE) ;
+		if (len == 0) {
+			len = PAGE_SIZE;
+			if (c->ro_addr + off != cos_mem_alias(ci, root_ci, (vaddr_t)c->mem + off, COS_PAGE_READABLE)) return -ENOMEM;
+			continue;
+		}
+
+		priv = cos_page_bump_allocn(root_ci, len);
+		if (!priv) return -ENOMEM;
+		memcpy(priv, ro_src + off, (ro_sz - off < len) ? ro_sz - off : len);
+		for (size_t pg = 0; pg < len; pg += PAGE_SIZE) {
+			assert(c->n_ro_pages < CRT_COMP_RO_PAGES_LEN);
+			c->ro_pages[c->n_ro_pages++] = (struct crt_ro_page) {
+				.addr = c->ro_addr + off + pg,
+				.mem  = priv + pg
+			};
+		}
+		if (c->ro_addr + off != cos_mem_aliasn(ci, root_ci, (vaddr_t)priv, len, COS_PAGE_READABLE)) return -ENOMEM;
+	}
+	if (c->rw_addr != cos_mem_aliasn(ci, root_ci, (vaddr_t)mem, crt_comp_rw_sz(c), COS_PAGE_READABLE | COS_PAGE_WRITABLE)) return -ENOMEM;
 
 	/* FIXME: cos_time.h assumes we have access to this... */
 	ret = cos_cap_cpy_at(ci, BOOT_CAPTBL_SELF_INITHW_BASE, root_ci, BOOT_CAPTBL_SELF_INITHW_BASE);
@@ -411,6 +528,7 @@ crt_comp_create(struct crt_comp *c, char *name, compid_t id, void *elf_hdr, vadd
 	mem    = cos_page_bump_allocn(root_ci, tot_sz);
 	if (!mem) return -ENOMEM;
 	c->mem = mem;
+	c->rw_mem = mem + round_up_to_page(ro_sz);
 	c->tot_sz_mem = tot_sz;
 	c->ro_sz = ro_sz;
 
@@ -686,7 +804,6 @@ crt_sinv_create(struct crt_sinv *sinv, char *name, struct crt_comp *server, stru
 {
 	struct cos_compinfo *cli;
 	struct cos_compinfo *srv;
-	unsigned int ucap_off;
 	struct usr_inv_cap *ucap;
 	compcap_t comp_s;
 	callgate_fn_t alt_fn = NULL;
@@ -710,6 +827,7 @@ crt_sinv_create(struct crt_sinv *sinv, char *name, struct crt_comp *server, stru
 		.client      = client,
 		.c_fn_addr   = c_fn_addr,
 		.c_ucap_addr = c_ucap_addr,
+		.c_fast_callgate_addr = c_fast_callgate_addr,
 		.s_fn_addr   = s_fn_addr
 	};
 
@@ -723,9 +841,11 @@ crt_sinv_create(struct crt_sinv *sinv, char *name, struct crt_comp *server, stru
 		u64_t client_auth_tok = 0xfefefefefefefefe; /* = CSPRNG() */
 		u64_t server_auth_tok = 0xabababababababab; /* = CSPRNG() */
 
-		vaddr_t callgate_off  = c_fast_callgate_addr - sinv->client->ro_addr;
-		vaddr_t callgate_addr = (vaddr_t)sinv->client->mem + callgate_off;
+		/* a private copy of the callgate, even if the rest of the image is shared */
+		vaddr_t callgate_addr = (vaddr_t)crt_comp_ro_ptr(sinv->client, c_fast_callgate_addr);
 
+		assert(callgate_addr);
+		assert(crt_comp_ro_ptr(sinv->client, c_fast_callgate_addr + JIT_CALLGATE_LEN_BYTES - 1) == (void *)(callgate_addr + JIT_CALLGATE_LEN_BYTES - 1));
 		mpk_jit_jitcallgate(callgate_addr, s_altfn_addr, sinv->client->protdom, sinv->server->protdom, client_auth_tok, server_auth_tok, client->id, sinv->sinv_cap);
 	
 		/* client should use the user-level callgate when making the sinv */
@@ -733,9 +853,7 @@ crt_sinv_create(struct crt_sinv *sinv, char *name, struct crt_comp *server, stru
 	}
 
 	/* poor-mans virtual address translation from client VAS -> our ptrs */
-	assert(sinv->c_ucap_addr - sinv->client->ro_addr > 0);
-	ucap_off = sinv->c_ucap_addr - sinv->client->ro_addr;
-	ucap = (struct usr_inv_cap *)(sinv->client->mem + ucap_off);
+	ucap = crt_comp_rw_ptr(sinv->client, sinv->c_ucap_addr);
 	*ucap = (struct usr_inv_cap) {
 		.invocation_fn = sinv->c_fn_addr,
 		.cap_no        = sinv->sinv_cap,
@@ -1361,6 +1479,19 @@ crt_page_aliasn_aligned_in(void *pages, unsigned long align, u32_t n_pages, stru
 	return 0;
 }
 
+/*
+ * Alias 1 << order bytes of physically contiguous memory into a VM
+ * with a single 2MB or 1GB EPT entry.
+ */
+int
+crt_page_alias_large_in(void *pages, u32_t order, struct crt_comp *self, struct crt_comp *c_in, vaddr_t *map_addr)
+{
+	*map_addr = cos_mem_alias_large(cos_compinfo_get(c_in->comp_res), cos_compinfo_get(self->comp_res), (vaddr_t)pages, order);
+	if (!*map_addr) return -EINVAL;
+
+	return 0;
+}
+
 int
 crt_page_aliasn_in(void *pages, u32_t n_pages, struct crt_comp *self, struct crt_comp *c_in, vaddr_t *map_addr)
 {
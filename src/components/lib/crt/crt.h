@@ -12,6 +12,7 @@
 typedef unsigned long crt_refcnt_t;
 
 #define CRT_COMP_SINVS_LEN 16
+#define CRT_COMP_RO_PAGES_LEN (2 * CRT_COMP_SINVS_LEN) /* a callgate can span two pages */
 
 struct crt_comp;
 
@@ -58,10 +59,21 @@ struct crt_sinv {
 	char *name;
 	struct crt_comp *server, *client;
 	vaddr_t c_fn_addr, c_ucap_addr;
+	vaddr_t c_fast_callgate_addr;	/* 0 if there is none */
 	vaddr_t s_fn_addr;
 	sinvcap_t sinv_cap;
 };
 
+/*
+ * A read-only page of a component created from a checkpoint that
+ * isn't shared with the checkpoint, as it holds callgates that must
+ * be JITed for this component.
+ */
+struct crt_ro_page {
+	vaddr_t addr;
+	char   *mem;
+};
+
 struct crt_vm_comp_info {
 	compid_t vmm_comp_id;
 };
@@ -73,6 +85,7 @@ struct crt_comp {
 	vaddr_t entry_addr, ro_addr, rw_addr, info;
 
 	char *mem;		/* image memory */
+	char *rw_mem;		/* its read-write part (separate if the read-only part is shared with a checkpoint) */
 	pgtblcap_t capmgr_untyped_mem;
 	struct elf_hdr *elf_hdr;
 	struct cos_defcompinfo *comp_res;
@@ -93,6 +106,8 @@ struct crt_comp {
 	size_t ro_sz;
 	struct crt_sinv sinvs[CRT_COMP_SINVS_LEN];
 	u32_t  n_sinvs;
+	struct crt_ro_page ro_pages[CRT_COMP_RO_PAGES_LEN];
+	u32_t  n_ro_pages;
 
 	prot_domain_t protdom;
 	capid_t second_lvl_pgtbl_cap;
@@ -110,10 +125,19 @@ struct crt_comp_resources {
 	vaddr_t     info;
 };
 
+/*
+ * The read-only part of the image is immutable, so it is shared
+ * between the checkpointed component, and all components created from
+ * the checkpoint. Only the read-write part is saved. The exception is
+ * the pages holding callgates, which are JITed per component: each
+ * component created from the checkpoint gets private copies of them
+ * (see ro_pages in crt_comp).
+ */
 struct crt_chkpt {
 	struct crt_comp *c;
-	char            *mem;
-	size_t           tot_sz_mem;
+	char            *ro_mem;	/* shared read-only image */
+	char            *mem;		/* saved read-write memory */
+	size_t           tot_sz_mem;	/* size of the entire image */
 };
 
 typedef enum {
@@ -224,6 +248,7 @@ int crt_thd_alias_in(struct crt_thd *t, struct crt_comp *c, struct crt_thd_resou
 void *crt_page_allocn(struct crt_comp *c, u32_t n_pages);
 int crt_page_aliasn_in(void *pages, u32_t n_pages, struct crt_comp *self, struct crt_comp *c_in, vaddr_t *map_addr);
 int crt_page_aliasn_aligned_in(void *pages, unsigned long align, u32_t n_pages, struct crt_comp *self, struct crt_comp *c_in, vaddr_t *map_addr);
+int crt_page_alias_large_in(void *pages, u32_t order, struct crt_comp *self, struct crt_comp *c_in, vaddr_t *map_addr);
 
 /**
  * Initialization API to automate the coordination necessary for
@@ -1,6 +1,7 @@
 
 #include <rte_eal.h>
 #include "adapter/cos_dpdk_adapter.h"
+#include <posix_cap.h>
 #include <rte_bus_pci.h>
 #include <rte_ethdev.h>
 #include <rte_mempool.h>
@@ -509,6 +510,8 @@ cos_dpdk_init(int argc, char **argv)
 
 	rte_log_set_level(cos_dpdk_log_type, RTE_LOG_INFO);
 
+	/* The NIC DMAs to the memory the EAL maps */
+	posix_cap_mmap_contig(1);
 	ret = rte_eal_init(argc, argv);
 
 	if (ret >= 0) {
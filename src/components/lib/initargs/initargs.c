@@ -1,8 +1,10 @@
 #include <initargs.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 extern struct initargs __initargs_root;
+extern struct initargs_index __initargs_index;
 
 /*
  * Operations on a specific K/V entry.  If you know that it should
@@ -240,6 +242,66 @@ args_get_from(char *path, struct initargs *from)
 	return args_value(&ent);
 }
 
+/*
+ * FNV-1a of the path, and the murmur3 finalizer to mix it. These must
+ * match the composer's (initargs.rs).
+ */
+static inline unsigned int
+args_index_hash(char *path)
+{
+	unsigned int h = 2166136261u;
+
+	for (; *path != '\0'; path++) {
+		h ^= (unsigned char)*path;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+static inline unsigned int
+args_index_mix(unsigned int h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/* Lookup the path in the composer's index. */
+static int
+args_index_lkup(char *path, struct initargs *ent)
+{
+	struct initargs_index *idx = &__initargs_index;
+	struct initargs_index_ent *e;
+	unsigned int h, d;
+	char *s;
+	int nesting = 0;
+
+	if (idx->sz == 0) return -1;
+	h = args_index_hash(path);
+	d = idx->disps[args_index_mix(h) & (idx->nbuckets - 1)];
+	e = &idx->ents[args_index_mix(h + d * 0x9e3779b9u) & (idx->sz - 1)];
+	if (!e->path || strcmp(e->path, path) != 0) return -1;
+
+	if (e->kv_ent) {
+		*ent = (struct initargs) {
+			.type     = ARGS_IMPL_KV,
+			.d.kv_ent = e->kv_ent
+		};
+		return 0;
+	}
+
+	/* tar keys are at the nesting level of their path */
+	for (s = strchr(path, '/'); s; s = strchr(s + 1, '/')) nesting++;
+	ent->type = ARGS_IMPL_TAR;
+
+	return tar_entry_at(e->tar_off, nesting, &ent->d.tar_ent);
+}
+
 /*
  * The "base-case" API where we need to do the initial lookup in the
  * KV map.  This requires basing the search in some structure:
@@ -253,6 +315,7 @@ args_get_entry(char *path, struct initargs *ent)
 	struct initargs tarroot;
 	struct tar_entry *tarent;
 
+	if (!args_index_lkup(path, ent)) return 0;
 	if (!args_get_entry_from(path, &__initargs_root, ent)) return 0;
 
 	tarent = tar_root();
@@ -275,6 +338,26 @@ args_get(char *path)
 	return args_value(&ent);
 }
 
+int
+args_on_core(unsigned long core)
+{
+	struct initargs cores, curr;
+	struct initargs_iter i;
+	int cont;
+
+	if (args_get_entry("cores", &cores)) return 1;
+	for (cont = args_iter(&cores, &i, &curr) ; cont ; cont = args_iter_next(&i, &curr)) {
+		char *v = args_value(&curr);
+
+		if (v && strtoul(v, NULL, 10) == core) return 1;
+	}
+
+	return 0;
+}
+
+/* No index if we don't get one from the composer */
+struct initargs_index __initargs_index __attribute__((weak)) = { nbuckets: 0, disps: NULL, sz: 0, ents: NULL };
+
 #ifdef ARGS_TEST
 
 static struct kv_entry __initargs_autogen_6 = { key: "name", vtype: VTYPE_STR, val: { str: "call_args" } };
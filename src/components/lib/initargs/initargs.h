@@ -69,6 +69,30 @@ struct initargs_iter {
 	} i;
 };
 
+/*
+ * The composer generates a perfect hash index over the paths of the
+ * arguments, and of the files in the tarball, so that looking up a
+ * path from the root doesn't walk the maps (or the tarball). Paths
+ * that aren't unique (e.g. of array entries) aren't indexed, and are
+ * found by walking.
+ */
+struct initargs_index_ent {
+	char *path;
+	struct kv_entry *kv_ent;	/* the entry, or NULL if it is in the tarball... */
+	unsigned long tar_off;		/* ...at this offset */
+};
+
+/*
+ * A path's hash selects a bucket, and the bucket's displacement
+ * perturbs the hash to select the path's entry (hash and displace).
+ */
+struct initargs_index {
+	unsigned int nbuckets;		/* a power of 2 */
+	unsigned int *disps;
+	unsigned int sz;		/* a power of 2 */
+	struct initargs_index_ent *ents;
+};
+
 /* Query the arguments, passing a path (/-delimited) */
 char *args_get(char *path);
 int args_get_entry(char *path, struct initargs *entry);
@@ -88,4 +112,12 @@ int args_foreach(struct initargs *ent, args_visitor_fn_t fn, void *data);
 int args_iter(struct initargs *kv, struct initargs_iter *i, struct initargs *first);
 int args_iter_next(struct initargs_iter *i, struct initargs *next);
 
+/*
+ * Core placement set by the composer from the `cores` key of the
+ * component's sysspec entry. `args_on_core` returns 1 if the
+ * component should execute on `core` (always, if no cores were
+ * specified).
+ */
+int args_on_core(unsigned long core);
+
 #endif /* INITARGS_H */
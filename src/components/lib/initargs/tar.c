@@ -278,6 +278,19 @@ tar_root(void)
 	return &__tar_root;
 }
 
+int
+tar_entry_at(unsigned long off, int nesting_lvl, struct tar_entry *ent)
+{
+	if (!tar_root() || off % TAR_RECORD_SIZE != 0 || off + TAR_RECORD_SIZE > tar_sz()) return -1;
+
+	*ent = (struct tar_entry) {
+		.nesting_lvl = nesting_lvl,
+		.record      = &_binary_crt_init_tar_start[off / TAR_RECORD_SIZE]
+	};
+
+	return tar_valid(ent) ? 0 : -1;
+}
+
 #ifdef TAR_TEST
 
 #include <stdio.h>
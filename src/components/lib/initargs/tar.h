@@ -56,5 +56,7 @@ int tar_iter(struct tar_entry *ent, struct tar_iter *i, struct tar_entry *first)
 int tar_iter_next(struct tar_iter *i, struct tar_entry *next);
 
 struct tar_entry *tar_root(void);
+/* the entry of the record at an offset in the tarball, at a nesting level */
+int tar_entry_at(unsigned long off, int nesting_lvl, struct tar_entry *ent);
 
 #endif /* TAR_H */
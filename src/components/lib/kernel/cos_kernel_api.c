@@ -1554,6 +1554,77 @@ cos_mem_aliasn_aligned(struct cos_compinfo *dstci, struct cos_compinfo *srcci, v
 	return first_dst;
 }
 
+#if defined(__x86_64__)
+/*
+ * Find the virtual address for a page of 1 << order bytes, and
+ * construct the levels of the page-table above the one holding its
+ * entry. Returns 0 if the page-tables below the entry were already
+ * constructed (by 4K mappings in the same range). Called with the
+ * va_lock held, and the caller advances vas_frontier once the page is
+ * mapped, so that a failure leaves no hole in the addresses.
+ */
+static vaddr_t
+__page_bump_valloc_large(struct cos_compinfo *ci, u32_t order)
+{
+	struct cos_compinfo *meta = __compinfo_metacap(ci);
+	vaddr_t              heap_vaddr, tmp_frontier;
+	size_t               sz = 1UL << order;
+	u32_t                pgtbl_lvl, entry_lvl, pgtbl_flag = 0;
+
+	if (unlikely(ci->comp_type == COMP_TYPE_VM)) pgtbl_flag = PGTBL_LVL_FLAG_VM;
+	/*
+	 * The page's entry is in the table constructed at entry_lvl:
+	 * level 0 tables map 1G pages, and level 1 tables 2M pages.
+	 */
+	entry_lvl = (order == COS_PGTBL_ORDER_PTE_1) ? 0 : 1;
+
+	heap_vaddr = round_up_to_pow2(ci->vas_frontier, sz);
+	for (pgtbl_lvl = entry_lvl + 1; pgtbl_lvl < COS_PGTBL_DEPTH - 1; pgtbl_lvl++) {
+		if (ci->vasrange_frontier[pgtbl_lvl] > heap_vaddr) return 0;
+	}
+
+	for (pgtbl_lvl = 0; pgtbl_lvl <= entry_lvl; pgtbl_lvl++) {
+		if (heap_vaddr + sz <= ci->vasrange_frontier[pgtbl_lvl]) continue;
+		if (!__bump_mem_expand_range(meta, ci->pgtbl_cap, heap_vaddr, sz, pgtbl_lvl | pgtbl_flag)) BUG();
+
+		tmp_frontier = cos_pgtbl_round_up_to_page(pgtbl_lvl, heap_vaddr + sz);
+		if (tmp_frontier > ci->vasrange_frontier[pgtbl_lvl]) ci->vasrange_frontier[pgtbl_lvl] = tmp_frontier;
+	}
+
+	return heap_vaddr;
+}
+#endif
+
+vaddr_t
+cos_mem_alias_large(struct cos_compinfo *dstci, struct cos_compinfo *srcci, vaddr_t src, u32_t order)
+{
+#if defined(__x86_64__)
+	vaddr_t dst;
+
+	assert(srcci && dstci);
+	assert(order == COS_PGTBL_ORDER_PTE_2 || order == COS_PGTBL_ORDER_PTE_1);
+	/* Only EPTs take entries above the last level */
+	if (dstci->comp_type != COMP_TYPE_VM) return 0;
+
+	ps_lock_take(&dstci->va_lock);
+	dst = __page_bump_valloc_large(dstci, order);
+	if (unlikely(!dst)) goto done;
+
+	if (call_cap_op(srcci->pgtbl_cap, CAPTBL_OP_CPY, src, dstci->pgtbl_cap, dst,
+	                order == COS_PGTBL_ORDER_PTE_1 ? COS_PAGE_EPT_1G : COS_PAGE_EPT_2M)) {
+		dst = 0;
+		goto done;
+	}
+	dstci->vas_frontier = dst + (1UL << order);
+done:
+	ps_lock_release(&dstci->va_lock);
+
+	return dst;
+#else
+	return 0;
+#endif
+}
+
 vaddr_t
 cos_mem_aliasn(struct cos_compinfo *dstci, struct cos_compinfo *srcci, vaddr_t src, size_t sz, unsigned long perm_flags)
 {
@@ -1633,6 +1704,24 @@ cos_thd_mod(struct cos_compinfo *ci, thdcap_t tc, void *tlsaddr)
 	return call_cap_op(ci->captbl_cap, CAPTBL_OP_THDTLSSET, tc, (word_t)tlsaddr, 0, 0);
 }
 
+int
+cos_thd_sched_data_set(struct cos_compinfo *ci, thdcap_t tc, word_t data)
+{
+	return call_cap_op(ci->captbl_cap, CAPTBL_OP_THDSCHEDDATA_SET, tc, data, 0, 0);
+}
+
+int
+cos_sched_ring_set(struct cos_compinfo *ci, thdcap_t rcvthd, struct cos_sched_ring *ring)
+{
+	return call_cap_op(ci->captbl_cap, CAPTBL_OP_THDSCHEDRING_SET, rcvthd, (word_t)ring, 0, 0);
+}
+
+int
+cos_thd_restart(struct cos_compinfo *ci, thdcap_t tc, compcap_t comp)
+{
+	return call_cap_op(ci->captbl_cap, CAPTBL_OP_THDRESTART, tc, comp, 0, 0);
+}
+
 /* FIXME: problems when we got to 64 bit systems with the return value */
 int
 cos_introspect(struct cos_compinfo *ci, capid_t cap, unsigned long op)
@@ -200,12 +200,39 @@ int cos_asnd(asndcap_t snd, int yield);
 int cos_rcv(arcvcap_t rcv, rcv_flags_t flags, int *rcvd);
 /* returns the same value as cos_rcv, but also information about scheduling events */
 int cos_sched_rcv(arcvcap_t rcv, rcv_flags_t flags, tcap_time_t timeout, int *rcvd, thdid_t *thdid, int *blocked, cycles_t *cycles, tcap_time_t *thd_timeout);
+/*
+ * Set the opaque value the kernel reports in scheduler events for a
+ * thread, and register a page-aligned event ring (in ci's memory) for
+ * the scheduler thread `rcvthd` to receive events in bulk. With a
+ * ring, cos_sched_rcv returns no per-event information (thdid is 0),
+ * and the events are instead in the ring. The ring must be writable
+ * user memory, which cannot be unmapped and retyped until the ring is
+ * removed (`ring == NULL`) or replaced, or the end-point is torn down.
+ * Both return 0 on success, and a negative error on failure.
+ */
+int cos_thd_sched_data_set(struct cos_compinfo *ci, thdcap_t c, word_t data);
+int cos_sched_ring_set(struct cos_compinfo *ci, thdcap_t rcvthd, struct cos_sched_ring *ring);
+/*
+ * Restart the suspended thread `c` at the initialization entry of the
+ * component `comp`, discarding its invocations, as if it were newly
+ * created with cos_initthd_alloc. For reusing the threads of components
+ * that are reset. Returns 0 on success, -EINVAL or -EBUSY (if it
+ * is scheduling) on failure.
+ */
+int cos_thd_restart(struct cos_compinfo *ci, thdcap_t c, compcap_t comp);
 
 int cos_introspect(struct cos_compinfo *ci, capid_t cap, unsigned long op);
 
 vaddr_t cos_mem_alias(struct cos_compinfo *dstci, struct cos_compinfo *srcci, vaddr_t src, unsigned long perm_flags);
 vaddr_t cos_mem_aliasn(struct cos_compinfo *dstci, struct cos_compinfo *srcci, vaddr_t src, size_t sz, unsigned long perm_flags);
 vaddr_t cos_mem_aliasn_aligned(struct cos_compinfo *dstci, struct cos_compinfo *srcci, vaddr_t src, size_t sz, size_t align, unsigned long perm_flags);
+/*
+ * Alias a physically contiguous, aligned 2MB or 1GB (order 21 or 30)
+ * region into a VM with a single EPT entry. Returns 0 if the region
+ * can't be mapped with one (e.g. the VM's addresses at the frontier
+ * are already mapped with 4K pages).
+ */
+vaddr_t cos_mem_alias_large(struct cos_compinfo *dstci, struct cos_compinfo *srcci, vaddr_t src, u32_t order);
 int     cos_mem_alias_at(struct cos_compinfo *dstci, vaddr_t dst, struct cos_compinfo *srcci, vaddr_t src, unsigned long perm_flags);
 int     cos_mem_alias_atn(struct cos_compinfo *dstci, vaddr_t dst, struct cos_compinfo *srcci, vaddr_t src, size_t sz, unsigned long perm_flags);
 vaddr_t cos_mem_move(struct cos_compinfo *dstci, struct cos_compinfo *srcci, vaddr_t src);
@@ -242,6 +242,42 @@ patina_channel_recv(patina_chan_r_t rcid, void *buf, size_t len, size_t flags)
 	return chan_recv((struct chan_rcv *)(rcid & PATINA_T_MASK), buf, (chan_comm_t)flags);
 }
 
+/**
+ * Send an array of items through channel, waking the receiver once
+ *
+ * Arguments:
+ * - @scid: id of send endpoint
+ * - @nitems: number of items in @data
+ * - @flags: native chan lib's flags
+ *
+ * @return: return 'chan_send_batch's return
+ */
+int
+patina_channel_send_batch(patina_chan_s_t scid, void *data, size_t nitems, size_t flags)
+{
+	assert(scid && data);
+
+	return chan_send_batch((struct chan_snd *)(scid & PATINA_T_MASK), data, nitems, (chan_comm_t)flags);
+}
+
+/**
+ * Receive up to a number of items through channel
+ *
+ * Arguments:
+ * - @rcid: id of recv endpoint
+ * - @nitems: maximum number of items to receive into @buf
+ * - @flags: native chan lib's flags
+ *
+ * @return: return 'chan_recv_batch's return
+ */
+int
+patina_channel_recv_batch(patina_chan_r_t rcid, void *buf, size_t nitems, size_t flags)
+{
+	assert(rcid && buf);
+
+	return chan_recv_batch((struct chan_rcv *)(rcid & PATINA_T_MASK), buf, nitems, (chan_comm_t)flags);
+}
+
 /* NOT IMPLEMENTED */
 int
 patina_channel_get_status(size_t cid, struct patina_channel_status *status)
@@ -21,6 +21,8 @@ int             patina_channel_close(size_t cid);
 int             patina_channel_destroy(patina_chan_t cid);
 int             patina_channel_send(patina_chan_s_t scid, void *data, size_t len, size_t flags);
 int             patina_channel_recv(patina_chan_r_t rcid, void *buf, size_t len, size_t flags);
+int             patina_channel_send_batch(patina_chan_s_t scid, void *data, size_t nitems, size_t flags);
+int             patina_channel_recv_batch(patina_chan_r_t rcid, void *buf, size_t nitems, size_t flags);
 int             patina_channel_get_status(size_t cid, struct patina_channel_status *status);
 
 #endif
@@ -0,0 +1,496 @@
+/*
+ * A malloc for components with per-core caches. Small allocations are
+ * served from slabs of objects of a size class, and large ones from
+ * page spans. Both are PCM_SLAB_SZ-aligned, with their header first, so a
+ * pointer's header is found by masking it (less one, as a span aligned to
+ * more than PCM_SLAB_SZ returns memory on a PCM_SLAB_SZ boundary: its
+ * header is forwarded to from the boundary below that).
+ *
+ * Each core has the partially-used slabs of each size class, and
+ * allocates and frees their objects (with its core's lock, which is
+ * only contended by other threads on the core). An object freed on
+ * another core is pushed, lock-free, on its slab's remote free list,
+ * and the slab on its core's remote queue, for the core to take them
+ * back on its next allocation.
+ *
+ * Memory is taken from memmgr a batch of slabs at a time. memmgr can't
+ * take memory back, so empty slabs and freed spans are kept, and reused
+ * for other size classes and cores. Spans are neither split nor
+ * coalesced: a freed span is only reused for an allocation of at least
+ * half its size, so fragmentation can grow memory past peak use.
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include <cos_component.h>
+#include <cos_debug.h>
+#include <consts.h>
+#include <ps.h>
+#include <memmgr.h>
+
+#define PCM_SLAB_SZ      (1UL << 16)
+#define PCM_SLAB_PAGES   (PCM_SLAB_SZ / PAGE_SIZE)
+/* Slabs allocated from memmgr at a time */
+#define PCM_BATCH        16
+/* Empty slabs a core keeps before returning them to the depot */
+#define PCM_CORE_EMPTY   4
+
+#define PCM_MIN_ALIGN    16
+/* Must hold struct pcm_slab */
+#define PCM_HDR_SZ       (2 * CACHE_LINE)
+/* 32 size classes: by 16 bytes up to 128, then 4 per power of two */
+#define PCM_NCLASSES     32
+#define PCM_SMALL_MAX    8192
+#define PCM_CLASS_LARGE  0xffff
+/* A header that forwards to the span's header, in next */
+#define PCM_CLASS_FWD    0xfffe
+
+struct pcm_slab {
+	u16_t  class;
+	u16_t  coreid;
+	/* On its core's partial list, and on its core's remote queue */
+	int    listed, queued;
+	/* Allocated objects, including those on the remote free list */
+	long   nused;
+	/* The core's free objects, and the slab's yet unallocated memory */
+	void  *free;
+	char  *unused;
+	/* Objects freed on other cores */
+	void  *remote_free;
+	struct pcm_slab *next, *prev;
+	struct pcm_slab *rnext;
+	/* Large allocations: the span's pages */
+	unsigned long npages;
+};
+
+struct pcm_core {
+	struct ps_lock   lock;
+	struct pcm_slab *partial[PCM_NCLASSES];
+	struct pcm_slab *empty;
+	int              nempty;
+	/* Slabs with objects freed on other cores */
+	struct pcm_slab *remote;
+} CACHE_ALIGNED;
+
+static struct pcm_core pcm_cores[NUM_CPU];
+
+/* Empty slabs, and freed large spans, shared by all cores */
+static struct ps_lock   pcm_depot_lock;
+static struct pcm_slab *pcm_depot;
+static struct pcm_slab *pcm_spans;
+
+static inline int
+pcm_class(size_t sz)
+{
+	int lg;
+
+	if (sz <= 128) return sz ? (sz + 15) / 16 - 1 : 0;
+	/* 2^lg < sz <= 2^(lg + 1), in quarters of that range */
+	lg = 63 - __builtin_clzl(sz - 1);
+
+	return 8 + (lg - 7) * 4 + (((sz - 1) >> (lg - 2)) & 3);
+}
+
+static inline size_t
+pcm_class_sz(int c)
+{
+	int lg;
+
+	if (c < 8) return (c + 1) * 16;
+	lg = 7 + (c - 8) / 4;
+
+	return (1UL << lg) + ((c - 8) % 4 + 1) * (1UL << (lg - 2));
+}
+
+static inline struct pcm_slab *
+pcm_slab_of(void *p)
+{
+	struct pcm_slab *s = (struct pcm_slab *)(((unsigned long)p - 1) & ~(PCM_SLAB_SZ - 1));
+
+	if (unlikely(s->class == PCM_CLASS_FWD)) s = s->next;
+
+	return s;
+}
+
+static void
+pcm_list_add(struct pcm_slab **head, struct pcm_slab *s)
+{
+	s->prev = NULL;
+	s->next = *head;
+	if (*head) (*head)->prev = s;
+	*head = s;
+}
+
+static void
+pcm_list_rem(struct pcm_slab **head, struct pcm_slab *s)
+{
+	if (s->prev) s->prev->next = s->next;
+	else         *head = s->next;
+	if (s->next) s->next->prev = s->prev;
+	s->next = s->prev = NULL;
+}
+
+/* Lock-free push onto a list only taken as a whole (so without ABA) */
+static inline void
+pcm_push(void **head, void *p, void **next)
+{
+	void *old = __atomic_load_n(head, __ATOMIC_RELAXED);
+
+	do {
+		*next = old;
+	} while (!__atomic_compare_exchange_n(head, &old, p, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static struct pcm_slab *
+pcm_depot_get(void)
+{
+	struct pcm_slab *s;
+	char *mem;
+	int i;
+
+	ps_lock_take(&pcm_depot_lock);
+	s = pcm_depot;
+	if (s) {
+		pcm_depot = s->next;
+		ps_lock_release(&pcm_depot_lock);
+
+		return s;
+	}
+	ps_lock_release(&pcm_depot_lock);
+
+	mem = (char *)memmgr_heap_page_allocn_aligned(PCM_SLAB_PAGES * PCM_BATCH, PCM_SLAB_SZ);
+	if (!mem) return NULL;
+
+	ps_lock_take(&pcm_depot_lock);
+	for (i = 1; i < PCM_BATCH; i++) {
+		s = (struct pcm_slab *)(mem + i * PCM_SLAB_SZ);
+		s->next   = pcm_depot;
+		pcm_depot = s;
+	}
+	ps_lock_release(&pcm_depot_lock);
+
+	return (struct pcm_slab *)mem;
+}
+
+/* An empty slab, for objects of class c on the core */
+static struct pcm_slab *
+pcm_slab_get(struct pcm_core *core, int c)
+{
+	struct pcm_slab *s = core->empty;
+
+	if (s) {
+		core->empty = s->next;
+		core->nempty--;
+	} else {
+		s = pcm_depot_get();
+		if (!s) return NULL;
+	}
+
+	*s = (struct pcm_slab) {
+		.class  = c,
+		.coreid = cos_cpuid(),
+		.unused = (char *)s + PCM_HDR_SZ,
+	};
+
+	return s;
+}
+
+/* The slab's objects are all free: cache it, or return it to the depot */
+static void
+pcm_slab_release(struct pcm_core *core, struct pcm_slab *s)
+{
+	if (s->listed) pcm_list_rem(&core->partial[s->class], s);
+	s->listed = 0;
+
+	if (core->nempty < PCM_CORE_EMPTY) {
+		s->next     = core->empty;
+		core->empty = s;
+		core->nempty++;
+
+		return;
+	}
+
+	ps_lock_take(&pcm_depot_lock);
+	s->next   = pcm_depot;
+	pcm_depot = s;
+	ps_lock_release(&pcm_depot_lock);
+}
+
+/*
+ * Take back the slabs with objects freed on other cores: list them to
+ * allocate from, or release them if they are now empty. A slab that's
+ * still queued can't be released, as the freeing core might yet queue
+ * it. It is released when it is dequeued.
+ */
+static void
+pcm_remote_drain(struct pcm_core *core)
+{
+	struct pcm_slab *s, *next;
+
+	if (!__atomic_load_n(&core->remote, __ATOMIC_RELAXED)) return;
+
+	for (s = __atomic_exchange_n(&core->remote, NULL, __ATOMIC_ACQUIRE); s; s = next) {
+		next = s->rnext;
+		__atomic_store_n(&s->queued, 0, __ATOMIC_SEQ_CST);
+
+		if (__atomic_load_n(&s->nused, __ATOMIC_SEQ_CST) == 0) {
+			pcm_slab_release(core, s);
+		} else if (!s->listed) {
+			pcm_list_add(&core->partial[s->class], s);
+			s->listed = 1;
+		}
+	}
+}
+
+static void *
+pcm_slab_pop(struct pcm_slab *s)
+{
+	size_t sz = pcm_class_sz(s->class);
+	void *o;
+
+	if (!s->free && __atomic_load_n(&s->remote_free, __ATOMIC_RELAXED)) {
+		s->free = __atomic_exchange_n(&s->remote_free, NULL, __ATOMIC_ACQUIRE);
+	}
+
+	if (s->free) {
+		o       = s->free;
+		s->free = *(void **)o;
+	} else if (s->unused + sz <= (char *)s + PCM_SLAB_SZ) {
+		o          = s->unused;
+		s->unused += sz;
+	} else {
+		return NULL;
+	}
+	__atomic_fetch_add(&s->nused, 1, __ATOMIC_RELAXED);
+
+	return o;
+}
+
+static void *
+pcm_small_alloc(int c)
+{
+	struct pcm_core *core = &pcm_cores[cos_cpuid()];
+	struct pcm_slab *s;
+	void *o = NULL;
+
+	ps_lock_take(&core->lock);
+	pcm_remote_drain(core);
+
+	while ((s = core->partial[c])) {
+		o = pcm_slab_pop(s);
+		if (o) break;
+
+		/* Full: it is listed again when an object is freed */
+		pcm_list_rem(&core->partial[c], s);
+		s->listed = 0;
+	}
+	if (!o) {
+		s = pcm_slab_get(core, c);
+		if (s) {
+			pcm_list_add(&core->partial[c], s);
+			s->listed = 1;
+			o = pcm_slab_pop(s);
+		}
+	}
+	ps_lock_release(&core->lock);
+
+	return o;
+}
+
+static void
+pcm_small_free(struct pcm_slab *s, void *p)
+{
+	struct pcm_core *core;
+
+	if (s->coreid != cos_cpuid()) {
+		core = &pcm_cores[s->coreid];
+		pcm_push(&s->remote_free, p, (void **)p);
+		if (!__atomic_load_n(&s->queued, __ATOMIC_SEQ_CST) && !__atomic_exchange_n(&s->queued, 1, __ATOMIC_SEQ_CST)) {
+			pcm_push((void **)&core->remote, s, (void **)&s->rnext);
+		}
+		/* Last: the slab can be reused once all its objects are freed */
+		__atomic_fetch_sub(&s->nused, 1, __ATOMIC_SEQ_CST);
+
+		return;
+	}
+
+	core = &pcm_cores[s->coreid];
+	ps_lock_take(&core->lock);
+	*(void **)p = s->free;
+	s->free     = p;
+	if (__atomic_sub_fetch(&s->nused, 1, __ATOMIC_SEQ_CST) == 0 && !__atomic_load_n(&s->queued, __ATOMIC_SEQ_CST)) {
+		pcm_slab_release(core, s);
+	} else if (!s->listed) {
+		pcm_list_add(&core->partial[s->class], s);
+		s->listed = 1;
+	}
+	ps_lock_release(&core->lock);
+}
+
+/*
+ * Large allocations are page spans, with the header at the start and
+ * the memory at an offset of at least the header (and the alignment).
+ * If that offset is past the first slab, a forwarding header sits on
+ * the PCM_SLAB_SZ boundary below the memory.
+ */
+static void *
+pcm_large_alloc(size_t sz, size_t align)
+{
+	struct pcm_slab *s, *fwd, **prev;
+	size_t off = align > PCM_HDR_SZ ? align : PCM_HDR_SZ;
+	unsigned long npages;
+
+	if (sz > (1UL << 46)) return NULL;
+	npages = round_up_to_page(off + sz) / PAGE_SIZE;
+
+	/* Reuse a freed span that isn't much larger */
+	ps_lock_take(&pcm_depot_lock);
+	for (prev = &pcm_spans; (s = *prev); prev = &s->next) {
+		if (s->npages >= npages && s->npages <= npages * 2 && ((unsigned long)s & (align - 1)) == 0) {
+			*prev = s->next;
+			break;
+		}
+	}
+	ps_lock_release(&pcm_depot_lock);
+
+	if (!s) {
+		s = (struct pcm_slab *)memmgr_heap_page_allocn_aligned(npages, align > PCM_SLAB_SZ ? align : PCM_SLAB_SZ);
+		if (!s) return NULL;
+		s->npages = npages;
+	}
+	s->class = PCM_CLASS_LARGE;
+	if (off > PCM_SLAB_SZ) {
+		fwd        = (struct pcm_slab *)((char *)s + off - PCM_SLAB_SZ);
+		fwd->class = PCM_CLASS_FWD;
+		fwd->next  = s;
+	}
+
+	return (char *)s + off;
+}
+
+static void
+pcm_large_free(struct pcm_slab *s)
+{
+	ps_lock_take(&pcm_depot_lock);
+	s->next   = pcm_spans;
+	pcm_spans = s;
+	ps_lock_release(&pcm_depot_lock);
+}
+
+static void *
+pcm_alloc(size_t sz, size_t align)
+{
+	void *p;
+	int c;
+
+	if (sz <= PCM_SMALL_MAX && align <= PCM_HDR_SZ) {
+		/* Objects are at multiples of their size from the (aligned) header */
+		c = pcm_class((sz + align - 1) & ~(align - 1));
+		while (pcm_class_sz(c) % align) c++;
+		p = pcm_small_alloc(c);
+	} else {
+		p = pcm_large_alloc(sz, align);
+	}
+	if (!p) errno = ENOMEM;
+
+	return p;
+}
+
+void *
+malloc(size_t sz)
+{
+	return pcm_alloc(sz, PCM_MIN_ALIGN);
+}
+
+void
+free(void *p)
+{
+	struct pcm_slab *s;
+
+	if (!p) return;
+
+	s = pcm_slab_of(p);
+	if (s->class == PCM_CLASS_LARGE) pcm_large_free(s);
+	else                             pcm_small_free(s, p);
+}
+
+size_t
+malloc_usable_size(void *p)
+{
+	struct pcm_slab *s;
+
+	if (!p) return 0;
+
+	s = pcm_slab_of(p);
+	if (s->class == PCM_CLASS_LARGE) return (char *)s + s->npages * PAGE_SIZE - (char *)p;
+
+	return pcm_class_sz(s->class);
+}
+
+void *
+calloc(size_t n, size_t sz)
+{
+	void *p;
+
+	if (sz && n > (size_t)-1 / sz) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	/* Freed memory is reused, so it isn't zeroed */
+	p = malloc(n * sz);
+	if (p) memset(p, 0, n * sz);
+
+	return p;
+}
+
+void *
+realloc(void *p, size_t sz)
+{
+	size_t old;
+	void *new;
+
+	if (!p) return malloc(sz);
+
+	/* Keep the memory, unless most of it would be unused */
+	old = malloc_usable_size(p);
+	if (sz <= old && sz >= old / 4) return p;
+
+	new = malloc(sz);
+	if (!new) return NULL;
+	memcpy(new, p, sz < old ? sz : old);
+	free(p);
+
+	return new;
+}
+
+void *
+memalign(size_t align, size_t sz)
+{
+	if (align & (align - 1)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return pcm_alloc(sz, align < PCM_MIN_ALIGN ? PCM_MIN_ALIGN : align);
+}
+
+void *
+aligned_alloc(size_t align, size_t sz)
+{
+	return memalign(align, sz);
+}
+
+int
+posix_memalign(void **res, size_t align, size_t sz)
+{
+	void *p;
+
+	if (align < sizeof(void *) || (align & (align - 1))) return EINVAL;
+
+	p = pcm_alloc(sz, align < PCM_MIN_ALIGN ? PCM_MIN_ALIGN : align);
+	if (!p) return ENOMEM;
+	*res = p;
+
+	return 0;
+}
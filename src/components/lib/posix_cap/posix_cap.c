@@ -2,6 +2,7 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <syscall.h>
 #include <time.h>
 
@@ -16,6 +17,7 @@
 #include <ps_list.h>
 #include <memmgr.h>
 #include <contigmem.h>
+#include <posix_cap.h>
 
 static struct ps_lock stdout_lock;
 
@@ -81,44 +83,262 @@ cos_brk(void *addr)
 	return 0;
 }
 
+/*
+ * The virtual memory areas of anonymous mappings. The memory manager
+ * only allocates memory (it can't be returned), so unmapped areas are
+ * kept, free, and reused by later mappings, and a mapping can grow
+ * in place into the free area after it. The areas are sorted by
+ * address, and adjacent areas in the same state are merged (munmap
+ * and mremap only check that their range is mapped, so the areas
+ * don't need to follow the boundaries of the mappings). The table
+ * thus holds the alternating runs of mapped and free memory, and when
+ * fragmentation makes more than VMA_MAX of them, mappings fail with
+ * -ENOMEM.
+ */
+#define VMA_MAX 1024
+
+/* Only defined by musl for _GNU_SOURCE */
+#ifndef MREMAP_MAYMOVE
+#define MREMAP_MAYMOVE 1
+#endif
+
+struct vma {
+	vaddr_t start, end;
+	int     free;
+};
+
+static struct vma vmas[VMA_MAX];
+static int vmas_num;
+static struct ps_lock vma_lock;
+static int mmap_contig;
+
+void
+posix_cap_mmap_contig(int contig)
+{
+	mmap_contig = contig;
+}
+
+/* The index of the area containing addr, or of the first area after it */
+static int
+vma_find(vaddr_t addr)
+{
+	int lo = 0, hi = vmas_num;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (vmas[mid].end <= addr) lo = mid + 1;
+		else                       hi = mid;
+	}
+
+	return lo;
+}
+
+static int
+vma_insert(int idx, vaddr_t start, vaddr_t end, int free)
+{
+	if (vmas_num == VMA_MAX) return -ENOMEM;
+
+	memmove(&vmas[idx + 1], &vmas[idx], (vmas_num - idx) * sizeof(struct vma));
+	vmas[idx] = (struct vma) { .start = start, .end = end, .free = free };
+	vmas_num++;
+
+	return 0;
+}
+
+static void
+vma_remove(int idx)
+{
+	memmove(&vmas[idx], &vmas[idx + 1], (vmas_num - idx - 1) * sizeof(struct vma));
+	vmas_num--;
+}
+
+/* Split the area containing addr so that an area starts at addr */
+static int
+vma_split(vaddr_t addr)
+{
+	int idx = vma_find(addr);
+	struct vma *v = &vmas[idx];
+
+	if (idx == vmas_num || v->start >= addr) return 0;
+	if (vma_insert(idx + 1, addr, v->end, v->free)) return -ENOMEM;
+	vmas[idx].end = addr;
+
+	return 0;
+}
+
+/* Merge the adjacent areas in the same state around [start, end) */
+static void
+vma_merge(vaddr_t start, vaddr_t end)
+{
+	int idx = vma_find(start);
+
+	if (idx > 0) idx--;
+	while (idx + 1 < vmas_num && vmas[idx].start <= end) {
+		if (vmas[idx].free == vmas[idx + 1].free && vmas[idx].end == vmas[idx + 1].start) {
+			vmas[idx].end = vmas[idx + 1].end;
+			vma_remove(idx + 1);
+		} else {
+			idx++;
+		}
+	}
+}
+
+/* Are all pages in [start, end) in areas that are in the given state? */
+static int
+vma_range_is(vaddr_t start, vaddr_t end, int free)
+{
+	int idx = vma_find(start);
+	vaddr_t addr = start;
+
+	for (; idx < vmas_num && addr < end; idx++) {
+		if (vmas[idx].start > addr || vmas[idx].free != free) return 0;
+		addr = vmas[idx].end;
+	}
+
+	return addr >= end;
+}
+
+/* Set the state of [start, end), which must be covered by areas */
+static int
+vma_range_set(vaddr_t start, vaddr_t end, int free)
+{
+	int idx;
+
+	if (vma_split(start) || vma_split(end)) return -ENOMEM;
+	for (idx = vma_find(start); idx < vmas_num && vmas[idx].start < end; idx++) {
+		vmas[idx].free = free;
+	}
+	vma_merge(start, end);
+
+	return 0;
+}
+
+/* Add memory from the memory manager as a free area */
+static int
+vma_expand(size_t length)
+{
+	vaddr_t addr;
+
+	/* Memory can't be returned, so don't allocate it without an area for it */
+	if (vmas_num == VMA_MAX) return -ENOMEM;
+	addr = memmgr_heap_page_allocn(length / PAGE_SIZE);
+	if (!addr) return -ENOMEM;
+
+	if (vma_insert(vma_find(addr), addr, addr + length, 1)) BUG();
+	vma_merge(addr, addr + length);
+
+	return 0;
+}
+
+static int
+vma_fit(size_t length)
+{
+	int idx;
+
+	for (idx = 0; idx < vmas_num; idx++) {
+		if (vmas[idx].free && vmas[idx].end - vmas[idx].start >= length) break;
+	}
+
+	return idx;
+}
+
+static vaddr_t
+vma_alloc(size_t length)
+{
+	vaddr_t addr;
+	int idx;
+
+	/* First fit, or new memory (that might merge with the last free area) */
+	idx = vma_fit(length);
+	if (idx == vmas_num) {
+		if (vma_expand(length)) return 0;
+		idx = vma_fit(length);
+		assert(idx < vmas_num);
+	}
+
+	addr = vmas[idx].start;
+	if (vma_range_set(addr, addr + length, 0)) return 0;
+	/* Free areas hold the data of previous mappings */
+	memset((void *)addr, 0, length);
+
+	return addr;
+}
+
+/*
+ * Grow the mapping at [addr, addr + old) to new bytes in place, if the
+ * memory after it is free, or is the next memory the memory manager
+ * gives us.
+ */
+static int
+vma_grow(vaddr_t addr, size_t old, size_t new)
+{
+	vaddr_t end = addr + old, new_end = addr + new;
+
+	if (!vma_range_is(end, new_end, 1)) {
+		/* The memory manager allocates at increasing addresses */
+		if (vmas[vmas_num - 1].end != end || vma_expand(new - old)) return -ENOMEM;
+		if (!vma_range_is(end, new_end, 1)) return -ENOMEM;
+	}
+	if (vma_range_set(end, new_end, 0)) return -ENOMEM;
+	memset((void *)end, 0, new - old);
+
+	return 0;
+}
+
+/*
+ * These are called by musl as raw system calls, so they return errors
+ * as negative errnos.
+ */
 void *
 cos_mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
 {
-	void *ret=0;
-	printc("mmap sz:%lu\n", length/1024/1024);
+	vaddr_t ret;
 
-	if (addr != NULL) {
-		printc("parameter void *addr is not supported!\n");
-		errno = ENOTSUP;
-		return MAP_FAILED;
-	}
-	if (fd != -1) {
+	if (fd != -1 || !(flags & MAP_ANONYMOUS)) {
 		printc("file mapping is not supported!\n");
-		errno = ENOTSUP;
-		return MAP_FAILED;
+		return (void *)-ENOTSUP;
 	}
+	/* Without MAP_FIXED, addr is only a hint */
+	if (flags & MAP_FIXED) {
+		printc("fixed mapping is not supported!\n");
+		return (void *)-ENOTSUP;
+	}
+	if (length == 0) return (void *)-EINVAL;
+	length = round_up_to_page(length);
 
-	addr = (void *)contigmem_alloc((length / PAGE_SIZE));
-	if (!addr){
-		ret = (void *) -1;
-	} else {
-		ret = addr;
+	if (mmap_contig) {
+		ret = contigmem_alloc(length / PAGE_SIZE);
+		return ret ? (void *)ret : (void *)-ENOMEM;
 	}
 
-	if (ret == (void *)-1) {  /* return value comes from man page */
+	ps_lock_take(&vma_lock);
+	ret = vma_alloc(length);
+	ps_lock_release(&vma_lock);
+	if (!ret) {
 		printc("mmap() failed!\n");
-		/* This is a best guess about what went wrong */
-		errno = ENOMEM;
+		return (void *)-ENOMEM;
 	}
-	return ret;
+
+	return (void *)ret;
 }
 
 int
 cos_munmap(void *start, size_t length)
 {
-	printc("munmap not implemented\n");
-	errno = ENOSYS;
-	return -1;
+	vaddr_t addr = (vaddr_t)start;
+	int ret = 0;
+
+	if (addr % PAGE_SIZE || length == 0) return -EINVAL;
+	length = round_up_to_page(length);
+
+	ps_lock_take(&vma_lock);
+	/* Only unmap what we mapped */
+	if (!vma_range_is(addr, addr + length, 0)) ret = -EINVAL;
+	else ret = vma_range_set(addr, addr + length, 1);
+	ps_lock_release(&vma_lock);
+
+	return ret;
 }
 
 int
@@ -131,9 +351,33 @@ cos_madvise(void *start, size_t length, int advice)
 void *
 cos_mremap(void *old_address, size_t old_size, size_t new_size, int flags)
 {
-	printc("mremap not implemented\n");
-	errno = ENOSYS;
-	return (void*) -1;
+	vaddr_t addr = (vaddr_t)old_address, new_addr;
+	long ret;
+
+	if (addr % PAGE_SIZE || new_size == 0 || (flags & ~MREMAP_MAYMOVE)) return (void *)-EINVAL;
+	old_size = round_up_to_page(old_size);
+	new_size = round_up_to_page(new_size);
+
+	ps_lock_take(&vma_lock);
+	if (!vma_range_is(addr, addr + old_size, 0)) ERR_THROW(-EFAULT, done);
+	ret = addr;
+	if (new_size < old_size) {
+		if (vma_range_set(addr + new_size, addr + old_size, 1)) ret = -ENOMEM;
+		goto done;
+	}
+	if (new_size == old_size || !vma_grow(addr, old_size, new_size)) goto done;
+	if (!(flags & MREMAP_MAYMOVE)) ERR_THROW(-ENOMEM, done);
+
+	/* Couldn't grow in place: move the mapping */
+	new_addr = vma_alloc(new_size);
+	if (!new_addr) ERR_THROW(-ENOMEM, done);
+	memcpy((void *)new_addr, (void *)addr, old_size);
+	vma_range_set(addr, addr + old_size, 1);
+	ret = new_addr;
+done:
+	ps_lock_release(&vma_lock);
+
+	return (void *)ret;
 }
 
 int
@@ -148,6 +392,7 @@ void
 libc_posixcap_initialization_handler()
 {
 	ps_lock_init(&stdout_lock);
+	ps_lock_init(&vma_lock);
 	libc_syscall_override((cos_syscall_t)(void*)cos_write, __NR_write);
 	libc_syscall_override((cos_syscall_t)(void*)cos_writev, __NR_writev);
 	libc_syscall_override((cos_syscall_t)(void*)cos_ioctl, __NR_ioctl);
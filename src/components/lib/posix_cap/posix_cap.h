@@ -0,0 +1,19 @@
+#ifndef POSIX_CAP_H
+#define POSIX_CAP_H
+
+/*
+ * Anonymous mappings are tracked in a fixed table of VMA_MAX (1024)
+ * areas, each a run of contiguous memory that is either all mapped or
+ * all free (adjacent areas in the same state are merged). mmap, munmap
+ * and mremap fail with -ENOMEM when fragmentation would need more
+ * areas than that.
+ */
+
+/*
+ * Back the following anonymous mappings with physically contiguous
+ * memory (e.g. for DMA), which is never freed, rather than with the
+ * pages of the VMA manager.
+ */
+void posix_cap_mmap_contig(int contig);
+
+#endif /* POSIX_CAP_H */
@@ -11,6 +11,7 @@
 
 #include <cos_component.h>
 #include <cos_defkernel_api.h>
+#include <cos_time.h>
 #include <llprint.h>
 #include <posix.h>
 #include <ps_list.h>
@@ -148,71 +149,334 @@ cos_clone(int (*func)(void *), void *stack, int flags, void *arg, pid_t *ptid, v
 #define FUTEX_UNLOCK_PI		7
 #define FUTEX_TRYLOCK_PI	8
 #define FUTEX_WAIT_BITSET	9
+#define FUTEX_WAKE_BITSET	10
 
 #define FUTEX_PRIVATE 128
 
 #define FUTEX_CLOCK_REALTIME 256
 
-struct futex_data
+#define FUTEX_BITSET_ANY 0xffffffff
+
+/*
+ * Waiters are hashed on their futex's address into a fixed number of
+ * buckets, each with its own lock and list of waiters (on different
+ * futexes that share the bucket).
+ */
+#define FUTEX_BUCKETS_ORDER 10
+#define FUTEX_BUCKETS (1 << FUTEX_BUCKETS_ORDER)
+
+/*
+ * Wakers dequeue waiters with the bucket locked, but only wake them
+ * after releasing it, at most this many at a time.
+ */
+#define FUTEX_WAKE_BATCH 16
+
+struct futex_bucket
 {
-	int *uaddr;
+	struct ps_lock lock;
 	struct ps_list_head waiters;
 };
 
+/* On the stack of the waiting thread */
 struct futex_waiter
 {
+	int *uaddr;
+	u32_t bitset;
 	thdid_t thdid;
+	int woken;
 	struct ps_list list;
 };
 
-#define FUTEX_COUNT 20
-struct futex_data futexes[FUTEX_COUNT];
+static struct futex_bucket futex_buckets[FUTEX_BUCKETS];
+
+int cos_clock_gettime(clockid_t clock_id, struct timespec *ts);
+
+static inline struct futex_bucket *
+futex_bucket(int *uaddr)
+{
+	/* Fibonacci hashing of the (word-aligned) address */
+	unsigned long h = ((unsigned long)uaddr >> 2) * 0x9E3779B97F4A7C15UL;
+
+	return &futex_buckets[h >> (sizeof(unsigned long) * 8 - FUTEX_BUCKETS_ORDER)];
+}
+
+/* Take the locks of two buckets, in a consistent order */
+static void
+futex_bucket_lock2(struct futex_bucket *b1, struct futex_bucket *b2)
+{
+	if (b1 == b2) {
+		ps_lock_take(&b1->lock);
+	} else if (b1 < b2) {
+		ps_lock_take(&b1->lock);
+		ps_lock_take(&b2->lock);
+	} else {
+		ps_lock_take(&b2->lock);
+		ps_lock_take(&b1->lock);
+	}
+}
+
+static void
+futex_bucket_unlock2(struct futex_bucket *b1, struct futex_bucket *b2)
+{
+	ps_lock_release(&b1->lock);
+	if (b1 != b2) ps_lock_release(&b2->lock);
+}
+
+/*
+ * Dequeue a waiter, with its bucket locked, and return its thread to
+ * wake once the lock is released.
+ */
+static thdid_t
+futex_waiter_dequeue(struct futex_waiter *w)
+{
+	thdid_t thdid = w->thdid;
+
+	ps_list_rem_d(w);
+	/* The waiter can return (and its stack be reused) once this is set */
+	__atomic_store_n(&w->woken, 1, __ATOMIC_RELEASE);
+
+	return thdid;
+}
 
-struct futex_data *
-lookup_futex(int *uaddr)
+/*
+ * As the waiter can return before it is woken, the wakeup can be
+ * spurious for its next block. Like Linux's, callers of futex_wait
+ * must tolerate spurious wakeups.
+ */
+static void
+futex_thds_wake(thdid_t *thds, int n)
 {
-	int last_free = -1;
 	int i;
 
-	for (i = 0; i < FUTEX_COUNT; i++) {
-		if (futexes[i].uaddr == uaddr) {
-			return &futexes[i];
-		} else if (futexes[i].uaddr == 0) {
-			last_free = i;
-		}
+	for (i = 0; i < n; i++) sched_thd_wakeup(thds[i]);
+}
+
+/*
+ * Lock the bucket the waiter is on. A requeue can move it to another
+ * bucket (with both locked), so retry until its futex is stable.
+ */
+static struct futex_bucket *
+futex_waiter_lock(struct futex_waiter *w)
+{
+	struct futex_bucket *b;
+	int *uaddr;
+
+	while (1) {
+		uaddr = __atomic_load_n(&w->uaddr, __ATOMIC_ACQUIRE);
+		b     = futex_bucket(uaddr);
+		ps_lock_take(&b->lock);
+		if (__atomic_load_n(&w->uaddr, __ATOMIC_ACQUIRE) == uaddr) return b;
+		ps_lock_release(&b->lock);
 	}
-	if (last_free >= 0) {
-		futexes[last_free] = (struct futex_data) {
-			.uaddr = uaddr
-		};
-		ps_list_head_init(&futexes[last_free].waiters);
-		return &futexes[last_free];
+}
+
+/*
+ * The absolute deadline of the wait in cycles, or 0 if it doesn't
+ * have one. FUTEX_WAIT's timeout is relative, and FUTEX_WAIT_BITSET's
+ * absolute (on CLOCK_MONOTONIC, or CLOCK_REALTIME).
+ */
+static int
+futex_deadline(int cmd, int op, const struct timespec *timeout, cycles_t *deadline)
+{
+	struct timespec now;
+	microsec_t rel;
+
+	*deadline = 0;
+	if (!timeout) return 0;
+	if (timeout->tv_sec < 0 || timeout->tv_nsec < 0 || timeout->tv_nsec >= 1000000000L) return -EINVAL;
+
+	if (cmd == FUTEX_WAIT) {
+		rel = time_to_microsec(timeout);
+	} else {
+		cos_clock_gettime(op & FUTEX_CLOCK_REALTIME ? CLOCK_REALTIME : CLOCK_MONOTONIC, &now);
+		if (time_to_microsec(timeout) <= time_to_microsec(&now)) return -ETIMEDOUT;
+		rel = time_to_microsec(timeout) - time_to_microsec(&now);
 	}
-	printc("Out of futex ids!");
-	assert(0);
+	*deadline = time_now() + time_usec2cyc(rel);
+
+	return 0;
+}
+
+static int
+futex_wait(int *uaddr, int val, u32_t bitset, cycles_t deadline)
+{
+	struct futex_bucket *b = futex_bucket(uaddr);
+	struct futex_waiter w = {
+		.uaddr  = uaddr,
+		.bitset = bitset,
+		.thdid  = cos_thdid(),
+		.woken  = 0,
+	};
+
+	if (!bitset) return -EINVAL;
+
+	ps_list_init_d(&w);
+	ps_lock_take(&b->lock);
+	/* The value is checked with the lock held, so a waker that changed it can't miss us */
+	if (__atomic_load_n(uaddr, __ATOMIC_SEQ_CST) != val) {
+		ps_lock_release(&b->lock);
+		return -EAGAIN;
+	}
+	ps_list_head_append_d(&b->waiters, &w);
+	ps_lock_release(&b->lock);
+
+	while (!__atomic_load_n(&w.woken, __ATOMIC_ACQUIRE)) {
+		if (!deadline) {
+			sched_thd_block(0);
+			continue;
+		}
+
+		if (time_now() >= deadline) {
+			/* We might have been requeued onto another bucket */
+			b = futex_waiter_lock(&w);
+			/* Still waiting? We weren't woken before the deadline */
+			if (!__atomic_load_n(&w.woken, __ATOMIC_ACQUIRE)) {
+				ps_list_rem_d(&w);
+				ps_lock_release(&b->lock);
+				return -ETIMEDOUT;
+			}
+			ps_lock_release(&b->lock);
+			break;
+		}
+		sched_thd_block_wakeable(0, deadline);
+	}
+
+	return 0;
 }
 
-/* TODO: Cleanup empty futexes */
-static struct ps_lock futex_lock;
+static int
+futex_wake(int *uaddr, int nwake, u32_t bitset)
+{
+	struct futex_bucket *b = futex_bucket(uaddr);
+	struct futex_waiter *w, *tmp;
+	thdid_t thds[FUTEX_WAKE_BATCH];
+	int woken = 0, n;
+
+	if (!bitset) return -EINVAL;
+
+	do {
+		n = 0;
+		ps_lock_take(&b->lock);
+		ps_list_foreach_del_d(&b->waiters, w, tmp) {
+			if (woken >= nwake || n == FUTEX_WAKE_BATCH) break;
+			if (w->uaddr != uaddr || !(w->bitset & bitset)) continue;
+
+			thds[n++] = futex_waiter_dequeue(w);
+			woken++;
+		}
+		ps_lock_release(&b->lock);
+		futex_thds_wake(thds, n);
+	} while (n == FUTEX_WAKE_BATCH && woken < nwake);
 
+	return woken;
+}
+
+/*
+ * Wake nwake of the waiters on uaddr, and move up to nrequeue of the
+ * others to wait on uaddr2 (e.g. a condvar's waiters to its mutex). The
+ * CMP_REQUEUE variant only does so if uaddr still holds cmpval.
+ */
+static int
+futex_requeue(int *uaddr, int *uaddr2, int nwake, int nrequeue, int cmp, int cmpval)
+{
+	struct futex_bucket *b1 = futex_bucket(uaddr), *b2 = futex_bucket(uaddr2);
+	struct futex_waiter *w, *tmp;
+	thdid_t thds[FUTEX_WAKE_BATCH];
+	int woken = 0, requeued = 0, n;
+
+	if (nwake < 0 || nrequeue < 0) return -EINVAL;
+
+	do {
+		n = 0;
+		futex_bucket_lock2(b1, b2);
+		if (cmp && __atomic_load_n(uaddr, __ATOMIC_SEQ_CST) != cmpval) {
+			futex_bucket_unlock2(b1, b2);
+			return -EAGAIN;
+		}
+		/* Only the first batch is conditional */
+		cmp = 0;
+
+		ps_list_foreach_del_d(&b1->waiters, w, tmp) {
+			if (w->uaddr != uaddr) continue;
+
+			if (woken < nwake) {
+				if (n == FUTEX_WAKE_BATCH) break;
+				thds[n++] = futex_waiter_dequeue(w);
+				woken++;
+			} else if (requeued < nrequeue) {
+				__atomic_store_n(&w->uaddr, uaddr2, __ATOMIC_RELEASE);
+				if (b1 != b2) {
+					ps_list_rem_d(w);
+					ps_list_head_append_d(&b2->waiters, w);
+				}
+				requeued++;
+			} else {
+				break;
+			}
+		}
+		futex_bucket_unlock2(b1, b2);
+		futex_thds_wake(thds, n);
+	} while (n == FUTEX_WAKE_BATCH && woken < nwake);
+
+	return woken + requeued;
+}
+
+/*
+ * The futex system call. As it is called by musl as a raw system call,
+ * errors are returned as negative errnos. Futexes are private to the
+ * component, so FUTEX_PRIVATE is ignored.
+ */
 int
 cos_futex(int *uaddr, int op, int val,
           const struct timespec *timeout, /* or: uint32_t val2 */
 		  int *uaddr2, int val3)
 {
-	printc("futex not implemented\n");
-	errno = ENOSYS;
-	return -1;
+	int cmd = op & ~(FUTEX_PRIVATE | FUTEX_CLOCK_REALTIME);
+	cycles_t deadline;
+	int ret;
+
+	if (!uaddr || ((unsigned long)uaddr % sizeof(int))) return -EINVAL;
+
+	switch (cmd) {
+	case FUTEX_WAIT:
+		val3 = FUTEX_BITSET_ANY;
+		/* fallthrough */
+	case FUTEX_WAIT_BITSET:
+		ret = futex_deadline(cmd, op, timeout, &deadline);
+		if (ret) return ret;
+
+		return futex_wait(uaddr, val, (u32_t)val3, deadline);
+	case FUTEX_WAKE:
+		val3 = FUTEX_BITSET_ANY;
+		/* fallthrough */
+	case FUTEX_WAKE_BITSET:
+		return futex_wake(uaddr, val, (u32_t)val3);
+	case FUTEX_REQUEUE:
+		return futex_requeue(uaddr, uaddr2, val, (int)(unsigned long)timeout, 0, 0);
+	case FUTEX_CMP_REQUEUE:
+		return futex_requeue(uaddr, uaddr2, val, (int)(unsigned long)timeout, 1, val3);
+	default:
+		printc("futex op %d not implemented\n", cmd);
+		return -ENOSYS;
+	}
 }
 
 int
 cos_clock_gettime(clockid_t clock_id, struct timespec *ts)
 {
+	microsec_t now;
+
 	switch (clock_id)
 	{
 	case CLOCK_REALTIME:
 		/* code */
 		ts->tv_sec = 3600; //one hour after 1970-01-01, just a hack.
+		ts->tv_nsec = 0;
+		break;
+	case CLOCK_MONOTONIC:
+		now = time_now_usec();
+		ts->tv_sec  = now / 1000000;
+		ts->tv_nsec = (now % 1000000) * 1000;
 		break;
 	
 	default:
@@ -239,7 +503,12 @@ libc_tls_init(unsigned int cpuid)
 void
 libc_posixsched_initialization_handler()
 {
-	ps_lock_init(&futex_lock);
+	int i;
+
+	for (i = 0; i < FUTEX_BUCKETS; i++) {
+		ps_lock_init(&futex_buckets[i].lock);
+		ps_list_head_init(&futex_buckets[i].waiters);
+	}
 	libc_syscall_override((cos_syscall_t)(void*)cos_nanosleep, __NR_nanosleep);
 	libc_syscall_override((cos_syscall_t)(void*)cos_rt_sigprocmask, __NR_rt_sigprocmask);
 	libc_syscall_override((cos_syscall_t)(void*)cos_gettid, __NR_gettid);
@@ -30,14 +30,15 @@
  * name sz = 2^39
  * 2^48 / 2^39 = 2^9 = 512 names
  * 2^9 / 2 to ensure the array fits into a page = 256 names
- * also: more ASIDs available in 64 bit
+ * also: ASIDs are virtual (the kernel maps them onto the 4096
+ * hardware PCIDs), so there can be more of them
  */
 
 #define PROTDOM_VAS_NAME_SZ 		(1ULL << 39)
 #define PROTDOM_VAS_NUM_NAMES 		256
 #define PROTDOM_MPK_NUM_NAMES 		14
 #define PROTDOM_MPK_FIRST_COMP		2
-#define PROTDOM_ASID_NUM_NAMES 		4096
+#define PROTDOM_ASID_NUM_NAMES 		16384
 
 #define PROTDOM_NS_STATE_RESERVED 	1
 #define PROTDOM_NS_STATE_ALLOCATED 	1 << 1
@@ -5,7 +5,7 @@
 #define PROTDOM_VAS_NAME_SZ 	(1ULL << 39)
 #define PROTDOM_VAS_NUM_NAMES 	256
 #define PROTDOM_MPK_NUM_NAMES 	14
-#define PROTDOM_ASID_NUM_NAMES 	4096
+#define PROTDOM_ASID_NUM_NAMES 	16384
 
 #define PROTDOM_NS_STATE_RESERVED 	1
 #define PROTDOM_NS_STATE_ALLOCATED 1 << 1
@@ -3,6 +3,11 @@
 #include <ps_list.h>
 
 struct slm_global __slm_global[NUM_CPU];
+/* Per-core kernel scheduler event rings, each in its own page */
+struct slm_sched_ring {
+	struct cos_sched_ring ring;
+} PAGE_ALIGNED;
+struct slm_sched_ring __slm_sched_rings[NUM_CPU];
 struct slm_ipi_percore slm_ipi_percore_data[NUM_CPU];
 
 CK_RING_PROTOTYPE(slm_ipi_ringbuf, slm_ipi_event);
@@ -91,6 +96,12 @@ slm_thd_init(struct slm_thd *t, thdcap_t thd, thdid_t tid)
 	int ret;
 
 	if ((ret = slm_thd_init_internal(t, thd, tid))) return ret;
+	/*
+	 * Have the kernel report this thread's scheduling events
+	 * with a pointer to it. If this fails, events fall back on
+	 * the thread id lookup.
+	 */
+	cos_thd_sched_data_set(&cos_defcompinfo_curr_get()->ci, thd, (word_t)t);
 	if ((ret = slm_timer_thd_init(t))) return ret;
 	if ((ret = slm_sched_thd_init(t))) return ret;
 
@@ -460,6 +471,33 @@ slm_get_cycs_per_usec(void)
 	return (unsigned long)g->cyc_per_usec;
 }
 
+/*
+ * Drain the kernel's scheduler event ring, adding each event to the
+ * list of events to process within the critical section. This avoids
+ * a `cos_sched_rcv` per event.
+ */
+static inline void
+slm_sched_ring_drain(struct slm_global *g)
+{
+	struct cos_sched_ring *r    = g->sched_ring;
+	unsigned long          head = r->head;
+	unsigned long          tail = ps_load(&r->tail);
+
+	for (; head != tail; head++) {
+		struct cos_sched_event *e = &r->evts[head & COS_SCHED_RING_MASK];
+		struct slm_thd         *t = (struct slm_thd *)e->sched_data;
+
+		if (unlikely(!t)) t = slm_thd_lookup(e->tid);
+		assert(t);
+		/* don't report the idle thread or a freed thread */
+		if (unlikely(t == &g->idle_thd || slm_state_is_dead(t->state))) continue;
+
+		slm_thd_event_enqueue(t, e->blocked, e->elapsed, e->timeout);
+	}
+	/* Release the ring slots back to the kernel */
+	ps_store(&r->head, head);
+}
+
 static void
 slm_sched_loop_intern(int non_block)
 {
@@ -493,13 +531,15 @@ slm_sched_loop_intern(int non_block)
 			 * to the potential blocking.
 			 */
 			pending = cos_sched_rcv(us->rcv, rfl, g->timeout_next, &rcvd, &tid, &blocked, &cycles, &thd_timeout);
+			/* With an event ring, the kernel delivered the events in bulk */
+			if (likely(g->sched_ring)) {
+				slm_sched_ring_drain(g);
+				goto pending_events;
+			}
 			if (!tid) goto pending_events;
 			/*
-			 * FIXME: kernel should pass an untyped
-			 * pointer back here that we can use instead
-			 * of the tid. This is the only place where
-			 * slm requires the thread id -> thread
-			 * mapping ;-(
+			 * Without the event ring, the kernel only
+			 * reports the thread id, thus the lookup.
 			 */
 			t = slm_thd_lookup(tid);
 			assert(t);
@@ -629,6 +669,11 @@ slm_init(thdcap_t thd, thdid_t tid)
 	g->cyc_per_usec = cos_hw_cycles_per_usec(BOOT_CAPTBL_SELF_INITHW_BASE);
 	g->lock.owner_contention = 0;
 
+	/* Receive scheduling events in bulk, if the kernel allows it */
+	cos_thd_sched_data_set(&defci->ci, i->thd, (word_t)i);
+	g->sched_ring = &__slm_sched_rings[cos_cpuid()].ring;
+	if (cos_sched_ring_set(&defci->ci, s->thd, g->sched_ring)) g->sched_ring = NULL;
+
 	slm_sched_init();
 	slm_timer_init();
 }
@@ -2,7 +2,10 @@
 #include <slm_blkpt.h>
 #include <stacklist.h>
 
+/* The composer can size this from the clients' LOCAL_BOUND_BLKPTS */
+#ifndef NBLKPTS
 #define NBLKPTS 40960
+#endif
 struct blkpt_mem {
 	sched_blkpt_id_t      id;
 	sched_blkpt_epoch_t   epoch;
@@ -32,7 +35,7 @@ blkpt_epoch_is_higher(sched_blkpt_epoch_t e, sched_blkpt_epoch_t cmp)
 static struct blkpt_mem *
 blkpt_get(sched_blkpt_id_t id)
 {
-	if (id - 1 == NBLKPTS) return NULL;
+	if (id - 1 >= NBLKPTS) return NULL;
 
 	return &__blkpts[id-1];
 }
@@ -110,12 +113,34 @@ unlock:
 	return ret;
 }
 
+/*
+ * Priority inheritance: the current thread has blocked awaiting an
+ * event that `dep` will generate (e.g. a lock release), so switch
+ * directly to `dep`, and have it execute at our priority. The
+ * critical section is held on entry, and is still held on return so
+ * that the caller can fall back on a normal reschedule if `dep` cannot
+ * run, or once we've been switched back to.
+ */
+static void
+slm_blkpt_dep_switch(struct slm_thd *current, struct slm_thd *dep)
+{
+	sched_tok_t tok;
+
+	tok = cos_sched_sync();
+	if (!slm_state_is_runnable(dep->state)) return;
+	slm_cs_exit(NULL, SLM_CS_NONE);
+	/* Failures (races, or dep blocked) are handled by the reschedule */
+	slm_switch_to(current, dep, tok, 1);
+	slm_cs_enter(current, SLM_CS_NONE);
+}
+
 int
 slm_blkpt_block(sched_blkpt_id_t blkpt, struct slm_thd *current, sched_blkpt_epoch_t epoch, thdid_t dependency)
 {
 	struct blkpt_mem *m;
 	struct stacklist sl; 	/* The stack-based structure we'll use to track ourself */
 	struct stacklist *_sl;
+	struct slm_thd *dep;
 	int ret = 0;
 	sched_blkpt_epoch_t pre;
 
@@ -156,6 +181,11 @@ slm_blkpt_block(sched_blkpt_id_t blkpt, struct slm_thd *current, sched_blkpt_epo
 		ERR_THROW(0, unlock);
 	}
 	ps_lock_release(&m->lock);
+	if (dependency) {
+		dep = slm_thd_lookup(dependency);
+		/* We can only lend our priority to a thread on this core */
+		if (dep && dep != current && dep->cpuid == cos_cpuid()) slm_blkpt_dep_switch(current, dep);
+	}
 	slm_cs_exit_reschedule(current, SLM_CS_NONE);
 	assert(stacklist_is_removed(&sl));
 
@@ -68,6 +68,7 @@ struct slm_global {
 	cycles_t    timer_next;	  /* ...what is it set to? */
 	tcap_time_t timeout_next; /* ...and what is the tcap representation? */
 
+	struct cos_sched_ring *sched_ring;  /* kernel event ring, or NULL */
 	struct ps_list_head event_head;     /* all pending events for sched end-point */
 	struct ps_list_head graveyard_head; /* all deinitialized threads */
 } CACHE_ALIGNED;
@@ -408,10 +408,22 @@ sync_blkpt_wait(struct sync_blkpt *blkpt, sync_blkpt_flags_t flags, struct sync_
 	sync_blkpt_id_wait(blkpt, blkpt->id, flags, chkpt);
 }
 
-/*
- * Create an execution dependency on the specified thread for,
- * e.g. priority inheritance.
+/**
+ * Wait for an event, and create an execution dependency on the
+ * specified thread for, e.g. priority inheritance. The scheduler will
+ * execute `thdid` with our priority while we're blocked, if it can.
+ *
+ * - @blkpt  - the blockpoint
+ * - @flags  - optional flags
+ * - @chkpt  - the previously taken checkpoint
+ * - @thdid  - the thread we depend on, or `0` for none
  */
-/* void sync_blkpt_wait_dep(struct sync_blkpt *blkpt, sync_blkpt_flags_t flags, struct sync_blkpt_checkpoint *chkpt, cos_thdid_t thdid); */
+static inline void
+sync_blkpt_wait_dep(struct sync_blkpt *blkpt, sync_blkpt_flags_t flags, struct sync_blkpt_checkpoint *chkpt, thdid_t thdid)
+{
+	if (unlikely(sched_blkpt_block(blkpt->id, SYNC_BLKPT_EPOCH(chkpt->epoch_blocked), thdid))) {
+		BUG(); 		/* we are using a blkpt id that doesn't exist! */
+	}
+}
 
 #endif /* SYNC_BLKPT_H */
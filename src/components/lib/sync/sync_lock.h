@@ -3,12 +3,14 @@
 
 /***
  * Simple blocking lock. Uses blockpoints to enable the blocking and
- * waking of contending threads.
+ * waking of contending threads. Contending threads spin for a bounded
+ * duration if the owner is executing on another core (as reported by
+ * the scheduler), and otherwise block with a dependency on the owner
+ * for priority inheritance.
  *
  * **TODO**:
  *
- * - Add dependency specification for PI.
- * - Add optional adaptive spinning and non-preemptivity -- generally, multicore awareness
+ * - Add optional non-preemptivity.
  * - Thorough testing.
  */
 
@@ -62,8 +64,44 @@ sync_lock_teardown(struct sync_lock *l)
 	return sync_blkpt_teardown(&l->blkpt);
 }
 
+/*
+ * The number of iterations we'll spin awaiting the release of a lock
+ * whose owner is executing on another core, before blocking.
+ */
+#ifndef SYNC_LOCK_SPIN_ITERS
+#define SYNC_LOCK_SPIN_ITERS 1024
+#endif
+
+/*
+ * Adaptive spinning: if the owner is actively executing on another
+ * core, it is likely to release the lock soon, so spin awaiting that
+ * release rather than paying for blocking and waking. If the owner
+ * isn't running (e.g. it is preempted, or on our core), spinning
+ * only delays it, so we don't.
+ *
+ * - @return - `1` if the lock was observed to be released (retry the
+ *             acquisition), `0` if we should block.
+ */
+static inline int
+__sync_lock_spin(struct sync_lock *l, unsigned long owner_blked)
+{
+	int i;
+
+	/* Only ask the scheduler once per contended acquisition */
+	if (!sched_thd_running((thdid_t)SYNC_LOCK_OWNER(owner_blked))) return 0;
+
+	for (i = 0; i < SYNC_LOCK_SPIN_ITERS; i++) {
+		if (ps_load(&l->owner_blked) != owner_blked) return 1;
+	}
+
+	return 0;
+}
+
 /**
- * Take the lock.
+ * Take the lock. This is an adaptive mutex: we spin for a bounded
+ * amount of time while the owner is running on another core, and
+ * otherwise block on the blockpoint with a dependency on the owner so
+ * that the scheduler can provide priority inheritance.
  *
  * @precondition - we have *not* already taken the lock. Recursive
  * locks not allowed currently.
@@ -73,10 +111,8 @@ sync_lock_teardown(struct sync_lock *l)
 static inline void
 sync_lock_take(struct sync_lock *l)
 {
-#if 1
-	ps_lock_take((struct ps_lock *)&l->owner_blked);
-#else
 	struct sync_blkpt_checkpoint chkpt;
+	unsigned long me = (unsigned long)cos_thdid();
 
 	while (1) {
 		unsigned long owner_blked;
@@ -85,22 +121,31 @@ sync_lock_take(struct sync_lock *l)
 
 		owner_blked = ps_load(&l->owner_blked);
 		/* Can we take the lock? */
-		if (ps_cas(&l->owner_blked, 0, (unsigned long)cos_thdid())) {
-			return;	/* success! */
+		if (likely(owner_blked == 0)) {
+			if (likely(ps_cas(&l->owner_blked, 0, me))) return; /* success! */
+			continue;
 		}
+		assert(SYNC_LOCK_OWNER(owner_blked) != me);
+
+		/* Only spin if no-one has given up and blocked yet */
+		if (!SYNC_LOCK_BLKED(owner_blked) && __sync_lock_spin(l, owner_blked)) continue;
 
 		/* slowpath: we're blocking! Set the blocked bit, or try again */
-		if (!ps_cas(&l->owner_blked, owner_blked, owner_blked | SYNC_LOCK_BLKED_MASK)) continue;
+		if (!SYNC_LOCK_BLKED(owner_blked) &&
+		    !ps_cas(&l->owner_blked, owner_blked, owner_blked | SYNC_LOCK_BLKED_MASK)) continue;
 
-		/* We can't take the lock, have set the block bit, and await release */
-		sync_blkpt_wait(&l->blkpt, 0, &chkpt);
+		/*
+		 * We can't take the lock, have set the block bit, and
+		 * await release. The owner is the dependency so that
+		 * it can inherit our priority.
+		 */
+		sync_blkpt_wait_dep(&l->blkpt, 0, &chkpt, (thdid_t)SYNC_LOCK_OWNER(owner_blked));
 	}
-#endif
 }
 
 /**
  * Attempts to take the lock, and returns a value depending on if it
- * takes it, or not.
+ * takes it, or not. This never spins nor blocks.
  *
  * - @l - the `sync_lock`
  * - @return - `0` on successful lock acquisition,
@@ -109,19 +154,15 @@ sync_lock_take(struct sync_lock *l)
 static inline int
 sync_lock_try_take(struct sync_lock *l)
 {
-#if 1
-	return l->owner_blked;
-#else
-	if (ps_cas(&l->owner_blked, 0, (unsigned long)cos_thdid())) {
+	if (ps_load(&l->owner_blked) == 0 && ps_cas(&l->owner_blked, 0, (unsigned long)cos_thdid())) {
 		return 0;	/* success! */
-	} else {
-		return 1;
 	}
-#endif
+
+	return 1;
 }
 
 /**
- * Release the lock.
+ * Release the lock, and wake any threads that blocked awaiting it.
  *
  * @precondition: we must have previously taken the lock.
  *
@@ -130,9 +171,6 @@ sync_lock_try_take(struct sync_lock *l)
 static inline void
 sync_lock_release(struct sync_lock *l)
 {
-#if 1
-	ps_lock_release((struct ps_lock *)&l->owner_blked);	
-#else
 	while (1) {
 		unsigned long o_b = ps_load(&l->owner_blked);
 		int blked = unlikely(SYNC_LOCK_BLKED(o_b) == SYNC_LOCK_BLKED_MASK);
@@ -151,7 +189,6 @@ sync_lock_release(struct sync_lock *l)
 
 		return;
 	}
-#endif
 }
 
 #endif /* SYNC_LOCK_H */
@@ -8,6 +8,8 @@
 #include <cos_component.h>
 #include <cos_kernel_api.h>
 #include <capmgr.h>
+#include <memmgr.h>
+#include <perfdata.h>
 
 #include <sched.h>
 #include <vmrt.h>
@@ -108,7 +110,9 @@ vmrt_vm_vcpu_init(struct vmrt_vm_comp *vm, u32_t vcpu_nr)
 	vcpu->coreid = cos_coreid();
 
 	vcpu->next_timer = ~0ULL;
-
+	/* The other vcpus start with their startup IPI (see vmrt_vcpu_startup) */
+	vcpu->started = (vcpu_nr == 0);
+	vcpu->halt_poll = 0;
 }
 
 void
@@ -120,6 +124,28 @@ vmrt_vm_mem_init(struct vmrt_vm_comp *vm, void *mem)
 	memset(mem, 0, vm->guest_mem_sz);
 }
 
+/*
+ * The exit statistics of all vcpus are in a single shared memory
+ * region, so a monitoring component can map it (with
+ * memmgr_shared_page_map and exit_stats_shm) to read them.
+ */
+static void
+vmrt_exit_stats_create(struct vmrt_vm_comp *vm)
+{
+	struct vmrt_vcpu_exit_stats *stats;
+	unsigned long npages;
+	vaddr_t addr;
+	u8_t i;
+
+	npages = round_up_to_page(sizeof(struct vmrt_vcpu_exit_stats) * vm->num_vpu) / PAGE_SIZE;
+	vm->exit_stats_shm = memmgr_shared_page_allocn(npages, &addr);
+	assert(vm->exit_stats_shm && addr);
+	memset((void *)addr, 0, npages * PAGE_SIZE);
+
+	stats = (struct vmrt_vcpu_exit_stats *)addr;
+	for (i = 0; i < vm->num_vpu; i++) vm->vcpus[i].exit_stats = &stats[i];
+}
+
 void
 vmrt_vm_create(struct vmrt_vm_comp *vm, char *name, u8_t num_vcpu, u64_t vm_mem_sz)
 {
@@ -149,10 +175,12 @@ vmrt_vm_create(struct vmrt_vm_comp *vm, char *name, u8_t num_vcpu, u64_t vm_mem_
 	assert(lapic_access_page);
 	vm->lapic_access_page = lapic_access_page;
 
-	assert(num_vcpu < VMRT_VM_MAX_VCPU);
+	assert(num_vcpu <= VMRT_VM_MAX_VCPU);
 	vm->num_vpu = num_vcpu;
 	vm->guest_mem_sz = vm_mem_sz;  
 
+	vmrt_exit_stats_create(vm);
+
 	strcpy((char *)&vm->name, name);
 
 	return;
@@ -172,6 +200,115 @@ vmrt_vm_vcpu_resume(struct vmrt_vm_vcpu *vcpu)
 }
 
 
+/* The window (in cycles) in which a halted vcpu polls for interrupts */
+#define VMRT_HALT_POLL_MIN (10000)
+#define VMRT_HALT_POLL_MAX (200000)
+
+/*
+ * Only the vcpu's handler thread uses its lapic, so interrupts from
+ * other threads (devices, and the IPIs of other vcpus) are posted, and
+ * the handler delivers them before it next resumes the vcpu. A vcpu
+ * that is executing on another core sees them at its next VM-exit.
+ */
+void
+vmrt_vcpu_intr_post(struct vmrt_vm_vcpu *vcpu, u8_t vector)
+{
+	__atomic_fetch_or(&vcpu->pending_intr[vector / 64], 1ULL << (vector % 64), __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&vcpu->halted, __ATOMIC_SEQ_CST)) sched_thd_wakeup(vcpu->handler_tid);
+}
+
+static void
+vmrt_vcpu_intr_deliver(struct vmrt_vm_vcpu *vcpu)
+{
+	u64_t pending;
+	int i, bit;
+
+	for (i = 0; i < 4; i++) {
+		if (!vcpu->pending_intr[i]) continue;
+
+		pending = __atomic_exchange_n(&vcpu->pending_intr[i], 0, __ATOMIC_SEQ_CST);
+		while (pending) {
+			bit = __builtin_ctzll(pending);
+			pending &= pending - 1;
+			lapic_intr_inject(vcpu, i * 64 + bit, 0);
+		}
+	}
+}
+
+/* Does the halted vcpu have an interrupt to take? */
+static int
+vmrt_vcpu_intr_ready(struct vmrt_vm_vcpu *vcpu, cycles_t now)
+{
+	int i;
+
+	/* The requesting virtual interrupt is the highest pending one */
+	if ((u8_t)vcpu->shared_region->interrupt_status) return 1;
+	if (now >= vcpu->next_timer) return 1;
+	for (i = 0; i < 4; i++) {
+		if (__atomic_load_n(&vcpu->pending_intr[i], __ATOMIC_SEQ_CST)) return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * The guest halted until its next interrupt. Poll for it for a while
+ * before blocking the handler until then (or its timer's deadline): if
+ * it comes soon, e.g. from a device on another core, switching away and
+ * back costs more than the wait. The window grows when the vcpu blocked
+ * for less than the longest window, so polling would have caught the
+ * interrupt, and shrinks when it blocked for longer.
+ */
+static void
+vmrt_vcpu_halt(struct vmrt_vm_vcpu *vcpu)
+{
+	cycles_t start, now;
+
+	GOTO_NEXT_INST(vcpu->shared_region);
+
+	rdtscll(start);
+	now = start;
+	while (now - start < vcpu->halt_poll) {
+		if (vmrt_vcpu_intr_ready(vcpu, now)) return;
+		__asm__ volatile("pause");
+		rdtscll(now);
+	}
+
+	__atomic_store_n(&vcpu->halted, 1, __ATOMIC_SEQ_CST);
+	while (!vmrt_vcpu_intr_ready(vcpu, now)) {
+		if (vcpu->next_timer == ~0ULL) {
+			sched_thd_block(0);
+		} else {
+			sched_thd_block_wakeable(0, vcpu->next_timer);
+		}
+		rdtscll(now);
+	}
+	__atomic_store_n(&vcpu->halted, 0, __ATOMIC_SEQ_CST);
+
+	if (now - start <= VMRT_HALT_POLL_MAX) {
+		vcpu->halt_poll = vcpu->halt_poll ? vcpu->halt_poll * 2 : VMRT_HALT_POLL_MIN;
+		if (vcpu->halt_poll > VMRT_HALT_POLL_MAX) vcpu->halt_poll = VMRT_HALT_POLL_MAX;
+	} else {
+		vcpu->halt_poll /= 2;
+		if (vcpu->halt_poll < VMRT_HALT_POLL_MIN) vcpu->halt_poll = 0;
+	}
+}
+
+/*
+ * A startup IPI to the vcpu: the kernel starts it in real mode at the
+ * vector's page. Only the first one starts the vcpu.
+ */
+void
+vmrt_vcpu_startup(struct vmrt_vm_vcpu *vcpu, u8_t vector)
+{
+	if (vcpu->started) return;
+
+	vcpu->shared_region->sipi_vector  = vector;
+	vcpu->shared_region->sipi_pending = 1;
+	__atomic_store_n(&vcpu->started, 1, __ATOMIC_SEQ_CST);
+	sched_thd_wakeup(vcpu->handler_tid);
+}
+
 CWEAKSYMB void 
 rdmsr_handler(struct vmrt_vm_vcpu *vcpu)
 {
@@ -193,6 +330,15 @@ ept_misconfig_handler(struct vmrt_vm_vcpu *vcpu)
 CWEAKSYMB void 
 vmcall_handler(struct vmrt_vm_vcpu *vcpu)
 {
+	struct vm_vcpu_shared_region *regs = vcpu->shared_region;
+
+	if (regs->ax == VMRT_VMCALL_EXIT_STATS) {
+		vmrt_vm_exit_stats_dump(vcpu->vm);
+		regs->ax = 0;
+		GOTO_NEXT_INST(regs);
+		return;
+	}
+
 	VM_PANIC(vcpu);
 }
 
@@ -348,8 +494,7 @@ vmrt_handle_reason(struct vmrt_vm_vcpu *vcpu, u64_t reason)
 		cpuid_handler(vcpu);
 		break;
 	case VM_EXIT_REASON_HLT:
-		/* TODO: handle hlt exception */
-		VM_PANIC(vcpu);
+		vmrt_vcpu_halt(vcpu);
 		break;
 	case VM_EXIT_REASON_RDTSC:
 		VM_PANIC(vcpu);
@@ -370,7 +515,7 @@ vmrt_handle_reason(struct vmrt_vm_vcpu *vcpu, u64_t reason)
 		wrmsr_handler(vcpu);
 		break;
 	case VM_EXIT_REASON_PAUSE:
-		/* TODO: handle pause exception */
+		/* The vcpu spins on a lock (pause-loop exiting), held by a vcpu on another core */
 		GOTO_NEXT_INST(vcpu->shared_region);
 		break;
 	case VM_EXIT_REASON_EPT_MISCONFIG:
@@ -380,7 +525,7 @@ vmrt_handle_reason(struct vmrt_vm_vcpu *vcpu, u64_t reason)
 		VM_PANIC(vcpu);
 		break;
 	case VM_EXIT_REASON_PREEMPTION_TIMER:
-		VM_PANIC(vcpu);
+		/* The timer's deadline passed, its interrupt is injected below */
 		break;
 	case VM_EXIT_REASON_XSETBV:
 		xsetbv_handler(vcpu);
@@ -395,6 +540,71 @@ vmrt_handle_reason(struct vmrt_vm_vcpu *vcpu, u64_t reason)
 	}
 }
 
+static inline void
+vmrt_exit_stats_add(struct vmrt_vm_vcpu *vcpu, u64_t reason, cycles_t cycles)
+{
+	struct vmrt_exit_stat *stat;
+	int bucket;
+
+	if (unlikely(reason >= MAX_VM_EXIT_REASONS)) return;
+	stat = &vcpu->exit_stats->reasons[reason];
+
+	bucket = 63 - __builtin_clzll(cycles | 1);
+	if (bucket >= VMRT_EXIT_HIST_BUCKETS) bucket = VMRT_EXIT_HIST_BUCKETS - 1;
+
+	stat->samples[stat->count % VMRT_EXIT_SAMPLES] = cycles;
+	stat->hist[bucket]++;
+	stat->cycles += cycles;
+	if (cycles > stat->max) stat->max = cycles;
+	stat->count++;
+	vcpu->exit_stats->nexits++;
+}
+
+void
+vmrt_vcpu_exit_stats_dump(struct vmrt_vm_vcpu *vcpu)
+{
+	struct vmrt_vcpu_exit_stats *stats = vcpu->exit_stats;
+	cycles_t samples[VMRT_EXIT_SAMPLES];
+	struct perfdata pd;
+	u64_t reason, n, i;
+	int b;
+
+	printc("vcpu %u: %llu exits\n", vcpu->cpuid, stats->nexits);
+	for (reason = 0; reason < MAX_VM_EXIT_REASONS; reason++) {
+		struct vmrt_exit_stat *stat = &stats->reasons[reason];
+
+		if (!stat->count) continue;
+		printc("\treason %llu: %llu exits, %llu cycles (avg %llu, max %llu)\n",
+		       reason, stat->count, stat->cycles, stat->cycles / stat->count, stat->max);
+
+		/* The percentiles of the most recent exits */
+		n = stat->count < VMRT_EXIT_SAMPLES ? stat->count : VMRT_EXIT_SAMPLES;
+		if (n >= PERF_VAL_MIN_SZ) {
+			perfdata_init(&pd, "vm exit", samples, VMRT_EXIT_SAMPLES);
+			for (i = 0; i < n; i++) perfdata_add(&pd, stat->samples[i]);
+			perfdata_calc(&pd);
+			printc("\t\tlast %llu: min %llu, sd %llu, 90%% %llu, 95%% %llu, 99%% %llu\n", n,
+			       perfdata_min(&pd), perfdata_sd(&pd), perfdata_90ptile(&pd),
+			       perfdata_95ptile(&pd), perfdata_99ptile(&pd));
+		}
+
+		printc("\t\tlog2(cycles):");
+		for (b = 0; b < VMRT_EXIT_HIST_BUCKETS; b++) {
+			if (stat->hist[b]) printc(" %d:%u", b, stat->hist[b]);
+		}
+		printc("\n");
+	}
+}
+
+void
+vmrt_vm_exit_stats_dump(struct vmrt_vm_comp *vm)
+{
+	u8_t i;
+
+	printc("VM %s exit statistics:\n", vm->name);
+	for (i = 0; i < vm->num_vpu; i++) vmrt_vcpu_exit_stats_dump(&vm->vcpus[i]);
+}
+
 void
 vmrt_vm_vcpu_start(struct vmrt_vm_vcpu *vcpu)
 {
@@ -408,18 +618,31 @@ vmrt_vm_exception_handler(void *_vcpu)
 	struct vmrt_vm_vcpu *vcpu = (struct vmrt_vm_vcpu *)_vcpu;
 	struct vm_vcpu_shared_region *shared_region;
 	u64_t reason;
-	u64_t curr_tsc;
+	u64_t curr_tsc, exit_tsc;
 
 	shared_region = vcpu->shared_region;
+
+	/* Application processors wait for their startup IPI */
+	__atomic_store_n(&vcpu->halted, 1, __ATOMIC_SEQ_CST);
+	while (!__atomic_load_n(&vcpu->started, __ATOMIC_SEQ_CST)) sched_thd_block(0);
+	__atomic_store_n(&vcpu->halted, 0, __ATOMIC_SEQ_CST);
+
 	while (1)
 	{
+		vmrt_vcpu_intr_deliver(vcpu);
+		/* The kernel exits to us at the deadline (with the VMX-preemption timer) */
+		shared_region->timer_deadline = vcpu->next_timer == ~0ULL ? 0 : vcpu->next_timer;
 		vmrt_vm_vcpu_resume(vcpu);
 	
 		reason = shared_region->reason;
 
+		rdtscll(exit_tsc);
 		vmrt_handle_reason(vcpu, reason);
 		rdtscll(curr_tsc);
+		vmrt_exit_stats_add(vcpu, reason, curr_tsc - exit_tsc);
 		if (curr_tsc >= vcpu->next_timer) {
+			/* The TSC-deadline timer fires once */
+			vcpu->next_timer = ~0ULL;
 			/* 236 is Linux's fixed timer interrrupt */
 			lapic_intr_inject(vcpu, 236, 0);
 		}
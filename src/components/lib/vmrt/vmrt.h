@@ -6,6 +6,32 @@
 #define VMRT_VM_NAME_SIZE (32)
 #define VMRT_VM_MAX_VCPU (16)
 
+/* Buckets of the exit histograms: bucket i counts exits of [2^i, 2^(i+1)) cycles */
+#define VMRT_EXIT_HIST_BUCKETS (32)
+/* The most recent exits of each reason, kept for their percentiles */
+#define VMRT_EXIT_SAMPLES (32)
+/* A guest's vmcall with this in rax dumps the exit statistics */
+#define VMRT_VMCALL_EXIT_STATS (0x564d5254)
+
+struct vmrt_exit_stat {
+	u64_t count;
+	/* Cycles spent handling the exits, including the time blocked in halts */
+	u64_t cycles;
+	u64_t max;
+	u32_t hist[VMRT_EXIT_HIST_BUCKETS];
+	cycles_t samples[VMRT_EXIT_SAMPLES];
+};
+
+/*
+ * The statistics of a vcpu's exits, by reason. They are in shared
+ * memory (see vmrt_vm_comp's exit_stats_shm), and only written by the
+ * vcpu's handler thread.
+ */
+struct vmrt_vcpu_exit_stats {
+	u64_t nexits;
+	struct vmrt_exit_stat reasons[MAX_VM_EXIT_REASONS];
+};
+
 struct vmrt_vm_vcpu {
 	struct vm_vcpu_shared_region *shared_region;
 	u64_t next_timer;
@@ -24,6 +50,13 @@ struct vmrt_vm_vcpu {
 	u8_t coreid;
 	struct vmrt_vm_comp *vm;
 	u64_t pending_req;
+	/* Vectors injected by other threads, delivered on the next resume */
+	u64_t pending_intr[4];
+	/* Set while the vcpu is halted (or waits for a startup IPI), so must be woken */
+	int halted;
+	int started;
+	/* How long a halted vcpu polls for interrupts before blocking */
+	cycles_t halt_poll;
 
 	u16_t vpid;
 	vm_vmcscap_t vmcs_cap;
@@ -33,6 +66,7 @@ struct vmrt_vm_vcpu {
 	vm_lapicaccesscap_t lapic_access_cap;
 	vm_vmcb_t vmcb_cap;
 	thdid_t handler_tid;
+	struct vmrt_vcpu_exit_stats *exit_stats;
 };
 
 struct vmrt_vm_comp {
@@ -46,6 +80,8 @@ struct vmrt_vm_comp {
 
 	u8_t num_vpu;
 	struct vmrt_vm_vcpu vcpus[VMRT_VM_MAX_VCPU];
+	/* Shared memory of the vcpus' exit statistics, an array of vmrt_vcpu_exit_stats */
+	cbuf_t exit_stats_shm;
 
 	int wire_mode;
 };
@@ -64,6 +100,12 @@ void vmrt_vm_exception_handler(void *vcpu);
 void vmrt_vm_vcpu_start(struct vmrt_vm_vcpu *vcpu);
 static inline struct vmrt_vm_vcpu *vmrt_get_vcpu(struct vmrt_vm_comp *vm, u32_t vcpu_nr) { return &vm->vcpus[vcpu_nr]; }
 
+void vmrt_vcpu_intr_post(struct vmrt_vm_vcpu *vcpu, u8_t vector);
+void vmrt_vcpu_startup(struct vmrt_vm_vcpu *vcpu, u8_t vector);
+
+void vmrt_vcpu_exit_stats_dump(struct vmrt_vm_vcpu *vcpu);
+void vmrt_vm_exit_stats_dump(struct vmrt_vm_comp *vm);
+
 void lapic_intr_inject(struct vmrt_vm_vcpu *vcpu, u8_t vector, int autoeoi);
 
 #define INCBIN(name, file) \
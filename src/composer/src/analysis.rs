@@ -1,4 +1,5 @@
 use ascent::{ascent_run, lattice::Dual};
+use cossystem::ConstantVal;
 use passes::{AnalysisPass, VirtResPass, BuildState, ComponentId, Interface, SystemState, Transition, component, ComponentName};
 use std::collections::HashMap;
 use std::collections::HashSet;
@@ -111,6 +112,10 @@ pub struct AnalysisInput {
 
     unbound_threads: Vec<(ComponentId, bool)>,
 
+    // The number of blockpoints each component allocates from its
+    // scheduler, for the components that declare it.
+    local_bound_blkpts: Vec<(ComponentId, usize)>,
+
     // Virtual resources, and the server that provides them.
     virt_res_service: Vec<(VirtResource, ComponentId)>,
     // The access of clients to specific virtual resources
@@ -138,8 +143,18 @@ pub struct Analysis {
     // client.
     comp_nested_lock: Vec<(ComponentId, ComponentId)>,
 
-    //
+    // The number of threads that can execute in (and thus need a
+    // stack in) each component: its own, and those of its clients.
+    // Components with clients of unbounded threads are omitted.
     comp_stack_num_bound: Vec<(ComponentId, usize)>,
+    // The number of threads in the system, if all are bounded, and
+    // none are allocated dynamically. Thread ids are allocated from a
+    // global namespace, and never reused, so this also bounds the
+    // thread ids.
+    sys_thread_bound: Option<usize>,
+    // The number of blockpoints a scheduler must provide to its
+    // clients, if they all declare their blockpoints.
+    comp_blkpt_bound: Vec<(ComponentId, usize)>,
     // The maximum number of necessary threads for a component
     //thread_limit: Vec<(ComponentId, usize)>,
     // What is the limit on the number of static virtual resources in
@@ -175,6 +190,7 @@ fn analysis_output(i: AnalysisInput) -> Analysis {
         assurance,
         local_bound_threads,
         unbound_threads,
+        local_bound_blkpts,
         virt_res_service,
         virt_res_access,
         ..
@@ -199,7 +215,7 @@ fn analysis_output(i: AnalysisInput) -> Analysis {
         lattice comp_crit_hi(ComponentId, CriticalityLvl);
         lattice comp_crit_lo(ComponentId, Dual<CriticalityLvl>);
         relation num_client_threads(ComponentId, ComponentId, usize);
-        relation set_client_threads(ComponentId, usize);
+        relation comp_threads_unbounded(ComponentId);
         // outputs
         relation depends_on(ComponentId, ComponentId);
         relation comp_properties(ComponentId, CompProperties);
@@ -209,7 +225,6 @@ fn analysis_output(i: AnalysisInput) -> Analysis {
         relation comp_shared_lock(ComponentId, ComponentId);
         relation comp_nested_lock(ComponentId, ComponentId);
         relation show_warnings(ComponentId);
-        relation comp_stack_num_bound(ComponentId, usize);
 
         // The main output
         relation warnings(ComponentId, Warning);
@@ -218,12 +233,12 @@ fn analysis_output(i: AnalysisInput) -> Analysis {
         depends_on(c, s) <-- dependencies(c, s, _, _);
         depends_on(c, ss) <-- depends_on(c, s), dependencies(s, ss, _, _);
         
-        // Threads Caculation
-        //temp_num_client_threads(s, n) <-- depends_on(c, s), comp_thread_num_bound(c, n);
+        // Threads Caculation: the threads of all (transitive) clients
+        // can execute in a server, so a server is only bounded if
+        // all of its clients are.
         num_client_threads(s, c, n) <-- depends_on(c, s), comp_thread_num_bound(c, n);
-        //(s, sum(n)) <-- depends_on(c, s), comp_thread_num_bound(c, n);
-        //num_client_threads(s, sum(total)) <-- depends_on(c, s), comp_thread_num_bound(c, n), agg total = sum(n) in comp_thread_num_bound(c, n);
-        //comp_stack_num_bound(c, Dual(*cn + sn)) <-- num_client_threads(c, cn), comp_thread_num_bound(c, sn), !comp_thread_num_unbounded(c,true);
+        comp_threads_unbounded(c) <-- comp_thread_num_unbounded(c, true);
+        comp_threads_unbounded(s) <-- depends_on(c, s), comp_thread_num_unbounded(c, true);
 
         //hard-coded assign constructor properties to booter,logic is realted to tot_order.rs
         comp_properties(1, CompProperties::Constructor);       
@@ -291,9 +306,6 @@ fn analysis_output(i: AnalysisInput) -> Analysis {
 
     println!("show_warnings: {:?}", p.show_warnings.iter().collect::<Vec<_>>());
 
-    let threads_per_component: Vec<_> = p.comp_stack_num_bound.iter().collect();
-    println!("threads per component: {:?}", threads_per_component);
-
     let lock_data: Vec<_> = p.comp_shared_lock.iter().collect();
     println!("shared lock: {:?}", lock_data);
 
@@ -342,6 +354,44 @@ fn analysis_output(i: AnalysisInput) -> Analysis {
     
     println!("comp_thds (ordered by ComponentId) {:?}:", comp_thds_sorted);
 
+    let comp_stack_num_bound: Vec<(ComponentId, usize)> = comp_thds_sorted
+        .iter()
+        .filter(|(id, _)| !p.comp_threads_unbounded.contains(&(**id,)))
+        .map(|(id, n)| (**id, **n))
+        .collect();
+    println!("threads per component: {:?}", comp_stack_num_bound);
+
+    let sys_thread_bound: Option<usize> = if p.comp_threads_unbounded.is_empty() {
+        Some(p.comp_thread_num_bound.iter().map(|(_, n)| n).sum())
+    } else {
+        None
+    };
+
+    // Blockpoints are allocated by the direct clients of a
+    // scheduler, so they bound its blockpoints if each declares its
+    // own.
+    let mut comp_blkpt_bound: Vec<(ComponentId, usize)> = Vec::new();
+    for (_, s, iface, _) in p.dependencies.iter() {
+        if iface != "sched" || comp_blkpt_bound.iter().any(|(id, _)| id == s) {
+            continue;
+        }
+        let clients: HashSet<ComponentId> = p.dependencies
+            .iter()
+            .filter(|(_, s2, i2, _)| s2 == s && i2 == "sched")
+            .map(|(c2, _, _, _)| *c2)
+            .collect();
+        let blkpts: Option<usize> = clients
+            .iter()
+            .map(|c2| local_bound_blkpts.iter().find(|(id, _)| id == c2).map(|(_, n)| *n))
+            .sum();
+        if let Some(n) = blkpts {
+            comp_blkpt_bound.push((*s, std::cmp::max(n, 1)));
+        } else {
+            println!("Scheduler {} has clients without LOCAL_BOUND_BLKPTS; keeping the default blockpoint count.", s);
+        }
+    }
+    comp_blkpt_bound.sort();
+
 
     Analysis {
         depends_on: p.depends_on,
@@ -351,7 +401,9 @@ fn analysis_output(i: AnalysisInput) -> Analysis {
         comp_dos: p.comp_dos,
         comp_shared_lock: p.comp_shared_lock,
         comp_nested_lock: p.comp_nested_lock,
-        comp_stack_num_bound: p.comp_stack_num_bound,
+        comp_stack_num_bound,
+        sys_thread_bound,
+        comp_blkpt_bound,
         warnings: p.warnings,
         pub_warnings: ws,
     }
@@ -536,23 +588,50 @@ impl Analysis {
             (id.clone(), max_local_threads)
         }).collect();
         
-
+        // Clients of the scheduler can create threads. Unless they
+        // declare how many (through LOCAL_BOUND_THREADS, or a sched
+        // virtual resource), their thread count is unbounded.
         let unbound_threads: Vec<(ComponentId, bool)> = components.iter().map(|id| {
-            (id.clone(), false)            
+            let c = component(&s, id);
+            let creates_thds = cs.deps_named(&c.name).iter().any(|d| d.interface == "sched" && d.variant != "kernel");
+            let declared = c.constants.iter().any(|k| k.variable == "LOCAL_BOUND_THREADS")
+                || c.virt_res.iter().any(|vr| vr.vr_type == "sched");
+
+            (id.clone(), creates_thds && !declared)
+        }).collect();
+
+        let local_bound_blkpts: Vec<(ComponentId, usize)> = components.iter().filter_map(|id| {
+            component(&s, id).constants.iter()
+                .find(|k| k.variable == "LOCAL_BOUND_BLKPTS")
+                .and_then(|k| k.value.parse::<usize>().ok())
+                .map(|n| (id.clone(), n))
         }).collect();
 
+        // Threads of a sched virtual resource are allocated (and
+        // deleted) dynamically. Thread ids are never reused, so then
+        // the ids aren't bounded by the number of threads.
+        let dynamic_threads = components.iter().any(|id| {
+            component(&s, id).virt_res.iter().any(|vr| vr.vr_type == "sched")
+        });
+
         // Calculate the analysis outputs
-        analysis_output(AnalysisInput {
+        let mut a = analysis_output(AnalysisInput {
             components,
             dependencies: full_dependencies,
             criticalities,
             assurance,
             local_bound_threads,
             unbound_threads,
+            local_bound_blkpts,
             // TODO
             virt_res_service,
             virt_res_access,
-        })
+        });
+        if dynamic_threads {
+            a.sys_thread_bound = None;
+        }
+
+        a
     }
 }
 
@@ -561,6 +640,35 @@ impl AnalysisPass for Analysis {
         &self.pub_warnings
     }
 
+    // The bounds are per core (each component has an initial thread
+    // on each core), so they are scaled by NUM_CPU in the component.
+    fn constants(&self, id: ComponentId, s: &SystemState) -> Vec<ConstantVal> {
+        let c = component(&s, &id);
+        let mut consts = Vec::new();
+        let mut add = |variable: &str, value: String| {
+            // Constants set explicitly in the sysspec take precedence.
+            if !c.constants.iter().any(|k| k.variable == variable) {
+                consts.push(ConstantVal { variable: variable.to_string(), value });
+            }
+        };
+
+        if let Some((_, n)) = self.comp_stack_num_bound.iter().find(|(cid, _)| *cid == id) {
+            add("COMP_MAX_THREADS", format!("({} * NUM_CPU)", n));
+            add("MAX_LOCAL_NUM_THREADS", String::from("COMP_MAX_THREADS"));
+        }
+        if let Some(n) = self.sys_thread_bound {
+            // The capability manager allocates thread ids above those
+            // of the booter's threads, from NUM_CPU * 4 (see the
+            // __thdid_alloc in capmgr's cos_init).
+            add("COS_SYS_MAX_THREADS", format!("(NUM_CPU * 4 + {} * NUM_CPU + 1)", n));
+        }
+        if let Some((_, n)) = self.comp_blkpt_bound.iter().find(|(cid, _)| *cid == id) {
+            add("NBLKPTS", n.to_string());
+        }
+
+        consts
+    }
+
     fn warning_str(&self, id: ComponentId, s: &SystemState) -> String {
         let ids = s.get_named();
         let name = |id| ids.ids().get(&id).unwrap();
@@ -1,10 +1,13 @@
 use initargs::ArgsKV;
 use cossystem::ConstantVal;
 use passes::{component, deps, exports, AddrSpcName, BuildState, ComponentId, SystemState};
+use std::cell::RefCell;
+use std::collections::{BTreeSet, HashMap};
 use std::env;
 use std::fs::File;
-use syshelpers::{dir_exists, emit_file, exec_pipeline, reset_dir};
-use tar::Builder;
+use std::fs;
+use syshelpers::{dir_exists, emit_file, exec_pipeline, exec_pipelines_parallel, reset_dir, Digest};
+use tar::{Archive, Builder};
 
 // Interact with the composite build system to "seal" the components.
 // This requires linking them with all dependencies, and with libc,
@@ -75,6 +78,23 @@ fn tarball_create(
     Ok(())
 }
 
+// The path of each record in the tarball, and its offset, so that the
+// initargs index (see initargs.rs) can refer to it directly.
+// Directories are indexed without their trailing '/'.
+fn tarball_index(tar_path: &String) -> Result<Vec<(String, u64)>, String> {
+    let file = File::open(&tar_path).map_err(|e| format!("Could not open tarball {}: {}", tar_path, e))?;
+    let mut ar = Archive::new(file);
+    let mut ents = Vec::new();
+
+    for e in ar.entries().map_err(|e| format!("Could not read tarball {}: {}", tar_path, e))? {
+        let e = e.map_err(|e| format!("Could not read tarball {}: {}", tar_path, e))?;
+        let path = String::from_utf8_lossy(&e.path_bytes()).trim_end_matches('/').to_string();
+        ents.push((path, e.raw_header_position()));
+    }
+
+    Ok(ents)
+}
+
 fn constructor_tarball_create(
     id: &ComponentId,
     s: &SystemState,
@@ -113,6 +133,7 @@ fn constructor_serialize_args(
     id: &ComponentId,
     s: &SystemState,
     b: &dyn BuildState,
+    tarfile: &Option<String>,
 ) -> Result<String, String> {
     let mut sinvs = Vec::new();
 
@@ -250,8 +271,12 @@ fn constructor_serialize_args(
         .iter()
         .for_each(|a| topkv.push(a.clone()));
 
+    let tar_index = match tarfile {
+        Some(ref t) => tarball_index(t)?,
+        None => Vec::new(),
+    };
     let top = ArgsKV::new_top(topkv);
-    let args = top.serialize();
+    let args = top.serialize_indexed(&tar_index);
 
     let args_file_path = b.comp_file_path(&id, &"initargs_constructor.c".to_string(), &s)?;
     emit_file(&args_file_path, args.as_bytes()).unwrap();
@@ -337,9 +362,209 @@ fn kern_gen_make_cmd(input_constructor: &String, kern_output: &String, _s: &Syst
     )
 }
 
+// The number of component compilations to run concurrently. This
+// can be overridden with the COS_COMPOSE_JOBS environment variable,
+// and defaults to the number of cores.
+fn build_jobs() -> usize {
+    if let Ok(n) = env::var("COS_COMPOSE_JOBS") {
+        if let Ok(n) = n.parse::<usize>() {
+            if n > 0 {
+                return n;
+            }
+        }
+        println!("Ignoring invalid COS_COMPOSE_JOBS={}; expected a positive integer.", n);
+    }
+
+    std::thread::available_parallelism()
+        .map(|n| n.get())
+        .unwrap_or(1)
+}
+
+// Component objects are cached across compositions (and across
+// sysspecs) in a content-addressed directory. The key of each object
+// is a digest of
+//
+// 1. the inputs shared by all components: the kernel's shared
+//    headers, libc, and the build rules and linker scripts;
+// 2. the make command line with the build directory removed (thus the
+//    interfaces, dependencies, base address, etc...);
+// 3. the generated initargs, initargs tarball, and
+//    component_constants.h;
+// 4. the sources of the component's implementation; and
+// 5. the headers, objects, and libraries of the libraries and
+//    interfaces in the transitive closure of the component's
+//    dependencies (see `cache_deps`), so that changes to others don't
+//    invalidate its object.
+//
+// If a component's key is cached, its object is copied out of the
+// cache rather than compiled. COS_COMPOSE_NOCACHE disables the cache,
+// and the cache directory can be removed at any time. The cache keeps
+// the COS_COMPOSE_CACHE_MAX (default 512) most recently used objects.
+struct BuildCache {
+    dir: String,
+    comps: String,
+    shared: Digest,
+    // The digests of the library and interface directories, as they
+    // are shared by many components
+    dirs: RefCell<HashMap<String, String>>,
+}
+
+fn cache_src_file(f: &str) -> bool {
+    !(f.ends_with(".o") || f.ends_with(".d") || f.ends_with(".a") || f.ends_with("~"))
+}
+
+fn cache_shared_file(f: &str) -> bool {
+    f.ends_with(".h") || f.ends_with(".o") || f.ends_with(".a") || f.ends_with(".ld")
+}
+
+const CACHE_DEFAULT_MAX: usize = 512;
+
+// The LIBRARY_DEPENDENCIES, and the INTERFACE_DEPENDENCIES and
+// INTERFACE_EXPORTS of a Makefile, parsed as
+// cidl/calculate_dependencies.py does. A missing Makefile has none.
+fn makefile_deps(dir: &String) -> (Vec<String>, Vec<String>) {
+    let mut libs = Vec::new();
+    let mut ifs = Vec::new();
+    let contents = match fs::read_to_string(format!("{}/Makefile", dir)) {
+        Ok(c) => c,
+        Err(_) => return (libs, ifs),
+    };
+    for line in contents.lines() {
+        let data: Vec<&str> = line.split('#').next().unwrap_or("").split('=').collect();
+        if data.len() != 2 {
+            continue;
+        }
+        let lst = data[1].split_whitespace().map(|s| s.to_string());
+        match data[0].trim() {
+            "LIBRARY_DEPENDENCIES" => libs = lst.collect(),
+            "INTERFACE_DEPENDENCIES" | "INTERFACE_EXPORTS" => ifs.extend(lst),
+            _ => (),
+        }
+    }
+    (libs, ifs)
+}
+
+// The transitive closure of the libraries and interfaces that the
+// Makefiles in `dirs`, and the interfaces `ifs` rely on. Libraries
+// bring in their own dependencies (from lib/<lib>/Makefile), as do
+// interfaces (from interface/<if>/Makefile).
+fn cache_deps(comps: &String, dirs: &Vec<String>, ifs: Vec<String>) -> (BTreeSet<String>, BTreeSet<String>) {
+    let mut libs = BTreeSet::new();
+    let mut ifaces = BTreeSet::new();
+    let mut lib_pending = Vec::new();
+    let mut if_pending = ifs;
+
+    for d in dirs.iter() {
+        let (ls, is) = makefile_deps(d);
+        lib_pending.extend(ls);
+        if_pending.extend(is);
+    }
+    loop {
+        let (ls, is) = if let Some(l) = lib_pending.pop() {
+            if !libs.insert(l.clone()) {
+                continue;
+            }
+            makefile_deps(&format!("{}/lib/{}", comps, l))
+        } else if let Some(i) = if_pending.pop() {
+            if !ifaces.insert(i.clone()) {
+                continue;
+            }
+            makefile_deps(&format!("{}/interface/{}", comps, i))
+        } else {
+            break;
+        };
+        lib_pending.extend(ls);
+        if_pending.extend(is);
+    }
+
+    (libs, ifaces)
+}
+
+// Remove the least recently used objects beyond the cache's bound.
+// Objects are touched when they are reused (see cache_fetch), so their
+// modification time is the time of their last use.
+fn cache_evict(dir: &String) {
+    let max = env::var("COS_COMPOSE_CACHE_MAX")
+        .ok()
+        .and_then(|n| n.parse::<usize>().ok())
+        .unwrap_or(CACHE_DEFAULT_MAX);
+    let entries = match fs::read_dir(&dir) {
+        Ok(es) => es,
+        Err(_) => return,
+    };
+    let mut objs: Vec<(std::time::SystemTime, std::path::PathBuf)> = entries
+        .filter_map(|e| e.ok())
+        .filter_map(|e| {
+            let m = e.metadata().ok()?;
+            let t = m.modified().ok()?;
+            if m.is_file() {
+                Some((t, e.path()))
+            } else {
+                None
+            }
+        })
+        .collect();
+    if objs.len() <= max {
+        return;
+    }
+    objs.sort();
+    let nevict = objs.len() - max;
+    objs.iter().take(nevict).for_each(|(_, p)| {
+        let _ = fs::remove_file(&p);
+    });
+}
+
+fn cache_init(pwd: &String) -> Result<Option<BuildCache>, String> {
+    if env::var("COS_COMPOSE_NOCACHE").is_ok() {
+        return Ok(None);
+    }
+    let dir = format!("{}/system_binaries/cos_build_cache", pwd);
+    if !dir_exists(&dir) {
+        fs::create_dir_all(&dir).map_err(|e| format!("Could not create {}: {}", dir, e))?;
+    }
+
+    cache_evict(&dir);
+
+    let comps = format!("{}/src/components", pwd);
+    let mut shared = Digest::new();
+    shared.update_dir(&format!("{}/lib/libc", comps), true, cache_shared_file)?;
+    shared.update_dir(&format!("{}/src/kernel/include", pwd), true, cache_shared_file)?;
+    shared.update_dir(&comps, false, |f| f.contains("Makefile"))?;
+    shared.update_dir(&format!("{}/lib", comps), false, |f| f.contains("Makefile"))?;
+    shared.update_dir(&format!("{}/interface", comps), false, |f| f.contains("Makefile"))?;
+    shared.update_dir(&format!("{}/implementation", comps), false, |f| {
+        f.contains("Makefile") || f.ends_with(".ld")
+    })?;
+
+    Ok(Some(BuildCache {
+        dir,
+        comps,
+        shared,
+        dirs: RefCell::new(HashMap::new()),
+    }))
+}
+
+impl BuildCache {
+    // Add the digest of a library or interface directory to `d`.
+    fn update_dep_dir(&self, d: &mut Digest, dir: String) -> Result<(), String> {
+        if let Some(h) = self.dirs.borrow().get(&dir) {
+            d.update(h.as_bytes());
+            return Ok(());
+        }
+        let mut dd = Digest::new();
+        dd.update(dir.as_bytes());
+        dd.update_dir(&format!("{}/{}", self.comps, dir), true, cache_shared_file)?;
+        d.update(dd.hex().as_bytes());
+        self.dirs.borrow_mut().insert(dir, dd.hex());
+        Ok(())
+    }
+}
+
 pub struct DefaultBuilder {
     builddir: String,
     rebuildflag: bool,
+    jobs: usize,
+    cache: Option<BuildCache>,
 }
 
 impl DefaultBuilder {
@@ -347,8 +572,143 @@ impl DefaultBuilder {
         DefaultBuilder {
             builddir: "/dev/null".to_string(), // must initialize, so error out if you don't
             rebuildflag: false,
+            jobs: build_jobs(),
+            cache: None,
         }
     }
+
+    // The cache key for the component's object, or None if the cache
+    // is disabled.
+    fn cache_key(
+        &self,
+        id: &ComponentId,
+        cmd: &String,
+        state: &SystemState,
+    ) -> Result<Option<String>, String> {
+        let cache = match self.cache {
+            Some(ref c) => c,
+            None => return Ok(None),
+        };
+        let p = state.get_param_id(&id);
+        let c = component(&state, &id);
+        let decomp: Vec<&str> = c.source.split(".").collect();
+        let impl_dir = format!("src/components/implementation/{}", decomp[0]);
+        let ifs = exports(&state, &id)
+            .iter()
+            .map(|e| e.interface.clone())
+            .chain(deps(&state, &id).iter().map(|d| d.interface.clone()))
+            .collect();
+        let (libs, ifaces) = cache_deps(
+            &cache.comps,
+            &vec![
+                format!("{}/implementation/{}", cache.comps, decomp[0]),
+                format!("{}/implementation/{}/{}", cache.comps, decomp[0], decomp[1]),
+            ],
+            ifs,
+        );
+
+        let mut d = cache.shared.clone();
+        for l in libs.into_iter() {
+            cache.update_dep_dir(&mut d, format!("lib/{}", l))?;
+        }
+        for i in ifaces.into_iter() {
+            cache.update_dep_dir(&mut d, format!("interface/{}", i))?;
+        }
+        d.update(cmd.replace(&self.builddir, "").as_bytes());
+        d.update_file(p.param_prog())?;
+        if let Some(tar) = p.param_fs() {
+            d.update_file(&tar)?;
+        }
+        d.update_file(&self.comp_file_path(&id, &"component_constants.h".to_string(), &state)?)?;
+        d.update_dir(&impl_dir, false, cache_src_file)?;
+        d.update_dir(&format!("{}/{}", impl_dir, decomp[1]), true, cache_src_file)?;
+
+        Ok(Some(format!("{}/{}-{}", cache.dir, d.hex(), self.comp_obj_file(&id, &state))))
+    }
+
+    // Copy a cached object to the output path, returning if it was cached.
+    fn cache_fetch(&self, key: &String, output_path: &String) -> bool {
+        if fs::copy(&key, &output_path).is_err() {
+            return false;
+        }
+        // Mark the object as recently used, for cache_evict
+        if let Ok(f) = File::options().write(true).open(&key) {
+            let _ = f.set_modified(std::time::SystemTime::now());
+        }
+        true
+    }
+
+    // Add a freshly compiled object into the cache. The copy is
+    // renamed into place so that concurrent compositions never see a
+    // partial object.
+    fn cache_store(&self, key: &String, output_path: &String) {
+        let tmp = format!("{}.tmp{}", key, std::process::id());
+        if fs::copy(&output_path, &tmp).is_ok() {
+            if fs::rename(&tmp, &key).is_err() {
+                let _ = fs::remove_file(&tmp);
+            }
+        }
+    }
+
+    // Generate the make command to build component `id`, returning
+    // it along with the path of the resulting object, and the
+    // compilation log.
+    fn comp_build_cmd(
+        &self,
+        id: &ComponentId,
+        state: &SystemState,
+    ) -> Result<(String, String, String), String> {
+        let comp_dir = self.comp_dir_path(&id, &state)?;
+        compdir_check_build(&comp_dir)?;
+        let p = state.get_param_id(&id);
+        let output_path = self.comp_obj_path(&id, &state)?;
+        let comp_log = self.comp_file_path(&id, &"compilation.log".to_string(), &state)?;
+        let header_file_path =
+            self.comp_file_path(&id, &"component_constants.h".to_string(), &state)?;
+
+        let cmd = comp_gen_make_cmd(
+            &output_path,
+            p.param_prog(),
+            p.param_fs(),
+            &Some(header_file_path.clone()),
+            CmdOpts::REGULAR,
+            &id,
+            &state,
+        );
+
+        let name = state.get_named().ids().get(id).unwrap();
+        println!(
+            "Compiling component {} with the following command line:\n\t{}",
+            name, cmd
+        );
+
+        Ok((cmd, output_path, comp_log))
+    }
+}
+
+fn comp_build_log(
+    cmd: &String,
+    output_path: &String,
+    comp_log: &String,
+    out: &String,
+    err: &String,
+) -> Result<(), String> {
+    emit_file(
+        &comp_log,
+        format!(
+            "Command: {}\nCompilation output:{}\nComponent compilation errors:{}",
+            cmd, out, err
+        )
+        .as_bytes(),
+    )?;
+    if err.len() != 0 {
+        println!(
+            "Errors in compiling component {}. See {}.",
+            &output_path, comp_log
+        );
+    }
+
+    Ok(())
 }
 
 fn compdir_check_build(comp_dir: &String) -> Result<(), String> {
@@ -373,6 +733,7 @@ impl BuildState for DefaultBuilder {
         reset_dir(&dir)?;
         self.builddir = dir;
         self.rebuildflag = is_rebuild;
+        self.cache = cache_init(&format!("{}", pwd.display()))?;
 
         Ok(())
     }
@@ -411,12 +772,19 @@ impl BuildState for DefaultBuilder {
         self.comp_file_path(&c, &self.comp_obj_file(&c, &s), &s)
     }
 
-    fn comp_init_header_file(&self, header_file_path: &String) {
-        // Initialize the header content with include guards
-        let header_content = String::from(
-            "#ifndef COMPONENT_CONSTANTS_H\n#define COMPONENT_CONSTANTS_H\n\n#endif /* COMPONENT_CONSTANTS_H */\n",
-        );
-    
+    fn comp_init_header_file(&self, header_file_path: &String, constants: &Vec<ConstantVal>) {
+        // Initialize the header content with include guards, and the
+        // constants derived by the composer
+        let mut header_content =
+            String::from("#ifndef COMPONENT_CONSTANTS_H\n#define COMPONENT_CONSTANTS_H\n\n");
+        for constant in constants {
+            header_content.push_str(&format!(
+                "#define {} {}\n",
+                constant.variable, constant.value
+            ));
+        }
+        header_content.push_str("\n#endif /* COMPONENT_CONSTANTS_H */\n");
+
         emit_file(&header_file_path, header_content.as_bytes()).unwrap();
     }
 
@@ -510,47 +878,69 @@ impl BuildState for DefaultBuilder {
         }
         //rebuild process ends
 
-        let cmd = comp_gen_make_cmd(
-            &output_path,
-            p.param_prog(),
-            p.param_fs(),
-            &Some(header_file_path.clone()),
-            CmdOpts::REGULAR,
-            &id,
-            &state,
-        );
-
-        let name = state.get_named().ids().get(id).unwrap();
-        println!(
-            "Compiling component {} with the following command line:\n\t{}",
-            name, cmd
-        );
+        let (cmd, output_path, comp_log) = self.comp_build_cmd(&id, &state)?;
         let (out3, err3) = exec_pipeline(vec![cmd.clone()]);
-        emit_file(
-            &comp_log,
-            format!(
-                "Command: {}\nCompilation output:{}\nComponent compilation errors:{}",
-                cmd, out3, err3
-            )
-            .as_bytes(),
-        )?;
-        if err3.len() != 0 {
-            println!(
-                "Errors in compiling component {}. See {}.",
-                &output_path, comp_log
-            );
-        }
+        comp_build_log(&cmd, &output_path, &comp_log, &out3, &err3)?;
 
         Ok(output_path)
     }
 
+    fn comp_build_all(
+        &self,
+        ids: &Vec<ComponentId>,
+        state: &SystemState,
+    ) -> Result<Vec<String>, String> {
+        // Rebuilds recompile the libraries and interfaces shared
+        // between components, so they can neither proceed
+        // concurrently, nor use the cache.
+        if self.rebuildflag {
+            return ids.iter().map(|id| self.comp_build(&id, &state)).collect();
+        }
+
+        let mut jobs = Vec::new();
+        let mut builds = Vec::new();
+        let mut paths = Vec::new();
+        for id in ids.iter() {
+            let (cmd, output_path, comp_log) = self.comp_build_cmd(&id, &state)?;
+            let key = self.cache_key(&id, &cmd, &state)?;
+
+            paths.push(output_path.clone());
+            if let Some(ref k) = key {
+                if self.cache_fetch(&k, &output_path) {
+                    println!("\tUp to date; reusing cached object {}", k);
+                    emit_file(&comp_log, format!("Command: {}\nReused cached object: {}\n", cmd, k).as_bytes())?;
+                    continue;
+                }
+            }
+
+            // Components are compiled within their implementation's
+            // directory, so builds of the same implementation must be
+            // serialized.
+            jobs.push((component(&state, &id).source.clone(), vec![cmd.clone()]));
+            builds.push((cmd, output_path, comp_log, key));
+        }
+
+        let outputs = exec_pipelines_parallel(jobs, self.jobs);
+        for ((cmd, output_path, comp_log, key), (out, err, ok)) in builds.into_iter().zip(outputs.into_iter()) {
+            comp_build_log(&cmd, &output_path, &comp_log, &out, &err)?;
+            // Only objects from successful builds are cached
+            if let Some(k) = key {
+                if ok {
+                    self.cache_store(&k, &output_path);
+                }
+            }
+        }
+
+        Ok(paths)
+    }
+
     fn constructor_build(&self, c: &ComponentId, s: &SystemState) -> Result<String, String> {
         let comp_dir = self.comp_dir_path(&c, &s)?;
         compdir_check_build(&comp_dir)?;
 
         let binary = self.comp_obj_path(&c, &s)?;
-        let argsfile = constructor_serialize_args(&c, &s, self)?;
         let tarfile = constructor_tarball_create(&c, &s, self)?;
+        let argsfile = constructor_serialize_args(&c, &s, self, &tarfile)?;
 
         let header_file_path = self.comp_file_path(&c, &"component_constants.h".to_string(), &s)?;
 
@@ -322,6 +322,19 @@ fn compute_elfobj(
     }))
 }
 
+impl ElfObject {
+    // Create the object pass from a component that has already been
+    // built (e.g. by `comp_build_all`).
+    pub fn from_obj(
+        id: &ComponentId,
+        obj_path: &String,
+        s: &SystemState,
+        b: &mut dyn BuildState,
+    ) -> Result<Box<Self>, String> {
+        compute_elfobj(&id, &obj_path, &s, b)
+    }
+}
+
 impl TransitionIter for ElfObject {
     fn transition_iter(
         id: &ComponentId,
@@ -1,4 +1,5 @@
 use std::collections::{HashMap, HashSet};
+use std::fmt::Write;
 use syshelpers::dump_file;
 use toml;
 use toml::Value;
@@ -71,7 +72,8 @@ pub struct TomlComponent {
     constants: Option<Vec<ConstantVal>>,
     implements: Option<Vec<InterfaceVariant>>,
     initfs: Option<String>,
-    constructor: String, // the booter
+    cores: Option<Vec<usize>>, // cores the component's threads run on (default: all)
+    constructor: String,       // the booter
 }
 
 #[derive(Debug, Deserialize)]
@@ -169,6 +171,23 @@ impl TomlComponent {
     }
 }
 
+// The number of cores the kernel is configured for, or None if the
+// platform has not been configured (`cos init`) yet. This mirrors
+// NUM_CPU_KERNEL in the platform's cos_config.h.
+fn platform_num_cpus() -> Option<usize> {
+    let plat = String::from_utf8(dump_file(&String::from("src/.PLATFORM_ID")).ok()?).ok()?;
+    let config = format!("src/platform/{}/chal/shared/cos_config.h", plat.trim());
+    let contents = String::from_utf8(dump_file(&config).ok()?).ok()?;
+
+    contents.lines().find_map(|l| {
+        let mut toks = l.split_whitespace();
+        match (toks.next(), toks.next(), toks.next()) {
+            (Some("#define"), Some("NUM_CPU_KERNEL"), Some(n)) => n.parse().ok(),
+            _ => None,
+        }
+    })
+}
+
 impl TomlSpecification {
     fn comp(&self, cname: String) -> Option<&TomlComponent> {
         self.comps().iter().find(|c| c.name == cname)
@@ -414,6 +433,39 @@ impl TomlSpecification {
             }
         }
 
+        // Core placement: the core set must be non-empty, without
+        // duplicates, and within the cores the kernel is configured
+        // for.
+        let ncpus = platform_num_cpus();
+        for c in self.comps() {
+            if let Some(ref cores) = c.cores {
+                if cores.is_empty() {
+                    let _ = writeln!(
+                        err_accum,
+                        "Error: Component {} has an empty list of cores; omit \"cores\" to run on all cores.",
+                        c.name
+                    );
+                    fail = true;
+                }
+                for (i, core) in cores.iter().enumerate() {
+                    if cores[..i].contains(core) {
+                        let _ = writeln!(err_accum, "Error: Component {} lists core {} multiple times.", c.name, core);
+                        fail = true;
+                    }
+                    if let Some(n) = ncpus {
+                        if *core >= n {
+                            let _ = writeln!(
+                                err_accum,
+                                "Error: Component {} is placed on core {}, but the kernel is configured for {} cores (NUM_CPU_KERNEL).",
+                                c.name, core, n
+                            );
+                            fail = true;
+                        }
+                    }
+                }
+            }
+        }
+
         if let Some(ref vr_list) = self.virt_resources {
             for vr in vr_list.iter() {
                 for sub_vr in vr.resources.iter() {
@@ -698,6 +750,7 @@ impl Transition for SystemSpec {
                 fsimg: c.initfs.clone(),
                 virt_res: c.virt_res.as_ref().cloned().unwrap_or_else(Vec::new),
                 constants: c.constants.as_ref().unwrap_or(&Vec::new()).clone(),
+                cores: c.cores.clone(),
             };
             components.insert(ComponentName::new(&c.name, &String::from("global")), comp);
             deps.insert(ComponentName::new(&c.name, &String::from("global")), ds);
@@ -1,4 +1,5 @@
 use passes::{component, BuildState, ComponentId, InitParamPass, SystemState, TransitionIter};
+use std::collections::HashMap;
 use syshelpers::emit_file;
 
 #[derive(Debug, Clone)]
@@ -54,7 +55,14 @@ impl ArgsKV {
     // This provides code generation for the data-structure containing
     // the initial arguments for the component.  Return a string
     // accumulating new definitions, and another accumulating arrays.
-    fn serialize_rec(&self, ns: &mut VarNamespace) -> (String, Vec<String>) {
+    // The path of each entry (below the top) and its variable are
+    // added to the index.
+    fn serialize_rec(
+        &self,
+        ns: &mut VarNamespace,
+        path: Option<String>,
+        index: &mut Vec<(String, String)>,
+    ) -> (String, Vec<String>) {
         match &self {
             ArgsKV {
                 key: k,
@@ -62,6 +70,9 @@ impl ArgsKV {
             } => {
                 // base case
                 let kv_name = ns.fresh_name();
+                if let Some(p) = path {
+                    index.push((p, kv_name.clone()));
+                }
                 (
                     format!(
                         r#"static struct kv_entry {} = {{ key: "{}", vtype: VTYPE_STR, val: {{ str: "{}" }} }};
@@ -77,11 +88,18 @@ impl ArgsKV {
             } => {
                 let arr_val_name = ns.fresh_name(); // the array value structure
                 let arr_name = ns.fresh_name(); // the actual array
-                                                // recursive call to serialize all nested K/Vs
+                if let Some(ref p) = path {
+                    index.push((p.clone(), arr_val_name.clone()));
+                }
+                // recursive call to serialize all nested K/Vs
                 let strs = kvs
                     .iter()
                     .fold((String::from(""), Vec::new()), |(t, s), kv| {
-                        let (t1, s1) = kv.serialize_rec(ns);
+                        let kv_path = match path {
+                            Some(ref p) => format!("{}/{}", p, kv.key),
+                            None => kv.key.clone(),
+                        };
+                        let (t1, s1) = kv.serialize_rec(ns, Some(kv_path), index);
 
                         let mut exprs = Vec::new();
                         exprs.extend(s1);
@@ -111,14 +129,151 @@ static struct kv_entry {} = {{ key: "{}", vtype: VTYPE_ARR, val: {{ arr: {{ sz:
     // Generate the c data-structure for the initial arguments to be
     // paired with the cosargs library
     pub fn serialize(&self) -> String {
+        self.serialize_indexed(&Vec::new())
+    }
+
+    // ...along with the index of their paths, and of the paths to the
+    // records (at the given offsets) in the tarball.
+    pub fn serialize_indexed(&self, tar_ents: &Vec<(String, u64)>) -> String {
         let mut ns = VarNamespace::new();
+        let mut index = Vec::new();
+        let defs = self.serialize_rec(&mut ns, None, &mut index).0;
+
+        let mut ents: Vec<(String, IndexEnt)> = index
+            .into_iter()
+            .map(|(p, v)| (p, IndexEnt::Kv(v)))
+            .collect();
+        tar_ents
+            .iter()
+            .for_each(|(p, off)| ents.push((p.clone(), IndexEnt::Tar(*off))));
 
         format!("#include <initargs.h>
 {}
-struct initargs __initargs_root = {{ type: ARGS_IMPL_KV, d: {{ kv_ent: &__initargs_autogen_0 }} }};", self.serialize_rec(&mut ns).0)
+struct initargs __initargs_root = {{ type: ARGS_IMPL_KV, d: {{ kv_ent: &__initargs_autogen_0 }} }};
+{}", defs, index_serialize(ents))
     }
 }
 
+enum IndexEnt {
+    Kv(String),
+    Tar(u64),
+}
+
+// FNV-1a of the path, and the murmur3 finalizer to mix it. These must
+// match args_index_hash and args_index_mix in lib/initargs/initargs.c.
+fn index_hash(path: &str) -> u32 {
+    path.bytes()
+        .fold(2166136261u32, |h, b| (h ^ b as u32).wrapping_mul(16777619))
+}
+
+fn index_mix(h: u32) -> u32 {
+    let h = (h ^ (h >> 16)).wrapping_mul(0x85ebca6b);
+    let h = (h ^ (h >> 13)).wrapping_mul(0xc2b2ae35);
+    h ^ (h >> 16)
+}
+
+fn index_slot(h: u32, disp: u32, sz: usize) -> usize {
+    (index_mix(h.wrapping_add(disp.wrapping_mul(0x9e3779b9))) as usize) & (sz - 1)
+}
+
+// The displacements tried for a bucket before its paths are left out
+// of the index. Paths with the same hash can never be separated.
+const INDEX_DISP_MAX: u32 = 1 << 16;
+
+// Build a perfect hash over the paths (hash and displace): each
+// path's hash selects a bucket, and we search, from the largest
+// bucket down, for a displacement of each bucket that maps all of
+// its paths to free slots. Returns the displacements, the table
+// size, and which buckets were placed; the paths of the others are
+// left out of the index, and looked up by walking the maps.
+fn index_perfect_hash(paths: &Vec<&String>) -> (Vec<u32>, usize, Vec<bool>) {
+    let n = paths.len();
+    let sz = (n + n / 4).next_power_of_two();
+    let nbuckets = ((n + 3) / 4).next_power_of_two();
+
+    let mut buckets: Vec<Vec<u32>> = vec![Vec::new(); nbuckets];
+    paths.iter().for_each(|p| {
+        let h = index_hash(p);
+        buckets[(index_mix(h) as usize) & (nbuckets - 1)].push(h);
+    });
+    let mut order: Vec<usize> = (0..nbuckets).collect();
+    order.sort_by(|a, b| buckets[*b].len().cmp(&buckets[*a].len()));
+
+    let mut used = vec![false; sz];
+    let mut disps = vec![0; nbuckets];
+    let mut placed = vec![false; nbuckets];
+    for b in order {
+        if buckets[b].len() == 0 {
+            break;
+        }
+        for d in 0..INDEX_DISP_MAX {
+            let mut slots: Vec<usize> = buckets[b].iter().map(|h| index_slot(*h, d, sz)).collect();
+            let free = slots.iter().all(|s| !used[*s]);
+            slots.sort();
+            slots.dedup();
+            if free && slots.len() == buckets[b].len() {
+                slots.iter().for_each(|s| used[*s] = true);
+                disps[b] = d;
+                placed[b] = true;
+                break;
+            }
+        }
+    }
+
+    (disps, sz, placed)
+}
+
+// Generate the index used by args_get_entry to lookup paths from the
+// root. Array entries share their path (their keys are "_"), so paths
+// that aren't unique are left out, and are found by walking the maps.
+fn index_serialize(ents: Vec<(String, IndexEnt)>) -> String {
+    let mut cnts: HashMap<String, usize> = HashMap::new();
+    ents.iter()
+        .for_each(|(p, _)| *cnts.entry(p.clone()).or_insert(0) += 1);
+    let ents: Vec<(String, IndexEnt)> = ents
+        .into_iter()
+        .filter(|(p, _)| cnts[p] == 1)
+        .collect();
+    if ents.len() == 0 {
+        return String::from("");
+    }
+
+    let (disps, sz, placed) = index_perfect_hash(&ents.iter().map(|(p, _)| p).collect());
+    let nbuckets = disps.len();
+    let slots: Vec<String> = ents
+        .iter()
+        .filter(|(p, _)| placed[(index_mix(index_hash(p)) as usize) & (nbuckets - 1)])
+        .map(|(p, e)| {
+            let h = index_hash(p);
+            let slot = index_slot(h, disps[(index_mix(h) as usize) & (nbuckets - 1)], sz);
+            match e {
+                IndexEnt::Kv(v) => format!(
+                    "\t[{}] = {{ path: \"{}\", kv_ent: &{} }},\n",
+                    slot, p, v
+                ),
+                IndexEnt::Tar(off) => format!(
+                    "\t[{}] = {{ path: \"{}\", tar_off: {} }},\n",
+                    slot, p, off
+                ),
+            }
+        })
+        .collect();
+
+    format!(
+        r#"static unsigned int __initargs_index_disps[{}] = {{{}}};
+static struct initargs_index_ent __initargs_index_ents[{}] = {{
+{}}};
+struct initargs_index __initargs_index = {{ nbuckets: {}, disps: __initargs_index_disps, sz: {}, ents: __initargs_index_ents }};
+"#,
+        nbuckets,
+        disps.iter().map(|d| d.to_string()).collect::<Vec<String>>().join(", "),
+        sz,
+        slots.concat(),
+        nbuckets,
+        sz
+    )
+}
+
 // The key within the initargs for the tarball, the path of the
 // tarball, and the set of paths to the files to include in the
 // tarball and name of them within the tarball.
@@ -184,8 +339,19 @@ impl TransitionIter for Parameters {
         let argpath = b.comp_file_path(&id, &"initargs.c".to_string(), s)?;
         let mut args = Vec::new();
 
-        let param_args = component(s, id).params.clone();
+        let c = component(s, id);
+        let param_args = c.params.clone();
         args.push(ArgsKV::new_arr(String::from("param"), param_args));
+        // Core placement is an array of core ids (with "_" keys, see
+        // initargs.h), and is omitted when the component can run on
+        // all cores.
+        if let Some(ref cores) = c.cores {
+            let core_args = cores
+                .iter()
+                .map(|core| ArgsKV::new_key(String::from("_"), core.to_string()))
+                .collect();
+            args.push(ArgsKV::new_arr(String::from("cores"), core_args));
+        }
         let resargs = s.get_restbl().args(&id);
         resargs.iter().for_each(|a| args.push(a.clone()));
         args.push(ArgsKV::new_key(String::from("compid"), id.to_string()));
@@ -199,3 +365,36 @@ impl TransitionIter for Parameters {
         }))
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn index_hash_collision() {
+        // Distinct paths with the same hash can't both be indexed,
+        // but the others still are.
+        let (a, b) = (String::from("p2039599"), String::from("p2222382"));
+        assert_eq!(index_hash(&a), index_hash(&b));
+        let others: Vec<String> = (0..64).map(|i| format!("param/{}", i)).collect();
+        let mut paths: Vec<&String> = others.iter().collect();
+        paths.push(&a);
+        paths.push(&b);
+
+        let (disps, sz, placed) = index_perfect_hash(&paths);
+        let nbuckets = disps.len();
+        let bucket = |p: &String| (index_mix(index_hash(p)) as usize) & (nbuckets - 1);
+        assert!(!placed[bucket(&a)]);
+
+        let mut slots: Vec<usize> = paths
+            .iter()
+            .filter(|p| placed[bucket(p)])
+            .map(|p| index_slot(index_hash(p), disps[bucket(p)], sz))
+            .collect();
+        let n = slots.len();
+        slots.sort();
+        slots.dedup();
+        assert_eq!(slots.len(), n);
+        assert!(n >= others.len() / 2);
+    }
+}
@@ -23,6 +23,7 @@ mod tot_order;
 mod virt_resources;
 mod analysis;
 mod graph;
+mod stack_analysis;
 
 
 use address_assignment::AddressAssignmentx86_64;
@@ -40,8 +41,12 @@ use tot_order::CompTotOrd;
 use virt_resources::VirtResAnalysis;
 use graph::Graph;
 use analysis::Analysis;
-use std::process::Command;
-use std::str;
+use stack_analysis::StackAnalysis;
+use syshelpers::dump_file;
+
+// Analyzed stacks are at least the default size (MAX_STACK_SZ_BYTE_ORDER
+// in consts.h), so the analysis only ever grows them.
+const STACK_MIN_ORDER: u32 = 13;
 
 pub fn exec() -> Result<(), String> {
     let mut args = env::args();
@@ -75,6 +80,9 @@ pub fn exec() -> Result<(), String> {
     sys.add_address_assign(AddressAssignmentx86_64::transition(&sys, &mut build)?);
     sys.add_properties(CompProperties::transition(&sys, &mut build)?);
     sys.add_restbls(ResAssignPass::transition(&sys, &mut build)?);
+    // The analysis only depends on the specification, and sizes the
+    // components' resources, so it precedes their compilation.
+    sys.add_analysis(Analysis::transition(&sys, &mut build)?);
 
     // process these in reverse order of dependencies (e.g. booter last)
     let reverse_ids: Vec<ComponentId> = sys
@@ -87,15 +95,22 @@ pub fn exec() -> Result<(), String> {
     for c_id in reverse_ids.iter() {
         let header_file_path =
             build.comp_file_path(&c_id, &"component_constants.h".to_string(), &sys)?;
-        build.comp_init_header_file(&header_file_path);
+        build.comp_init_header_file(&header_file_path, &sys.get_analysis().constants(*c_id, &sys));
 
         sys.add_params_iter(&c_id, Parameters::transition_iter(c_id, &sys, &mut build)?);
-        sys.add_objs_iter(&c_id, ElfObject::transition_iter(c_id, &sys, &mut build)?);
+    }
+    // Each component's compilation depends only on its own
+    // parameters, so build them all concurrently. Only the
+    // invocations depend on other components' objects.
+    let objs = build.comp_build_all(&reverse_ids, &sys)?;
+    for (c_id, obj) in reverse_ids.iter().zip(objs.iter()) {
+        sys.add_objs_iter(&c_id, ElfObject::from_obj(c_id, obj, &sys, &mut build)?);
+    }
+    for c_id in reverse_ids.iter() {
         sys.add_invs_iter(&c_id, Invocations::transition_iter(c_id, &sys, &mut build)?);
     }
     sys.add_constructor(Constructor::transition(&sys, &mut build)?);
     sys.add_graph(Graph::transition(&sys, &mut build)?);
-    sys.add_analysis(Analysis::transition(&sys, &mut build)?);
   
     let analysis = sys.get_analysis();  
     let component_ids = sys.get_named().ids();
@@ -110,9 +125,8 @@ pub fn exec() -> Result<(), String> {
       3.add the entry prefix 
       4.call the stack size analysis 
       5.return the stack size
-      6.insert stack size into header file
-      6.TBD: get the analysis result of thread number
-      7.insert the max_local_num_thread into header file*/ 
+      6.insert stack size, and the analyzed thread and blockpoint
+        bounds into header file*/ 
    if is_rebuild {
         let booter_id = 1;
         for c_id in reverse_ids.iter() {
@@ -144,28 +158,24 @@ pub fn exec() -> Result<(), String> {
     
             println!("symbol_names_arg for component {} at: {:?}", &c_id, &symbol_names_arg);
 
-            let mut stack_sizes = Vec::new();
             let binary = build.comp_obj_path(&c_id, &sys)?;
             println!("symbol_names_arg for component {}",binary );
-            /* call stack size analysis tool here get the result */
+            /* analyze the stack usage of all entry points in a single pass over the call graph */
+            let mut stack = StackAnalysis::new(&dump_file(&binary)?)?;
+            let mut max_stack_size = 0;
+            let mut unresolved = Vec::new();
             for symbol_name in &symbol_names {
-                let output = Command::new("python3")
-                    .arg("./tools/pyelftool_parser/src/analyzer.py") 
-                    .arg(&binary)
-                    .arg(&symbol_name)
-                    .output()
-                    .expect("Failed to execute Python script");
-        
-                let stack_size: i32 = str::from_utf8(&output.stdout)
-                    .expect("Failed to convert output to string")
-                    .trim()
-                    .parse()
-                    .expect("Failed to parse stack size");
-        
-                stack_sizes.push(stack_size);
+                match stack.symbol_usage(&symbol_name) {
+                    Ok(sz) => {
+                        println!("Stack usage of {} in component {}: {} bytes", symbol_name, &c_id, sz);
+                        max_stack_size = max_stack_size.max(sz);
+                    }
+                    Err(e) => {
+                        println!("Warning: {}", e);
+                        unresolved.push(symbol_name.clone());
+                    }
+                }
             }
-            
-            let max_stack_size = stack_sizes.iter().max().expect("No stack sizes found");
 
             println!("invs name for component {} at: {:?}", &c_id, &invs);
     
@@ -173,14 +183,34 @@ pub fn exec() -> Result<(), String> {
     
             println!("symbol name for component {} at: {:?}",&c_id, &symbol_names);
     
-            let new_constant = ConstantVal {
-                variable: "COS_STACK_SZ".to_string(),
-                value: max_stack_size.to_string(),
-            };
-    
-            let mut iner_constants = Vec::new();
-
-            iner_constants.push(new_constant);
+            let mut iner_constants = sys.get_analysis().constants(*c_id, &sys);
+
+            // The stacks are allocated at power-of-2 sizes and
+            // alignments, so round the analyzed size up. Only use it
+            // if it bounds every entry point: any entry we couldn't
+            // find, or anything the analysis couldn't follow (e.g.
+            // the thread bodies the upcall entry calls through
+            // function pointers), keeps the default size.
+            if unresolved.len() > 0 {
+                println!("Warning: component {} has entry points we couldn't analyze ({}); using the default stack size.", &c_id, unresolved.join(", "));
+            } else if let Some(reason) = stack.unbounded() {
+                println!("Warning: component {} has {}; using the default stack size.", &c_id, reason);
+            } else {
+                let order = std::cmp::max(STACK_MIN_ORDER, 64 - (max_stack_size.max(1) - 1).leading_zeros());
+
+                iner_constants.push(ConstantVal {
+                    variable: "COS_STACK_SZ_ANALYZED".to_string(),
+                    value: max_stack_size.to_string(),
+                });
+                iner_constants.push(ConstantVal {
+                    variable: "MAX_STACK_SZ_BYTE_ORDER".to_string(),
+                    value: order.to_string(),
+                });
+                iner_constants.push(ConstantVal {
+                    variable: "COS_STACK_SZ".to_string(),
+                    value: (1u64 << order).to_string(),
+                });
+            }
     
             let header_file_path =
                 build.comp_file_path(&c_id, &"component_constants.h".to_string(), &sys)?;
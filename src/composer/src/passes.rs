@@ -189,8 +189,9 @@ pub trait BuildState {
         s: &SystemState,
     ) -> Result<(), String>; // path of header file of component constants value
 
-    fn comp_init_header_file(&self, header_file_path: &String);
+    fn comp_init_header_file(&self, header_file_path: &String, constants: &Vec<ConstantVal>);
     fn comp_build(&self, c: &ComponentId, state: &SystemState) -> Result<String, String>; // build the component, and return the path to the resulting object
+    fn comp_build_all(&self, cs: &Vec<ComponentId>, state: &SystemState) -> Result<Vec<String>, String>; // build the components concurrently, and return the paths to their objects (in the order of cs)
     fn constructor_build(&self, c: &ComponentId, state: &SystemState) -> Result<String, String>; // build a constructor, including all components it is responsible for booting
     fn kernel_build(
         &self,
@@ -272,6 +273,7 @@ pub struct Component {
     pub fsimg: Option<String>,
     pub virt_res: Vec<CompVirtRes>,
     pub constants: Vec<ConstantVal>,
+    pub cores: Option<Vec<usize>>, // core placement, None = all cores
 }
 
 // Input/frontend pass taking the specification, and outputing the
@@ -480,4 +482,5 @@ pub trait GraphPass {
 pub trait AnalysisPass {
     fn warnings(&self) -> &HashMap<ComponentId, Vec<Warning>>;
     fn warning_str(&self, id: ComponentId, s: &SystemState) -> String;
+    fn constants(&self, id: ComponentId, s: &SystemState) -> Vec<ConstantVal>; // static resource limits for the component's component_constants.h
 }
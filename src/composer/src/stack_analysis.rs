@@ -0,0 +1,648 @@
+// Static analysis of the maximum stack depth of a component's entry
+// points (its server stubs, and the upcall entry) by walking the call
+// graph of the x86-64 binary.
+//
+// Each function is scanned linearly (with an instruction length
+// decoder) to find
+//
+// - its frame size: the maximum depth of the stack within the
+//   function due to pushes, pops, and adjustments to %rsp, and
+// - the direct calls (and tail calls) it makes, along with the stack
+//   depth at each.
+//
+// The stack usage of a function is then the maximum of its frame
+// size, and the depth at each call plus the return address plus the
+// callee's stack usage. Usage is memoized per function, so all entry
+// points of a binary are analyzed in a single pass over the call
+// graph. Indirect calls cannot be followed, and neither recursion nor
+// frames of dynamic size (adjustments of %rsp by a register, e.g. for
+// alloca and variable length arrays) can be bounded. Neither can
+// calls to addresses that aren't the start of a function, nor
+// functions we fail to decode. These are all reported, and
+// `unbounded` summarizes them: if it returns a reason, the usage is
+// only a lower bound.
+
+use std::collections::{BTreeMap, HashMap};
+use xmas_elf::sections::SectionData;
+use xmas_elf::symbol_table::{Entry, Type};
+use xmas_elf::ElfFile;
+
+// The summary of a single function's code.
+struct FnScan {
+    frame: u64,
+    calls: Vec<(u64, u64)>,  // (stack depth at the call, target)
+    tails: Vec<(u64, u64)>,  // (stack depth at the jump, target)
+    indirect: bool,          // are there calls through function pointers?
+    dynamic: bool,           // is %rsp adjusted by a non-constant amount?
+    undecodable: bool,       // did we give up decoding part of the function?
+}
+
+enum Usage {
+    Visiting,
+    Done(u64),
+}
+
+pub struct StackAnalysis {
+    text: Vec<u8>,
+    text_addr: u64,
+    // function start address -> (end address, name)
+    fns: BTreeMap<u64, (u64, String)>,
+    usage: HashMap<u64, Usage>,
+    pub recursive: Vec<String>,
+    pub dynamic: Vec<String>,
+    pub indirect: Vec<String>,
+    pub unknown: Vec<String>,
+    pub undecodable: Vec<String>,
+}
+
+impl StackAnalysis {
+    // Parse the functions and .text section out of the object.
+    pub fn new(obj: &Vec<u8>) -> Result<StackAnalysis, String> {
+        let elf = ElfFile::new(obj)?;
+        let text = elf
+            .find_section_by_name(".text")
+            .ok_or(String::from("Could not find the .text section."))?;
+        let mut starts: BTreeMap<u64, (u64, String)> = BTreeMap::new();
+
+        let mut add = |name: &str, addr: u64, sz: u64, t: Result<Type, &'static str>| {
+            if let Ok(Type::Func) = t {
+                starts.insert(addr, (sz, String::from(name)));
+            }
+        };
+        let symtab = elf
+            .find_section_by_name(".symtab")
+            .ok_or(String::from("Could not find the symbol table (is the object stripped?)."))?;
+        match symtab.get_data(&elf) {
+            Ok(SectionData::SymbolTable64(ref sts)) => sts.iter().for_each(|s| {
+                if let Ok(n) = s.get_name(&elf) {
+                    add(n, s.value(), s.size(), s.get_type())
+                }
+            }),
+            Ok(SectionData::SymbolTable32(ref sts)) => sts.iter().for_each(|s| {
+                if let Ok(n) = s.get_name(&elf) {
+                    add(n, s.value(), s.size(), s.get_type())
+                }
+            }),
+            _ => return Err(String::from("Could not find the symbol table.")),
+        }
+
+        Ok(StackAnalysis::from_text(
+            text.raw_data(&elf).to_vec(),
+            text.address(),
+            starts,
+        ))
+    }
+
+    // Assembly functions often don't have a size, so they extend to
+    // the next function.
+    fn from_text(text: Vec<u8>, text_addr: u64, starts: BTreeMap<u64, (u64, String)>) -> StackAnalysis {
+        let text_end = text_addr + text.len() as u64;
+        let addrs: Vec<u64> = starts.keys().cloned().collect();
+        let mut fns = BTreeMap::new();
+
+        for (i, a) in addrs.iter().enumerate() {
+            let (sz, ref name) = starts[a];
+            let next = if i + 1 < addrs.len() { addrs[i + 1] } else { text_end };
+            let end = if sz > 0 { a + sz } else { next };
+            if *a >= text_addr && end <= text_end {
+                fns.insert(*a, (end, name.clone()));
+            }
+        }
+
+        StackAnalysis {
+            text,
+            text_addr,
+            fns,
+            usage: HashMap::new(),
+            recursive: Vec::new(),
+            dynamic: Vec::new(),
+            indirect: Vec::new(),
+            unknown: Vec::new(),
+            undecodable: Vec::new(),
+        }
+    }
+
+    // Why the usage found so far can't be trusted as an upper bound,
+    // if it can't.
+    pub fn unbounded(&self) -> Option<String> {
+        let reasons = [
+            ("recursive functions", &self.recursive),
+            ("functions with frames of dynamic size", &self.dynamic),
+            ("indirect calls in", &self.indirect),
+            ("calls to unknown functions at", &self.unknown),
+            ("undecodable instructions in", &self.undecodable),
+        ];
+
+        reasons
+            .iter()
+            .find(|(_, fns)| !fns.is_empty())
+            .map(|(what, fns)| format!("{} ({})", what, fns.join(", ")))
+    }
+
+    // The maximum stack usage, in bytes, of the function named `symb`.
+    pub fn symbol_usage(&mut self, symb: &str) -> Result<u64, String> {
+        let addr = self
+            .fns
+            .iter()
+            .find(|(_, (_, n))| n == symb)
+            .map(|(a, _)| *a)
+            .ok_or(format!("Could not find function {} for stack analysis.", symb))?;
+
+        Ok(self.fn_usage(addr))
+    }
+
+    fn fn_usage(&mut self, addr: u64) -> u64 {
+        match self.usage.get(&addr) {
+            Some(Usage::Done(u)) => return *u,
+            Some(Usage::Visiting) => {
+                let name = self.fns[&addr].1.clone();
+                if !self.recursive.contains(&name) {
+                    self.recursive.push(name);
+                }
+                return 0;
+            }
+            None => (),
+        }
+        let (end, name) = match self.fns.get(&addr) {
+            Some((e, n)) => (*e, n.clone()),
+            None => {
+                // a call to the middle of a function, or into another section
+                let target = format!("{:#x}", addr);
+                if !self.unknown.contains(&target) {
+                    self.unknown.push(target);
+                }
+                return 0;
+            }
+        };
+
+        self.usage.insert(addr, Usage::Visiting);
+        let lo = (addr - self.text_addr) as usize;
+        let hi = (end - self.text_addr) as usize;
+        let scan = fn_scan(&self.text[lo..hi], addr);
+        if scan.indirect {
+            self.indirect.push(name.clone());
+        }
+        if scan.undecodable {
+            self.undecodable.push(name.clone());
+        }
+        if scan.dynamic {
+            self.dynamic.push(name);
+        }
+
+        let mut usage = scan.frame;
+        for (depth, target) in scan.calls.iter() {
+            // the callee's frame starts below our return address
+            usage = usage.max(depth + 8 + self.fn_usage(*target));
+        }
+        for (depth, target) in scan.tails.iter() {
+            usage = usage.max(depth + self.fn_usage(*target));
+        }
+        self.usage.insert(addr, Usage::Done(usage));
+
+        usage
+    }
+}
+
+// Instruction classes relevant to stack depth and the call graph.
+#[derive(Debug, PartialEq)]
+enum Insn {
+    Push,
+    Pop,
+    RspAdjust(i64), // sub (positive) or add (negative) to %rsp
+    RspDynamic,     // %rsp set to, or adjusted by, a register
+    FramePtr,       // mov %rsp, %rbp
+    Leave,
+    Call(u64),
+    CallIndirect,
+    Jmp(u64),
+    Jcc(u64),
+    Ret,
+    Other,
+}
+
+fn fn_scan(code: &[u8], addr: u64) -> FnScan {
+    let end = addr + code.len() as u64;
+    let mut scan = FnScan {
+        frame: 0,
+        calls: Vec::new(),
+        tails: Vec::new(),
+        indirect: false,
+        dynamic: false,
+        undecodable: false,
+    };
+    // The stack depth below the return address, that of %rbp (set by
+    // the frame pointer setup), and the maximum depth at any control
+    // transfer. After a ret or unconditional jump, the code that
+    // follows is reached by a branch, so we assume it executes at
+    // the deepest depth we've branched from.
+    let (mut depth, mut rbp_depth, mut branch_depth): (i64, i64, i64) = (0, 0, 0);
+    let mut off = 0;
+
+    while off < code.len() {
+        let (len, insn) = match insn_decode(&code[off..], addr + off as u64) {
+            Some(d) => d,
+            None => {
+                scan.undecodable = true;
+                break;
+            }
+        };
+        off += len;
+
+        match insn {
+            Insn::Push => depth += 8,
+            Insn::Pop => depth -= 8,
+            Insn::RspAdjust(n) => depth += n,
+            Insn::FramePtr => rbp_depth = depth,
+            Insn::Leave => depth = rbp_depth - 8,
+            Insn::Call(t) => {
+                scan.calls.push((depth.max(0) as u64, t));
+                branch_depth = branch_depth.max(depth);
+            }
+            Insn::CallIndirect => scan.indirect = true,
+            Insn::RspDynamic => scan.dynamic = true,
+            Insn::Jcc(t) | Insn::Jmp(t) if t < addr || t >= end => {
+                scan.tails.push((depth.max(0) as u64, t));
+            }
+            Insn::Jcc(_) => branch_depth = branch_depth.max(depth),
+            Insn::Jmp(_) => {
+                branch_depth = branch_depth.max(depth);
+            }
+            _ => (),
+        }
+        if depth < 0 {
+            depth = 0;
+        }
+        scan.frame = scan.frame.max(depth as u64);
+        match insn {
+            Insn::Ret | Insn::Jmp(_) => depth = branch_depth,
+            _ => (),
+        }
+    }
+
+    scan
+}
+
+// Does the one-byte opcode have a ModRM byte, and how many bytes of
+// immediate (z is 2 or 4 depending on the operand size) follow it?
+// None is an opcode that is invalid in 64 bit mode, or handled
+// specially.
+fn op1_format(op: u8, z: usize) -> Option<(bool, usize)> {
+    Some(match op {
+        0x00..=0x3f => match op & 0x7 {
+            0..=3 => (true, 0),
+            4 => (false, 1),
+            5 => (false, z),
+            _ => return None, // prefixes and invalid opcodes
+        },
+        0x50..=0x5f => (false, 0),
+        0x63 => (true, 0),
+        0x68 => (false, z),
+        0x69 => (true, z),
+        0x6a => (false, 1),
+        0x6b => (true, 1),
+        0x6c..=0x6f => (false, 0),
+        0x70..=0x7f => (false, 1),
+        0x80 | 0x83 => (true, 1),
+        0x81 => (true, z),
+        0x84..=0x8f => (true, 0),
+        0x90..=0x99 | 0x9b..=0x9f => (false, 0),
+        0xa4..=0xa7 | 0xaa..=0xaf => (false, 0),
+        0xa8 => (false, 1),
+        0xa9 => (false, z),
+        0xb0..=0xb7 => (false, 1),
+        0xc0 | 0xc1 | 0xc6 => (true, 1),
+        0xc2 | 0xca => (false, 2),
+        0xc3 | 0xc9 | 0xcb | 0xcc | 0xcf => (false, 0),
+        0xc7 => (true, z),
+        0xc8 => (false, 3),
+        0xcd => (false, 1),
+        0xd0..=0xd3 | 0xd8..=0xdf => (true, 0),
+        0xd7 => (false, 0),
+        0xe0..=0xe7 | 0xeb => (false, 1),
+        0xe8 | 0xe9 => (false, 4),
+        0xec..=0xef | 0xf1 | 0xf4 | 0xf5 | 0xf8..=0xfd => (false, 0),
+        0xfe | 0xff => (true, 0),
+        _ => return None,
+    })
+}
+
+// The same for the two-byte (0x0f-prefixed) opcodes.
+fn op2_format(op: u8) -> Option<(bool, usize)> {
+    Some(match op {
+        0x00..=0x03 | 0x0d => (true, 0),
+        0x05..=0x09 | 0x0b | 0x0e => (false, 0),
+        0x0f => (true, 1),
+        0x10..=0x23 | 0x28..=0x2f => (true, 0),
+        0x30..=0x37 => (false, 0),
+        0x40..=0x6f => (true, 0),
+        0x70..=0x73 => (true, 1),
+        0x74..=0x76 | 0x78..=0x7f => (true, 0),
+        0x77 => (false, 0),
+        0x80..=0x8f => (false, 4),
+        0x90..=0x9f => (true, 0),
+        0xa0..=0xa2 | 0xa8..=0xaa | 0xc8..=0xcf => (false, 0),
+        0xa4 | 0xac | 0xba | 0xc2 | 0xc4..=0xc6 => (true, 1),
+        0xa3 | 0xa5 | 0xab | 0xad..=0xb9 | 0xbb..=0xc1 | 0xc3 | 0xc7 => (true, 0),
+        0xd0..=0xff => (true, 0),
+        _ => return None,
+    })
+}
+
+// The opcodes in the VEX/EVEX map 1 (0x0f) that take an imm8.
+fn vex_map1_imm(op: u8) -> bool {
+    match op {
+        0x70..=0x73 | 0xc2 | 0xc4..=0xc6 => true,
+        _ => false,
+    }
+}
+
+// The number of bytes in the ModRM, SIB, and displacement.
+fn modrm_len(code: &[u8]) -> Option<usize> {
+    let modrm = *code.get(0)?;
+    let (md, rm) = (modrm >> 6, modrm & 0x7);
+
+    if md == 3 {
+        return Some(1);
+    }
+    let mut len = 1;
+    if rm == 4 {
+        let sib = *code.get(1)?;
+        len += 1;
+        if md == 0 && (sib & 0x7) == 5 {
+            len += 4;
+        }
+    } else if md == 0 && rm == 5 {
+        len += 4; // rip-relative
+    }
+    len += match md {
+        1 => 1,
+        2 => 4,
+        _ => 0,
+    };
+
+    Some(len)
+}
+
+fn imm_signed(code: &[u8], sz: usize) -> Option<i64> {
+    let b = code.get(0..sz)?;
+    Some(match sz {
+        1 => b[0] as i8 as i64,
+        4 => i32::from_le_bytes([b[0], b[1], b[2], b[3]]) as i64,
+        _ => return None,
+    })
+}
+
+// Decode the length of the instruction at the start of `code` (at
+// address `pc`), and classify it.
+fn insn_decode(code: &[u8], pc: u64) -> Option<(usize, Insn)> {
+    let mut i = 0;
+    let mut opsz16 = false;
+    let mut addr32 = false;
+    let mut rex_w = false;
+    let mut rex_r = false;
+    let mut rex_b = false;
+
+    // legacy prefixes, then REX
+    loop {
+        match *code.get(i)? {
+            0x66 => opsz16 = true,
+            0x67 => addr32 = true,
+            0xf0 | 0xf2 | 0xf3 | 0x26 | 0x2e | 0x36 | 0x3e | 0x64 | 0x65 => (),
+            _ => break,
+        }
+        i += 1;
+    }
+    let rex = *code.get(i)?;
+    if rex & 0xf0 == 0x40 {
+        rex_w = rex & 0x8 != 0;
+        rex_r = rex & 0x4 != 0;
+        rex_b = rex & 0x1 != 0;
+        i += 1;
+    }
+    let z = if opsz16 { 2 } else { 4 };
+    let op = *code.get(i)?;
+    i += 1;
+
+    // VEX and EVEX encoded instructions always have a ModRM
+    let vex = match op {
+        0xc5 => Some((1, 1)),
+        0xc4 => Some((2, code.get(i)? & 0x1f)),
+        0x62 => Some((3, code.get(i)? & 0x3)),
+        _ => None,
+    };
+    if let Some((prefix_len, map)) = vex {
+        i += prefix_len;
+        let vop = *code.get(i)?;
+        i += 1;
+        if map == 1 && vop == 0x77 && op != 0x62 {
+            return Some((i, Insn::Other)); // vzeroupper/vzeroall
+        }
+        i += modrm_len(code.get(i..)?)?;
+        if map == 3 || (map == 1 && vex_map1_imm(vop)) {
+            i += 1;
+        }
+        return if i <= code.len() { Some((i, Insn::Other)) } else { None };
+    }
+
+    let (has_modrm, imm) = match op {
+        0x0f => {
+            let op2 = *code.get(i)?;
+            i += 1;
+            match op2 {
+                0x38 => {
+                    i += 1;
+                    (true, 0)
+                }
+                0x3a => {
+                    i += 1;
+                    (true, 1)
+                }
+                _ => {
+                    let f = op2_format(op2)?;
+                    if (0x80..=0x8f).contains(&op2) {
+                        let rel = imm_signed(code.get(i..)?, 4)?;
+                        let next = pc + (i + 4) as u64;
+                        return Some((i + 4, Insn::Jcc(next.wrapping_add(rel as u64))));
+                    }
+                    f
+                }
+            }
+        }
+        0xa0..=0xa3 => (false, if addr32 { 4 } else { 8 }), // moffs
+        0xb8..=0xbf => (false, if rex_w { 8 } else { z }),
+        0xf6 => (true, if code.get(i)? & 0x38 <= 0x08 { 1 } else { 0 }),
+        0xf7 => (true, if code.get(i)? & 0x38 <= 0x08 { z } else { 0 }),
+        _ => op1_format(op, z)?,
+    };
+
+    let modrm_at = i;
+    if has_modrm {
+        i += modrm_len(code.get(i..)?)?;
+    }
+    let imm_at = i;
+    i += imm;
+    if i > code.len() {
+        return None;
+    }
+    let next = pc + i as u64;
+    let modrm = if has_modrm { code[modrm_at] } else { 0 };
+    // Is %rsp the register operand, or the register r/m operand, of
+    // the ModRM? Is %rbp the other (for frame pointer restores)?
+    let reg_rsp = has_modrm && modrm & 0x38 == 0x20 && !rex_r;
+    let rm_rsp = has_modrm && modrm & 0xc7 == 0xc4 && !rex_b;
+    let reg_rbp = modrm & 0x38 == 0x28 && !rex_r;
+    let rm_rbp = modrm & 0x07 == 0x05 && modrm & 0xc0 != 0 && !rex_b;
+
+    let insn = match op {
+        0x50..=0x57 | 0x68 | 0x6a | 0x9c => Insn::Push,
+        0x58..=0x5f | 0x9d => Insn::Pop,
+        0x8f if modrm & 0x38 == 0 => Insn::Pop,
+        0xff if modrm & 0x38 == 0x30 => Insn::Push,
+        0xff if modrm & 0x38 == 0x10 || modrm & 0x38 == 0x18 => Insn::CallIndirect,
+        // sub/add $imm, %rsp
+        0x81 | 0x83 if rex_w && modrm == 0xec => Insn::RspAdjust(imm_signed(&code[imm_at..], imm)?),
+        0x81 | 0x83 if rex_w && modrm == 0xc4 => Insn::RspAdjust(-imm_signed(&code[imm_at..], imm)?),
+        // and $-align, %rsp can drop the stack by up to align - 1
+        0x83 if rex_w && modrm == 0xe4 => Insn::RspAdjust(-imm_signed(&code[imm_at..], 1)? - 1),
+        // mov %rsp, %rbp
+        0x89 if rex_w && modrm == 0xe5 => Insn::FramePtr,
+        0x8b if rex_w && modrm == 0xec => Insn::FramePtr,
+        // mov %rbp, %rsp, and lea off(%rbp), %rsp restore the frame
+        0x89 if rm_rsp && reg_rbp => Insn::Other,
+        0x8b if reg_rsp && rm_rbp && modrm & 0xc0 == 0xc0 => Insn::Other,
+        0x8d if reg_rsp && rm_rbp => Insn::Other,
+        // add/sub/mov/lea of another register (or memory) to %rsp
+        0x01 | 0x29 | 0x89 if rex_w && rm_rsp => Insn::RspDynamic,
+        0x03 | 0x2b | 0x8b | 0x8d if rex_w && reg_rsp => Insn::RspDynamic,
+        0xc9 => Insn::Leave,
+        0xc2 | 0xc3 => Insn::Ret,
+        0xe8 => Insn::Call(next.wrapping_add(imm_signed(&code[imm_at..], 4)? as u64)),
+        0xe9 => Insn::Jmp(next.wrapping_add(imm_signed(&code[imm_at..], 4)? as u64)),
+        0xeb => Insn::Jmp(next.wrapping_add(imm_signed(&code[imm_at..], 1)? as u64)),
+        0x70..=0x7f | 0xe3 => Insn::Jcc(next.wrapping_add(imm_signed(&code[imm_at..], 1)? as u64)),
+        _ => Insn::Other,
+    };
+
+    Some((i, insn))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // Decode a single instruction at address 0x1000.
+    fn decode(code: &[u8]) -> (usize, Insn) {
+        insn_decode(code, 0x1000).unwrap()
+    }
+
+    #[test]
+    fn insn_lengths() {
+        let insns: Vec<&[u8]> = vec![
+            &[0x55],                                           // push %rbp
+            &[0x48, 0x89, 0xe5],                               // mov %rsp,%rbp
+            &[0x48, 0x83, 0xec, 0x20],                         // sub $0x20,%rsp
+            &[0x48, 0x81, 0xec, 0x00, 0x10, 0x00, 0x00],       // sub $0x1000,%rsp
+            &[0x48, 0x8b, 0x45, 0xf8],                         // mov -0x8(%rbp),%rax
+            &[0x48, 0x8d, 0x05, 0x00, 0x00, 0x00, 0x00],       // lea 0x0(%rip),%rax
+            &[0x8b, 0x44, 0x24, 0x08],                         // mov 0x8(%rsp),%eax
+            &[0x48, 0xb8, 1, 2, 3, 4, 5, 6, 7, 8],             // movabs $imm64,%rax
+            &[0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00],             // nopw 0x0(%rax,%rax,1)
+            &[0xf3, 0x0f, 0x1e, 0xfa],                         // endbr64
+            &[0xc5, 0xf8, 0x77],                               // vzeroupper
+            &[0xc5, 0xfa, 0x6f, 0x06],                         // vmovdqu (%rsi),%xmm0
+            &[0x66, 0x0f, 0x3a, 0x0f, 0xc1, 0x08],             // palignr $0x8,%xmm1,%xmm0
+            &[0xf6, 0x07, 0x01],                               // testb $0x1,(%rdi)
+            &[0xc7, 0x45, 0xfc, 0x00, 0x00, 0x00, 0x00],       // movl $0x0,-0x4(%rbp)
+        ];
+        for code in insns {
+            assert_eq!(decode(code).0, code.len(), "length of {:x?}", code);
+        }
+    }
+
+    #[test]
+    fn insn_classes() {
+        assert!(matches!(decode(&[0x55]).1, Insn::Push));
+        assert!(matches!(decode(&[0x41, 0x5c]).1, Insn::Pop)); // pop %r12
+        assert!(matches!(decode(&[0x48, 0x89, 0xe5]).1, Insn::FramePtr));
+        assert!(matches!(decode(&[0x48, 0x83, 0xec, 0x20]).1, Insn::RspAdjust(0x20)));
+        assert!(matches!(decode(&[0x48, 0x83, 0xc4, 0x20]).1, Insn::RspAdjust(-0x20)));
+        assert!(matches!(decode(&[0xc9]).1, Insn::Leave));
+        assert!(matches!(decode(&[0xc3]).1, Insn::Ret));
+        assert!(matches!(decode(&[0xff, 0xd0]).1, Insn::CallIndirect)); // call *%rax
+        // call +0x10, jmp -2, and jne +0x100 from the end of the instruction
+        assert!(matches!(decode(&[0xe8, 0x10, 0, 0, 0]).1, Insn::Call(0x1015)));
+        assert!(matches!(decode(&[0xeb, 0xfe]).1, Insn::Jmp(0x1000)));
+        assert!(matches!(decode(&[0x0f, 0x85, 0x00, 0x01, 0, 0]).1, Insn::Jcc(0x1106)));
+    }
+
+    #[test]
+    fn insn_rsp_dynamic() {
+        assert!(matches!(decode(&[0x48, 0x29, 0xc4]).1, Insn::RspDynamic)); // sub %rax,%rsp
+        assert!(matches!(decode(&[0x48, 0x2b, 0xe0]).1, Insn::RspDynamic)); // sub %rax,%rsp (0x2b)
+        assert!(matches!(decode(&[0x48, 0x01, 0xc4]).1, Insn::RspDynamic)); // add %rax,%rsp
+        assert!(matches!(decode(&[0x48, 0x89, 0xc4]).1, Insn::RspDynamic)); // mov %rax,%rsp
+        assert!(matches!(decode(&[0x48, 0x8d, 0x24, 0x04]).1, Insn::RspDynamic)); // lea (%rsp,%rax),%rsp
+        // the frame pointer restores aren't
+        assert!(matches!(decode(&[0x48, 0x89, 0xec]).1, Insn::Other)); // mov %rbp,%rsp
+        assert!(matches!(decode(&[0x48, 0x8d, 0x65, 0xe8]).1, Insn::Other)); // lea -0x18(%rbp),%rsp
+        assert!(matches!(decode(&[0x4c, 0x29, 0xc4]).1, Insn::RspDynamic)); // sub %r8,%rsp
+        // nor are operations on %r12, which shares %rsp's encoding
+        assert!(matches!(decode(&[0x49, 0x29, 0xc4]).1, Insn::Other)); // sub %rax,%r12
+    }
+
+    // Two functions: `f` at 0x1000 calls `g` at 0x1010.
+    fn analysis(f: &[u8], g: &[u8]) -> StackAnalysis {
+        let mut text = vec![0xcc; 0x20];
+        text[..f.len()].copy_from_slice(f);
+        text[0x10..0x10 + g.len()].copy_from_slice(g);
+        let mut starts = BTreeMap::new();
+        starts.insert(0x1000, (f.len() as u64, String::from("f")));
+        starts.insert(0x1010, (g.len() as u64, String::from("g")));
+        StackAnalysis::from_text(text, 0x1000, starts)
+    }
+
+    #[test]
+    fn usage() {
+        // push %rbp; sub $0x20,%rsp; call g; add $0x20,%rsp; pop %rbp; ret
+        let f = [0x55, 0x48, 0x83, 0xec, 0x20, 0xe8, 0x06, 0, 0, 0, 0x48, 0x83, 0xc4, 0x20, 0x5d, 0xc3];
+        // sub $0x100,%rsp; add $0x100,%rsp; ret
+        let g = [0x48, 0x81, 0xec, 0, 1, 0, 0, 0x48, 0x81, 0xc4, 0, 1, 0, 0, 0xc3];
+        let mut a = analysis(&f, &g);
+
+        assert_eq!(a.symbol_usage("g").unwrap(), 0x100);
+        // f's frame, the return address, and g's frame
+        assert_eq!(a.symbol_usage("f").unwrap(), 0x28 + 8 + 0x100);
+        assert!(a.unbounded().is_none());
+    }
+
+    #[test]
+    fn usage_unbounded() {
+        // call f; ret (recursion)
+        let f = [0xe8, 0xfb, 0xff, 0xff, 0xff, 0xc3];
+        // push %rbp; mov %rsp,%rbp; sub %rax,%rsp; leave; ret (alloca)
+        let g = [0x55, 0x48, 0x89, 0xe5, 0x48, 0x29, 0xc4, 0xc9, 0xc3];
+        let mut a = analysis(&f, &g);
+
+        a.symbol_usage("f").unwrap();
+        a.symbol_usage("g").unwrap();
+        assert_eq!(a.recursive, vec![String::from("f")]);
+        assert_eq!(a.dynamic, vec![String::from("g")]);
+        assert!(a.unbounded().is_some());
+    }
+
+    #[test]
+    fn usage_unbounded_calls() {
+        // call *%rax; ret
+        let f = [0xff, 0xd0, 0xc3];
+        // call 0x1012 (the middle of g); ret
+        let g = [0xe8, 0xfd, 0xff, 0xff, 0xff, 0xc3];
+        let mut a = analysis(&f, &g);
+
+        a.symbol_usage("f").unwrap();
+        assert_eq!(a.indirect, vec![String::from("f")]);
+        a.indirect.clear();
+        a.symbol_usage("g").unwrap();
+        assert_eq!(a.unknown, vec![String::from("0x1012")]);
+        assert!(a.unbounded().unwrap().starts_with("calls to unknown"));
+    }
+}
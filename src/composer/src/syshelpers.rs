@@ -1,9 +1,18 @@
 use crate::pipe::Pipe;
+use std::collections::HashSet;
 use std::fs;
+use std::path::PathBuf;
 
 // FIXME: progs should be a more general iteration type
 // return a tuple of stdout/stderr
 pub fn exec_pipeline(progs: Vec<String>) -> (String, String) {
+    let (out, err, _) = exec_pipeline_status(progs);
+    (out, err)
+}
+
+// As `exec_pipeline`, but also return if the pipeline succeeded
+// (i.e. its last program exited with a zero status).
+pub fn exec_pipeline_status(progs: Vec<String>) -> (String, String, bool) {
     let err_str = format!(
         "Failure in executing command: {}",
         progs.iter().fold("".to_string(), |s, p| if s.len() == 0 {
@@ -24,9 +33,79 @@ pub fn exec_pipeline(progs: Vec<String>) -> (String, String) {
     (
         String::from_utf8(output.stdout).unwrap(),
         String::from_utf8(output.stderr).unwrap(),
+        output.status.success(),
     )
 }
 
+// Execute each of the `jobs` pipelines (as in `exec_pipeline`), with
+// up to `njobs` of them executing concurrently. Each job is paired
+// with a key, and jobs with the same key are serialized, as they
+// share state (e.g. a component implementation's build
+// directory). Jobs are started in order, and their stdout/stderr and
+// success (as in `exec_pipeline_status`) are returned in the order of
+// `jobs`, so that the results don't depend on the scheduling of the
+// builds.
+pub fn exec_pipelines_parallel(
+    jobs: Vec<(String, Vec<String>)>,
+    njobs: usize,
+) -> Vec<(String, String, bool)> {
+    use std::cmp::{max, min};
+    use std::collections::HashSet;
+    use std::sync::{Condvar, Mutex};
+    use std::thread;
+
+    struct Frontier {
+        pending: Vec<usize>,      // indices of the jobs yet to start
+        running: HashSet<String>, // keys of the executing jobs
+    }
+
+    let nthds = max(1, min(njobs, jobs.len()));
+    let frontier = Mutex::new(Frontier {
+        pending: (0..jobs.len()).collect(),
+        running: HashSet::new(),
+    });
+    let changed = Condvar::new();
+    let results: Mutex<Vec<Option<(String, String, bool)>>> = Mutex::new(vec![None; jobs.len()]);
+
+    thread::scope(|scope| {
+        for _ in 0..nthds {
+            scope.spawn(|| loop {
+                let idx = {
+                    let mut f = frontier.lock().unwrap();
+                    loop {
+                        if f.pending.is_empty() {
+                            return;
+                        }
+                        // The first job that doesn't conflict with an executing one
+                        let next = f
+                            .pending
+                            .iter()
+                            .position(|i| !f.running.contains(&jobs[*i].0));
+                        if let Some(pos) = next {
+                            let i = f.pending.remove(pos);
+                            f.running.insert(jobs[i].0.clone());
+                            break i;
+                        }
+                        f = changed.wait(f).unwrap();
+                    }
+                };
+
+                let out = exec_pipeline_status(jobs[idx].1.clone());
+                results.lock().unwrap()[idx] = Some(out);
+                frontier.lock().unwrap().running.remove(&jobs[idx].0);
+                changed.notify_all();
+            });
+        }
+    });
+
+    results
+        .into_inner()
+        .unwrap()
+        .into_iter()
+        .map(|r| r.unwrap())
+        .collect()
+}
+
 pub fn dump_file(name: &String) -> Result<Vec<u8>, String> {
     use std::fs::File;
     use std::io::Read;
@@ -71,6 +150,96 @@ pub fn emit_file(name: &String, output: &[u8]) -> Result<(), String> {
     }
 }
 
+// A stable (FNV-1a, 64 bit) hash of build inputs used to
+// content-address build products. Unlike `DefaultHasher`, its values
+// are stable across composer builds, so they can name files.
+#[derive(Clone)]
+pub struct Digest {
+    h: u64,
+}
+
+impl Digest {
+    pub fn new() -> Digest {
+        Digest {
+            h: 0xcbf29ce484222325,
+        }
+    }
+
+    pub fn update(&mut self, data: &[u8]) {
+        // Include the length so that concatenations don't collide
+        for b in (data.len() as u64).to_le_bytes().iter().chain(data.iter()) {
+            self.h ^= *b as u64;
+            self.h = self.h.wrapping_mul(0x100000001b3);
+        }
+    }
+
+    // Only the contents of the file are hashed, not its path, so that
+    // generated files in different build directories hash the same.
+    pub fn update_file(&mut self, name: &String) -> Result<(), String> {
+        let contents = dump_file(&name)?;
+        self.update(&contents);
+        Ok(())
+    }
+
+    // Hash the names (relative to `dirname`) and contents of the
+    // files in the directory for which `filter` is true, in sorted
+    // order. Subdirectories are included if `recursive`. Symbolic
+    // links are followed (the configuration, e.g. `chal/` in the
+    // kernel's includes, is linked in), but each directory is only
+    // visited once so that cycles of links terminate.
+    pub fn update_dir(
+        &mut self,
+        dirname: &String,
+        recursive: bool,
+        filter: fn(&str) -> bool,
+    ) -> Result<(), String> {
+        fn files(
+            dir: &String,
+            rel: &String,
+            recursive: bool,
+            visited: &mut HashSet<PathBuf>,
+            out: &mut Vec<(String, String)>,
+        ) -> Result<(), String> {
+            if let Ok(canon) = fs::canonicalize(&dir) {
+                if !visited.insert(canon) {
+                    return Ok(());
+                }
+            }
+            let entries = match fs::read_dir(&dir) {
+                Ok(es) => es,
+                Err(e) => return Err(format!("{}: {}", dir, e.to_string())),
+            };
+            for e in entries {
+                let e = e.map_err(|e| format!("{}: {}", dir, e.to_string()))?;
+                let name = e.file_name().to_string_lossy().to_string();
+                let path = format!("{}/{}", dir, name);
+                let relpath = format!("{}/{}", rel, name);
+                // Dangling links are ignored
+                match fs::metadata(&path) {
+                    Ok(m) if m.is_dir() && recursive => files(&path, &relpath, recursive, visited, out)?,
+                    Ok(m) if m.is_file() => out.push((relpath, path)),
+                    _ => (),
+                }
+            }
+            Ok(())
+        }
+
+        let mut paths = Vec::new();
+        files(&dirname, &String::from(""), recursive, &mut HashSet::new(), &mut paths)?;
+        paths.sort();
+        for (relpath, path) in paths.iter().filter(|(r, _)| filter(r)) {
+            self.update(relpath.as_bytes());
+            self.update_file(&path)?;
+        }
+
+        Ok(())
+    }
+
+    pub fn hex(&self) -> String {
+        format!("{:016x}", self.h)
+    }
+}
+
 // remove directory, all contents, and remake it
 pub fn reset_dir(dirname: &String) -> Result<(), String> {
     assert!(dirname != "/"); // small sanity check
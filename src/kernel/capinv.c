@@ -1353,6 +1353,31 @@ static int __attribute__((noinline)) composite_syscall_slowpath(struct pt_regs *
 			if (ret) cos_throw(err, -EINVAL);
 			break;
 		}
+		case CAPTBL_OP_THDSCHEDDATA_SET: {
+			capid_t thd_cap = __userregs_get1(regs);
+			word_t  data    = __userregs_get2(regs);
+
+			assert(op_cap->captbl);
+			ret = thd_sched_data_set(op_cap->captbl, thd_cap, data);
+			break;
+		}
+		case CAPTBL_OP_THDSCHEDRING_SET: {
+			capid_t thd_cap = __userregs_get1(regs);
+			vaddr_t ring    = __userregs_get2(regs);
+
+			assert(op_cap->captbl);
+			/* The ring must be in the calling component's memory */
+			ret = thd_sched_ring_set(op_cap->captbl, thd_cap, ci->pgtblinfo.pgtbl, ring);
+			break;
+		}
+		case CAPTBL_OP_THDRESTART: {
+			capid_t thd_cap = __userregs_get1(regs);
+			capid_t compcap = __userregs_get2(regs);
+
+			assert(op_cap->captbl);
+			ret = thd_restart(op_cap->captbl, thd_cap, compcap);
+			break;
+		}
 		case CAPTBL_OP_THDDEACTIVATE_ROOT: {
 			livenessid_t lid           = __userregs_get2(regs);
 			capid_t      pgtbl_cap     = __userregs_get3(regs);
@@ -1582,6 +1607,13 @@ static int __attribute__((noinline)) composite_syscall_slowpath(struct pt_regs *
 
 			if (((struct cap_pgtbl *)ch)->lvl) cos_throw(err, -EINVAL);
 
+	#if defined(__x86_64__)
+			/* EPTs can map large pages, without a leaf in the last level */
+			if (((struct cap_pgtbl *)ch)->type == PGTBL_TYPE_EPT) {
+				ret = chal_pgtbl_ept_large_del(((struct cap_pgtbl *)ch)->pgtbl, addr, lid);
+				if (ret != -ENOENT) break;
+			}
+	#endif
 			ret = pgtbl_mapping_del(((struct cap_pgtbl *)ch)->pgtbl, addr, lid);
 
 			break;
@@ -170,6 +170,8 @@ __arcv_teardown(struct cap_arcv *arcv, struct thread *thd)
 
 	notif = thd->rcvcap.rcvcap_thd_notif;
 	if (notif) thd_rcvcap_release(notif);
+	/* events are only delivered to bound end-points */
+	thd_sched_ring_release(thd);
 	thd->rcvcap.isbound = 0;
 
 	thd->rcvcap.rcvcap_tcap = NULL;
@@ -121,6 +121,9 @@ int            chal_pgtbl_cosframe_add(pgtbl_t pt, vaddr_t addr, paddr_t page, w
 int            chal_pgtbl_mapping_mod(pgtbl_t pt, vaddr_t addr, u32_t flags, u32_t *prevflags);
 int            chal_pgtbl_mapping_del(pgtbl_t pt, vaddr_t addr, u32_t liv_id);
 int            chal_pgtbl_mapping_del_direct(pgtbl_t pt, u32_t addr);
+#if defined(__x86_64__)
+int            chal_pgtbl_ept_large_del(pgtbl_t pt, vaddr_t addr, u32_t liv_id);
+#endif
 int            chal_pgtbl_mapping_scan(struct cap_pgtbl *pt);
 void          *chal_pgtbl_lkup_lvl(pgtbl_t pt, vaddr_t addr, word_t *flags, u32_t start_lvl, u32_t end_lvl);
 int            chal_pgtbl_ispresent(word_t flags);
@@ -42,9 +42,13 @@
 /*
  * A single thread's stack size is 2^17 = 128kb by default
  */
+#ifndef MAX_STACK_SZ_BYTE_ORDER
 #define MAX_STACK_SZ_BYTE_ORDER 13
-/* Stack size in bytes */
+#endif
+/* Stack size in bytes; the composer can size it by analyzing the component's stack usage */
+#ifndef COS_STACK_SZ
 #define COS_STACK_SZ (1 << MAX_STACK_SZ_BYTE_ORDER)
+#endif
 /* Stack size in words */
 #define MAX_STACK_SZ (COS_STACK_SZ / 4)
 
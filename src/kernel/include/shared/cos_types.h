@@ -108,6 +108,41 @@ typedef enum {
 	RCV_ALL_PENDING  = 1 << 1,
 } rcv_flags_t;
 
+/*
+ * Scheduler event ring, shared between the kernel and a scheduler
+ * thread's rcv end-point. When a ring is registered for a scheduler
+ * thread, the kernel delivers all pending scheduling events into it
+ * on `rcv` rather than returning one event per call. `sched_data` is
+ * the scheduler's opaque per-thread value (see
+ * `CAPTBL_OP_THDSCHEDDATA_SET`) so that the scheduler needn't map
+ * thread ids to its own structures.
+ */
+struct cos_sched_event {
+	word_t      sched_data;
+	u16_t       tid;
+	u16_t       blocked;
+	u32_t       __pad;
+	cycles_t    elapsed;
+	tcap_time_t timeout;
+};
+
+#define COS_SCHED_RING_NEVTS 64
+#define COS_SCHED_RING_MASK  (COS_SCHED_RING_NEVTS - 1)
+
+/*
+ * Single producer (the kernel) and single consumer (the scheduler
+ * thread). Both indices increase monotonically: `head` is updated
+ * only by the scheduler, `tail` only by the kernel. The ring must be
+ * page-aligned, and fit in a single page.
+ */
+struct cos_sched_ring {
+	unsigned long          head;
+	unsigned long          __pad0[(CACHE_LINE / sizeof(unsigned long)) - 1];
+	unsigned long          tail;
+	unsigned long          __pad1[(CACHE_LINE / sizeof(unsigned long)) - 1];
+	struct cos_sched_event evts[COS_SCHED_RING_NEVTS];
+};
+
 #define BOOT_LIVENESS_ID_BASE 2
 
 typedef enum {
@@ -174,6 +209,10 @@ typedef enum {
 
 	CAPTBL_OP_ULK_MEMACTIVATE,
 
+	CAPTBL_OP_THDSCHEDDATA_SET,
+	CAPTBL_OP_THDSCHEDRING_SET,
+	CAPTBL_OP_THDRESTART,
+
 } syscall_op_t;
 
 typedef enum {
@@ -429,11 +468,14 @@ typedef u32_t prot_domain_t;
 	
 /* x86_64 prot_domain_t bits:
  *
- * |000......000|  pcid  |mpk key|
- * |31........16|15.....4|3.....0|
+ * |  asid  |mpk key|
+ * |31.....4|3.....0|
+ *
+ * The asid is virtual: the kernel maps it onto the hardware's PCIDs
+ * on each core (see chal_pgtbl_update).
  */ 
 #define PROTDOM_MPK_KEY(prot_domain) ((prot_domain) & 0xF)
-#define PROTDOM_ASID(prot_domain) (((prot_domain) >> 4) & 0xFFF)
+#define PROTDOM_ASID(prot_domain) (((prot_domain) >> 4) & 0xFFFFFFF)
 #define PROTDOM_INIT(asid, mpk_key) ((prot_domain_t)((asid << 4) | mpk_key))
 
 #endif
@@ -638,6 +680,11 @@ struct vm_vcpu_shared_region {
 	u64_t cr4;
 
 	u64_t microcode_version;
+
+	/* Set by the VMM before resuming the vcpu */
+	u64_t timer_deadline;	/* TSC at which to exit to the VMM, 0 for none */
+	u16_t sipi_vector;	/* start the vcpu at this startup IPI vector... */
+	u16_t sipi_pending;	/* ...if this is set (the kernel clears it) */
 };
 
 enum {
@@ -102,6 +102,12 @@ struct thread {
 	struct list        event_head; /* all events for *this* end-point */
 	struct list_node   event_list; /* the list of events for another end-point */
 
+	/* scheduler's opaque value for this thread, reported in events */
+	word_t                 sched_data;
+	/* if set, deliver scheduling events in bulk into this ring */
+	struct cos_sched_ring *sched_ring;
+	unsigned long          sched_ring_tail;
+
 	u8_t thd_type; /* vm thread or host thread */
 	struct vm_vcpu_context vcpu_ctx;
 	struct thread *exception_handler;
@@ -326,6 +332,53 @@ thd_state_evt_deliver(struct thread *t, unsigned long *thd_state, unsigned long
 	return 1;
 }
 
+/*
+ * Deliver as many pending events as will fit into the scheduler's
+ * shared event ring. The kernel maintains its own copy of the
+ * producer index so that a misbehaving scheduler can only corrupt
+ * its own view of the ring.
+ */
+static inline void
+thd_sched_ring_deliver(struct thread *t)
+{
+	struct cos_sched_ring *r    = t->sched_ring;
+	unsigned long          tail = t->sched_ring_tail;
+	unsigned long          head = r->head;
+
+	assert(thd_bound2rcvcap(t));
+	while (tail - head < COS_SCHED_RING_NEVTS) {
+		struct thread          *e = thd_rcvcap_evt_dequeue(t);
+		struct cos_sched_event *evt;
+
+		if (!e) break;
+
+		evt             = &r->evts[tail & COS_SCHED_RING_MASK];
+		evt->sched_data = e->sched_data;
+		evt->tid        = e->tid;
+		evt->blocked    = (e->state & THD_STATE_RCVING) && !thd_rcvcap_pending(e);
+		evt->elapsed    = e->exec;
+		e->exec         = 0;
+		evt->timeout    = e->timeout;
+		e->timeout      = 0;
+		tail++;
+	}
+	/* events must be visible before the scheduler sees the new tail */
+	cos_mem_fence();
+	t->sched_ring_tail = r->tail = tail;
+}
+
+/*
+ * Stop delivering events into the thread's ring, and drop the
+ * reference that kept the ring's frame from being retyped.
+ */
+static inline void
+thd_sched_ring_release(struct thread *t)
+{
+	if (!t->sched_ring) return;
+	retypetbl_deref((void *)chal_va2pa(t->sched_ring), PAGE_ORDER);
+	t->sched_ring = NULL;
+}
+
 static inline struct thread *
 thd_current(struct cos_cpu_local_info *cos_info)
 {
@@ -417,6 +470,48 @@ thd_activate(struct captbl *t, capid_t cap, capid_t capin, struct thread *thd, c
 	return 0;
 }
 
+/*
+ * Restart the suspended thread `thd_cap` at the entry of the component
+ * `compcap`, discarding its invocations, as if it were newly activated
+ * (but with the same memory, capability, and id). A component that is
+ * reset (e.g. to a checkpoint) can then reuse its threads rather than
+ * allocate new ones.
+ */
+static int
+thd_restart(struct captbl *t, capid_t thd_cap, capid_t compcap)
+{
+	struct cos_cpu_local_info *cli = cos_cpu_local_info();
+	struct cap_thd            *tc;
+	struct cap_comp           *compc;
+	struct thread             *thd;
+
+	tc = (struct cap_thd *)captbl_lkup(t, thd_cap);
+	if (unlikely(!tc || tc->h.type != CAP_THD || tc->cpuid != get_cpuid())) return -EINVAL;
+	compc = (struct cap_comp *)captbl_lkup(t, compcap);
+	if (unlikely(!compc || compc->h.type != CAP_COMP)) return -EINVAL;
+	thd = tc->t;
+	/* Only host threads that aren't executing, or scheduling */
+	if (unlikely(thd == thd_current(cli) || thd->thd_type != THD_TYPE_HOST || compc->pgd->type != THD_TYPE_HOST)) return -EINVAL;
+	if (unlikely(thd_bound2rcvcap(thd) || thd->sched_ring)) return -EBUSY;
+
+	memcpy(&(thd->invstk[0].comp_info), &compc->info, sizeof(struct comp_info));
+	thd->invstk[0].ip = thd->invstk[0].sp = 0;
+	thd->invstk[0].protdom                = compc->info.pgtblinfo.protdom;
+	thd->invstk_top                       = 0;
+	if (thd->ulk_invstk) thd->ulk_invstk->top = 0;
+	thd->state                            = 0;
+	thd->tls                              = 0;
+	thd->timeout                          = 0;
+	thd->interrupted_thread               = NULL;
+	if (cli->next_ti.thd == thd) thd_next_thdinfo_update(cli, 0, 0, 0, 0);
+
+	memset(&thd->regs, 0, sizeof(struct pt_regs));
+	fpu_thread_init(thd);
+	thd_upcall_setup(thd, compc->entry_addr, COS_UPCALL_THD_CREATE, 0, 0, 0);
+
+	return 0;
+}
+
 static int
 thd_deactivate(struct captbl *ct, struct cap_captbl *dest_ct, unsigned long capin, livenessid_t lid, capid_t pgtbl_cap,
                capid_t cosframe_addr, const int root)
@@ -463,6 +558,7 @@ thd_deactivate(struct captbl *ct, struct cap_captbl *dest_ct, unsigned long capi
 	/* deactivation success */
 	if (thd->refcnt == 0) {
 		if (cli->next_ti.thd == thd) thd_next_thdinfo_update(cli, 0, 0, 0, 0);
+		thd_sched_ring_release(thd);
 
 		/* move the kmem for the thread to a location
 		 * in a pagetable as COSFRAME */
@@ -475,6 +571,64 @@ err:
 	return ret;
 }
 
+static int
+thd_sched_data_set(struct captbl *ct, capid_t thd_cap, word_t data)
+{
+	struct cap_thd *tc;
+
+	tc = (struct cap_thd *)captbl_lkup(ct, thd_cap);
+	if (!tc || tc->h.type != CAP_THD || get_cpuid() != tc->cpuid) return -EINVAL;
+
+	assert(tc->t);
+	tc->t->sched_data = data;
+
+	return 0;
+}
+
+/*
+ * Register (or, with `ring_addr == 0`, remove) the page at
+ * `ring_addr` in the page-table `pt` as the scheduler event ring for
+ * the rcv end-point thread. The page must be a present, user-writable
+ * user frame; it is referenced (as a mapping would be) until it is
+ * replaced, or the end-point is torn down, so it cannot be retyped
+ * while the kernel writes into it.
+ */
+static int
+thd_sched_ring_set(struct captbl *ct, capid_t thd_cap, pgtbl_t pt, vaddr_t ring_addr)
+{
+	struct cap_thd        *tc;
+	struct thread         *thd;
+	struct cos_sched_ring *r;
+	word_t                 flags;
+	int                    ret;
+
+	tc = (struct cap_thd *)captbl_lkup(ct, thd_cap);
+	if (!tc || tc->h.type != CAP_THD || get_cpuid() != tc->cpuid) return -EINVAL;
+	thd = tc->t;
+	assert(thd);
+	if (!thd_bound2rcvcap(thd)) return -EINVAL;
+
+	if (ring_addr == 0) {
+		thd_sched_ring_release(thd);
+		return 0;
+	}
+	if (ring_addr % PAGE_SIZE != 0) return -EINVAL;
+	r = (struct cos_sched_ring *)pgtbl_lkup(pt, ring_addr, &flags);
+	if (!r) return -EINVAL;
+	if (!chal_pgtbl_flag_all(flags, PGTBL_PRESENT | PGTBL_USER | PGTBL_WRITABLE)
+	    || chal_pgtbl_flag_exist(flags, PGTBL_COSFRAME | PGTBL_COSKMEM)) return -EPERM;
+
+	ret = retypetbl_ref((void *)chal_va2pa(r), PAGE_ORDER);
+	if (ret) return ret;
+	thd_sched_ring_release(thd);
+
+	r->head = r->tail     = 0;
+	thd->sched_ring_tail  = 0;
+	thd->sched_ring       = r;
+
+	return 0;
+}
+
 static int
 thd_tls_set(struct captbl *ct, capid_t thd_cap, vaddr_t tlsaddr, struct thread *current)
 {
@@ -660,7 +814,8 @@ thd_rcvcap_pending_deliver(struct thread *thd, struct pt_regs *regs)
 	unsigned long thd_state = 0, cycles = 0, timeout = 0, pending = 0;
 	int           all_pending = thd_rcvcap_all_pending_get(thd);
 
-	thd_state_evt_deliver(thd, &thd_state, &cycles, &timeout);
+	if (thd->sched_ring) thd_sched_ring_deliver(thd);
+	else                 thd_state_evt_deliver(thd, &thd_state, &cycles, &timeout);
 	if (all_pending) {
 		pending = thd_rcvcap_all_pending(thd);
 	} else {
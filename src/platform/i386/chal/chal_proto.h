@@ -146,41 +146,89 @@ chal_protdom_read(void)
 #endif /* MPK_ENABLED */
 
 
+/*
+ * Protection domains' asids are virtual, and can outnumber the
+ * hardware's PCIDs, so each core assigns its PCIDs lazily, on an
+ * address space's first use on the core, from a cursor. Once the
+ * cursor runs out of PCIDs, the core starts a new generation by
+ * resetting it, which invalidates all of its assignments at once: a
+ * PCID is only valid if it is below the cursor, and its owner still
+ * matches. Each PCID's TLB entries are flushed when it is (re)assigned,
+ * so the previous generation's owners can't leak translations.
+ *
+ * The hint maps an asid to its last PCID. Colliding asids only cost a
+ * PCID, which the next generation recycles. Freeing a root page-table
+ * increments tlb_asid_gen, as its memory can become a different
+ * page-table at the same address, and each core then starts a new
+ * generation.
+ */
+#define PCID_HINT_SZ (2 * (NUM_ASID_MAX + 1))
+
 struct cpu_tlb_asid_map {
 	pgtbl_t mapped_pt[NUM_ASID_MAX];
+	u32_t   mapped_asid[NUM_ASID_MAX];
+	u16_t   hint[PCID_HINT_SZ];
+	u16_t   next;
+	int     gen;
 } CACHE_ALIGNED;
 
 extern struct cpu_tlb_asid_map tlb_asid_map[NUM_CPU];
-
-static inline pgtbl_t
-chal_cached_pt_curr(prot_domain_t protdom)
+extern int tlb_asid_gen;
+
+/*
+ * Find this core's PCID for the page-table, assigning one if needed.
+ * Returns 1 if the PCID's cached translations are the page-table's, 0
+ * if it was just assigned and must be flushed.
+ */
+static inline int
+chal_asid_pcid(struct pgtbl_info *pt, u16_t *pcid)
 {
-	u16_t asid = PROTDOM_ASID(protdom);
-	return tlb_asid_map[get_cpuid()].mapped_pt[asid];
-}
+	struct cpu_tlb_asid_map *map = &tlb_asid_map[get_cpuid()];
+	int   gen  = *(volatile int *)&tlb_asid_gen;
+	u32_t asid = PROTDOM_ASID(pt->protdom);
+	u16_t *hint, p;
+
+	if (NUM_ASID_MAX == 0) {
+		*pcid = 0;
+		return 0;
+	}
 
-static inline void
-chal_cached_pt_update(pgtbl_t pt, prot_domain_t protdom)
-{
-	u16_t asid                                = PROTDOM_ASID(protdom);
-	tlb_asid_map[get_cpuid()].mapped_pt[asid] = pt;
+	if (unlikely(map->gen != gen)) {
+		map->next = 0;
+		map->gen  = gen;
+	}
+
+	hint = &map->hint[asid & (PCID_HINT_SZ - 1)];
+	p    = *hint;
+	if (likely(p < map->next && map->mapped_asid[p] == asid && map->mapped_pt[p] == pt->pgtbl)) {
+		*pcid = p;
+		return 1;
+	}
+
+	/* out of PCIDs: start a new generation */
+	if (unlikely(map->next == NUM_ASID_MAX)) map->next = 0;
+
+	p                   = map->next++;
+	map->mapped_pt[p]   = pt->pgtbl;
+	map->mapped_asid[p] = asid;
+	*hint               = p;
+	*pcid               = p;
+
+	return 0;
 }
 
 /* Update the page table */
 static inline void
 chal_pgtbl_update(struct pgtbl_info *pt)
 {
-	u16_t asid = PROTDOM_ASID(pt->protdom);
+	u16_t pcid;
+	int   cached = chal_asid_pcid(pt, &pcid);
 
 	/* lowest 12 bits is the context identifier */
-	unsigned long cr3 = (unsigned long)pt->pgtbl | asid;
+	unsigned long cr3 = (unsigned long)pt->pgtbl | pcid;
 
 	/* fastpath: don't need to invalidate tlb entries; otherwise flush tlb on switch */
-	if (likely(chal_cached_pt_curr(asid) == pt->pgtbl)) {
-		cr3 |= CR3_NO_FLUSH;
-	} else {
-		chal_cached_pt_update(pt->pgtbl, asid);
-	}
+	if (likely(cached)) cr3 |= CR3_NO_FLUSH;
 
 	asm volatile("mov %0, %%cr3" : : "r"(cr3));
 }
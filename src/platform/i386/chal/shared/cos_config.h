@@ -190,6 +190,9 @@
 #define COS_PAGE_PKEY2 (1ul << 61)
 #define COS_PAGE_PKEY3 (1ul << 62)
 #define COS_PAGE_XDISABLE (1ul << 63)
+/* Alias into an EPT with a single 2MB/1GB leaf (ignored otherwise) */
+#define COS_PAGE_EPT_2M (1ul << 7)
+#define COS_PAGE_EPT_1G (1ul << 8)
 
 #elif defined(__i386__)
 #define COS_PGTBL_DEPTH 2
@@ -307,6 +307,8 @@ chal_pgtbl_deactivate(struct captbl *t, struct cap_captbl *dest_ct_cap, unsigned
 			cos_faa((int *)&deact_cap->refcnt_flags, 1);
 			cos_throw(err, ret);
 		}
+		/* cores must not trust their PCIDs' TLB entries for this page-table's address */
+		cos_faa(&tlb_asid_gen, 1);
 	} else {
 		cos_faa((int *)&parent->refcnt_flags, -1);
 	}
@@ -454,6 +456,77 @@ chal_pgtbl_mapping_mod(pgtbl_t pt, vaddr_t addr, u32_t flags, u32_t *prevflags)
 	                           orig_v);
 }
 
+#if defined(__x86_64__)
+/*
+ * Like chal_pgtbl_lkup_lvl(pt, addr, flags, 0, end_lvl), but only
+ * descends through entries that are present and aren't leaves (bit 7
+ * is a superpage, or an EPT's large page), so it never follows an
+ * absent entry's frame. Returns NULL if an entry above end_lvl isn't
+ * such a table.
+ */
+static unsigned long *
+chal_pgtbl_walk_present(pgtbl_t pt, vaddr_t addr, u32_t end_lvl)
+{
+	u32_t          i;
+	unsigned long *intern = NULL;
+	unsigned long *page   = chal_pa2va((unsigned long)pt & PGTBL_ENTRY_ADDR_MASK);
+
+	for (i = 0; i < end_lvl; i++) {
+		if (intern) {
+			if (!(*intern & X86_PGTBL_PRESENT) || (*intern & X86_PGTBL_SUPER)) return NULL;
+			page = chal_pa2va((*intern) & PGTBL_ENTRY_ADDR_MASK);
+		}
+		addr   = addr & (0xffffffffffff >> (PGTBL_ENTRY_ORDER * i));
+		intern = page + (addr >> (PAGE_ORDER + PGTBL_ENTRY_ORDER * (PGTBL_DEPTH - 1 - i)));
+	}
+
+	return intern;
+}
+
+/*
+ * EPTs can map 1GB and 2MB pages with a leaf above the last level
+ * (see chal_pgtbl_ept_large_cpy), so the caller must only use this on
+ * EPTs: bit 7 means a superpage in the other page-tables. Returns
+ * -ENOENT if addr isn't mapped by such a leaf.
+ */
+int
+chal_pgtbl_ept_large_del(pgtbl_t pt, vaddr_t addr, u32_t liv_id)
+{
+	int                ret;
+	struct ert_intern *pte;
+	unsigned long      orig_v, i;
+	vaddr_t            order;
+	u32_t              lvl;
+
+	assert(pt);
+	if (unlikely(liv_id >= (1 << (32 - PGTBL_PAGEIDX_SHIFT)))) return -EINVAL;
+
+	for (lvl = PGTBL_DEPTH - 2; lvl < PGTBL_DEPTH; lvl++) {
+		pte = (struct ert_intern *)chal_pgtbl_walk_present(pt, addr, lvl);
+		if (!pte) return -ENOENT;
+		orig_v = (unsigned long)(pte->next);
+		if (!(orig_v & X86_PGTBL_PRESENT)) return -ENOENT;
+		if (orig_v & x86_EPT_LARGE_PAGE) break;
+	}
+	if (lvl == PGTBL_DEPTH) return -ENOENT;
+
+	order = PAGE_ORDER + PGTBL_ENTRY_ORDER * (PGTBL_DEPTH - lvl);
+	if (addr & ((1UL << order) - 1)) return -EINVAL;
+
+	ret = ltbl_timestamp_update(liv_id);
+	if (unlikely(ret)) return ret;
+
+	ret = __pgtbl_update_leaf(pte, (void *)(unsigned long)((liv_id << PGTBL_PAGEIDX_SHIFT) | X86_PGTBL_QUIESCENCE), orig_v);
+	if (ret) return ret;
+
+	for (i = 0; i < (1UL << (order - PAGE_ORDER)); i++) {
+		retypetbl_deref((void *)((orig_v & PGTBL_FRAME_MASK) + (i << PAGE_ORDER)), PAGE_ORDER);
+	}
+
+	return 0;
+}
+#endif
+
 /**
  * When we remove a mapping, we need to link the vas to a liv_id,
  * which tracks quiescence for us.
@@ -704,6 +777,57 @@ chal_pgtbl_pgtblactivate(struct captbl *ct, capid_t cap, capid_t pt_entry, capid
 	return ret;
 }
 
+#if defined(__x86_64__)
+/*
+ * Map a 2MB or 1GB region into an EPT with a single leaf. The source
+ * must map the region with user frames that are physically contiguous
+ * and aligned to the leaf's size, and the EPT's levels above the leaf
+ * must already be constructed. Each 4KB frame is referenced, so the
+ * frames are accounted for just as if they were mapped one by one.
+ */
+static int
+chal_pgtbl_ept_large_cpy(pgtbl_t to, vaddr_t addr_to, pgtbl_t from, vaddr_t addr_from, u32_t order)
+{
+	unsigned long *f, *pte, v, orig_v;
+	unsigned long  i, npages = 1UL << (order - PAGE_ORDER);
+	paddr_t        frame = 0;
+	int            ret;
+
+	if (unlikely((addr_to | addr_from) & ((1UL << order) - 1))) return -EINVAL;
+
+	for (i = 0; i < npages; i++) {
+		f = chal_pgtbl_walk_present(from, addr_from + (i << PAGE_ORDER), PGTBL_DEPTH);
+		if (!f) return -ENOENT;
+		v = *f;
+		if (!chal_pgtbl_flag_exist(v, X86_PGTBL_PRESENT)) return -ENOENT;
+		if (chal_pgtbl_flag_exist(v, PGTBL_COSFRAME) || !chal_pgtbl_flag_exist(v, PGTBL_USER)) return -EPERM;
+
+		if (i == 0) frame = v & PGTBL_FRAME_MASK;
+		if ((v & PGTBL_FRAME_MASK) != frame + (i << PAGE_ORDER)) return -EINVAL;
+	}
+	if (frame & ((1UL << order) - 1)) return -EINVAL;
+
+	/* The entry that maps 1 << order bytes is above the last level */
+	pte = chal_pgtbl_walk_present(to, addr_to, PGTBL_DEPTH - (order - PAGE_ORDER) / PGTBL_ENTRY_ORDER);
+	if (!pte) return -ENOENT;
+	orig_v = *pte;
+	if (orig_v & (x86_EPT_READ_ACCESS | x86_EPT_WRITE_ACCCESS | x86_EPT_INST_FETCHABLE)) return -EEXIST;
+	ret = pgtbl_quie_check(orig_v);
+	if (ret) return ret;
+
+	for (i = 0; i < npages; i++) {
+		ret = retypetbl_ref((void *)(frame + (i << PAGE_ORDER)), PAGE_ORDER);
+		if (ret) goto undo;
+	}
+	ret = __pgtbl_update_leaf((struct ert_intern *)pte, (void *)(frame | x86_EPT_VM_DEF | x86_EPT_LARGE_PAGE), orig_v);
+	if (!ret) return 0;
+undo:
+	while (i-- > 0) retypetbl_deref((void *)(frame + (i << PAGE_ORDER)), PAGE_ORDER);
+
+	return ret;
+}
+#endif
+
 int
 chal_pgtbl_cpy(struct captbl *t, capid_t cap_to, capid_t capin_to, struct cap_pgtbl *ctfrom, capid_t capin_from, cap_t cap_type, word_t flags_in)
 {
@@ -717,6 +841,12 @@ chal_pgtbl_cpy(struct captbl *t, capid_t cap_to, capid_t capin_to, struct cap_pg
 	if (unlikely(((struct cap_pgtbl *)ctto)->refcnt_flags & CAP_MEM_FROZEN_FLAG)) return -EINVAL;
 
 #if defined(__x86_64__)
+	if (unlikely((((struct cap_pgtbl *)ctto)->type) == PGTBL_TYPE_EPT && (flags_in & (COS_PAGE_EPT_2M | COS_PAGE_EPT_1G)))) {
+		return chal_pgtbl_ept_large_cpy(((struct cap_pgtbl *)ctto)->pgtbl, capin_to, ctfrom->pgtbl, capin_from,
+		                                (flags_in & COS_PAGE_EPT_1G) ? COS_PGTBL_ORDER_PTE_1 : COS_PGTBL_ORDER_PTE_2);
+	}
+	flags_in &= ~(COS_PAGE_EPT_2M | COS_PAGE_EPT_1G);
+
 	f = pgtbl_lkup_lvl(((struct cap_pgtbl *)ctfrom)->pgtbl, capin_from, &flags, 0, PGTBL_DEPTH);
 #elif defined(__i386__)	
 	f = pgtbl_lkup_pte(((struct cap_pgtbl *)ctfrom)->pgtbl, capin_from, &flags);
@@ -40,6 +40,7 @@ typedef enum {
 	x86_EPT_WRITE_ACCCESS		= 1 << 1,
 	x86_EPT_INST_FETCHABLE		= 1 << 2,
 	x86_EPT_IGNORE_PAT_MEM_TYPE	= 1 << 6,
+	x86_EPT_LARGE_PAGE		= 1 << 7, /* 2MB or 1GB leaf above the last level */
 	x86_EPT_ACCESSED		= 1 << 8,
 	x86_EPT_DIRTY			= 1 << 9,
 	x86_EPT_USR_INST_FETCHABLE	= 1 << 10,
@@ -73,6 +73,7 @@
 
 #define GUEST_INTERRUPTIBILITY_STATE		0x00004824
 #define GUEST_ACTIVITY_STATE			0x00004826
+#define VMX_PREEMPTION_TIMER_VALUE		0x0000482E
 
 #define GUEST_CR0				0x00006800
 #define GUEST_CR3				0x00006802
@@ -110,6 +111,8 @@
 #define PRIMARY_VM_EXIT_CONTROLS		0x0000400C
 #define VM_ENTRY_CONTROLS			0x00004012
 #define VM_ENTRY_INTERRUPTION_INFORMATION_FIELD	0x00004016
+#define PLE_GAP					0x00004020
+#define PLE_WINDOW				0x00004022
 
 #define EXIT_REASON				0x00004402
 #define EXIT_INSTRUCTION_LENGTH			0x0000440C
@@ -123,6 +126,7 @@
 #define VAPIC_ACCESS_ADDRESS			0x00002012
 
 #define EXTERNAL_INTERRUPT_EXITING		BIT(0)
+#define ACTIVATE_VMX_PREEMPTION_TIMER		BIT(6)
 
 #define HLT_EXITING				BIT(7)
 #define INVLPG_EXITING				BIT(9)
@@ -183,12 +183,18 @@ vmx_guest_state_init(void)
 	vmwrite(GUEST_IA32_PAT, msr_get(IA32_PAT));
 }
 
+/* The VMX-preemption timer counts down at the TSC's rate shifted right by this */
+u8_t vmx_preemption_timer_shift;
+
 void
 vmx_pinbased_ctl_init(void)
 {
 	u32_t pinbased_execution_ctl = 0;
 
-	pinbased_execution_ctl |= EXTERNAL_INTERRUPT_EXITING ;
+	vmx_preemption_timer_shift = msr_get(IA32_VMX_MISC) & 0x1F;
+
+	/* The preemption timer exits at the vcpu's timer deadline (see vmx_timer_arm) */
+	pinbased_execution_ctl |= EXTERNAL_INTERRUPT_EXITING | ACTIVATE_VMX_PREEMPTION_TIMER;
 	pinbased_execution_ctl = fix_reserved_ctrl_bits(IA32_VMX_PINBASED_CTLS, pinbased_execution_ctl);
 	vmwrite(PIN_BASED_VM_EXECUTION_CONTROLS, pinbased_execution_ctl);
 }
@@ -199,9 +205,13 @@ vmx_procbased_ctl_init(void)
 	u32_t primary_procbased_ctls = 0;
 	u32_t second_procbased_ctls = 0;
 
-	primary_procbased_ctls =  MWAIT_EXITING | RDPMC_EXITING | USE_TPR_SHADOW 
+	/*
+	 * The VMM blocks halted vcpus, and only spinning PAUSEs exit
+	 * (pause-loop exiting), rather than each of them.
+	 */
+	primary_procbased_ctls =  HLT_EXITING | MWAIT_EXITING | RDPMC_EXITING | USE_TPR_SHADOW 
 				| UNCONDITIONAL_IO_EXITING | USE_MSR_BITMAPS
-				| PAUSE_EXITING | ACTIVATE_SECONDARY_CONTROLS;
+				| ACTIVATE_SECONDARY_CONTROLS;
 	primary_procbased_ctls = fix_reserved_ctrl_bits(IA32_VMX_TRUE_PROCBASED_CTLS, primary_procbased_ctls);
 	vmwrite(PRI_PROC_BASED_VM_EXECUTION_CONTROLS, primary_procbased_ctls);
 
@@ -212,6 +222,10 @@ vmx_procbased_ctl_init(void)
 				| ENABLE_USER_WAIT_AND_PAUSE;
 	second_procbased_ctls = fix_reserved_ctrl_bits(IA32_VMX_PROCBASED_CTLS2, second_procbased_ctls);
 	vmwrite(SEC_PROC_BASED_VM_EXECUTION_CONTROLS, second_procbased_ctls);
+
+	/* A loop of PAUSEs (at most 128 cycles apart) exits after 4096 cycles */
+	vmwrite(PLE_GAP, 128);
+	vmwrite(PLE_WINDOW, 4096);
 }
 
 void
@@ -404,6 +418,8 @@ vmx_thd_start_or_resume(struct thread *thd)
 	vmx_vm_entry_ctl_init();
 	vmx_msr_bitmaps_init(thd);
 	vmx_thd_state_init(thd);
+	vmx_startup_ipi(thd->vm_vcpu_shared_region);
+	vmx_timer_arm(thd->vm_vcpu_shared_region);
 
 	thd->vcpu_ctx.state = VM_THD_STATE_RUNNING;
 
@@ -27,6 +27,43 @@ extern u64_t cr4_fixed0_bits;
 extern u64_t cr0_fixed1_bits;
 extern u64_t cr0_fixed0_bits;
 
+extern u8_t vmx_preemption_timer_shift;
+
+/*
+ * Exit to the VMM at the vcpu's timer deadline, so the timer's
+ * interrupt isn't delayed until the next exit. Without a deadline, the
+ * timer is set as far out as possible.
+ */
+void
+vmx_timer_arm(struct vm_vcpu_shared_region *shared_region)
+{
+	u64_t deadline = shared_region->timer_deadline;
+	u64_t now, ticks = 0xFFFFFFFF;
+
+	if (deadline) {
+		rdtscll(now);
+		ticks = deadline > now ? (deadline - now) >> vmx_preemption_timer_shift : 0;
+		if (ticks > 0xFFFFFFFF) ticks = 0xFFFFFFFF;
+	}
+	vmwrite(VMX_PREEMPTION_TIMER_VALUE, ticks);
+}
+
+/*
+ * The VMM received a startup IPI for the vcpu: it starts in real mode
+ * at the page of the vector.
+ */
+void
+vmx_startup_ipi(struct vm_vcpu_shared_region *shared_region)
+{
+	if (likely(!shared_region->sipi_pending)) return;
+
+	vmwrite(GUEST_CS, (u64_t)shared_region->sipi_vector << 8);
+	vmwrite(GUEST_CS_BASE, (u64_t)shared_region->sipi_vector << 12);
+	vmwrite(GUEST_RIP, 0);
+	shared_region->ip = 0;
+	shared_region->sipi_pending = 0;
+}
+
 void
 vmx_resume(struct thread *thd)
 {
@@ -54,6 +91,9 @@ vmx_resume(struct thread *thd)
 	val &= cr4_fixed0_bits;
 	vmwrite(GUEST_CR4, val);
 
+	vmx_startup_ipi(shared_region);
+	vmx_timer_arm(shared_region);
+
 	/* This is awkward here, but necessary as the manual mentions that long-mode status should be put into vm entry ctl */
 	if (unlikely(shared_region->efer & BIT(10))) {
 		u64_t vm_entry_ctls = vmread(VM_ENTRY_CONTROLS);
@@ -180,8 +220,8 @@ vmx_exit_handler(struct vm_vcpu_shared_region *regs)
 	vmx_assert(reason_nr < MAX_VM_EXIT_REASONS);
 	VMX_DEBUG("VM thd: %u on core: %u get VM-exit (reason: ) on handler: %u\n", thd_curr->tid, cos_info->cpuid, reason_nr, thd_exception_handler->tid);
 
-	/* Share GPs with VMM */
-	memcpy(shared_region, regs, sizeof(struct vm_vcpu_shared_region));
+	/* Share GPs with VMM (only they were saved, the rest of the region is the VMM's) */
+	memcpy(shared_region, regs, __builtin_offsetof(struct vm_vcpu_shared_region, reason));
 
 	shared_region->reason = reason_nr;
 	shared_region->ip = vmread(GUEST_RIP);
@@ -19,7 +19,6 @@ ubuntu64()
 		sudo apt install grub2-common
 	fi
 
-	pip3 install pyelftools
 	pip3 install meson>=0.61.0
 	pip3 install ninja
 
@@ -40,7 +39,6 @@ fedora64()
 		sudo yum install grub2
 	fi
 
-	pip3 install pyelftools
 	pip3 install meson>=0.61.0
 	pip3 install ninja
 	# Install rust